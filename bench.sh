@@ -0,0 +1 @@
+./bin/rascii_bench.exe
\ No newline at end of file
@@ -0,0 +1,1391 @@
+// Microbenchmarks for rascii
+// Usage: rascii_bench [name] -- runs every benchmark whose name contains [name]
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <cmath>
+#include <thread>
+
+#include "simd.hpp"
+#include "vec.hpp"
+#include "matrix.hpp"
+#include "mesh.hpp"
+#include "quaternion.hpp"
+#include "raster.hpp"
+#include "camera.hpp"
+#include "render.hpp"
+#include "display.hpp"
+#include "presenter.hpp"
+
+// written to by every benchmark, so that the compiler can't throw the work away
+static volatile float sink;
+
+// every heap allocation in the process goes through here, so that benchmarks can count them -- the thread pool and
+// the presenter allocate from threads of their own, so the counter is atomic
+static std::atomic<size_t> heapAllocations(0);
+
+static void *countedAlloc(size_t size)
+{
+    heapAllocations++;
+    void *p = std::malloc(size == 0 ? 1 : size);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+static void *countedAlignedAlloc(size_t size, std::align_val_t alignment)
+{
+    heapAllocations++;
+    size_t align = std::max((size_t)alignment, sizeof(void *));
+#if defined(_WIN32)
+    void *p = _aligned_malloc(size == 0 ? 1 : size, align);
+#else
+    void *p = nullptr;
+    if (posix_memalign(&p, align, size == 0 ? 1 : size) != 0)
+    {
+        p = nullptr;
+    }
+#endif
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+static void alignedFree(void *p)
+{
+#if defined(_WIN32)
+    _aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
+
+void *operator new(size_t size)
+{
+    return countedAlloc(size);
+}
+
+void *operator new[](size_t size)
+{
+    return countedAlloc(size);
+}
+
+void *operator new(size_t size, std::align_val_t alignment)
+{
+    return countedAlignedAlloc(size, alignment);
+}
+
+void *operator new[](size_t size, std::align_val_t alignment)
+{
+    return countedAlignedAlloc(size, alignment);
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::align_val_t) noexcept
+{
+    alignedFree(p);
+}
+
+void operator delete(void *p, size_t, std::align_val_t) noexcept
+{
+    alignedFree(p);
+}
+
+void operator delete[](void *p, std::align_val_t) noexcept
+{
+    alignedFree(p);
+}
+
+void operator delete[](void *p, size_t, std::align_val_t) noexcept
+{
+    alignedFree(p);
+}
+
+/// @brief Runs the given function the given number of times, and returns the average time in nanoseconds
+template <typename Func>
+double timeNs(int iterations, Func func)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < iterations; i++)
+    {
+        func();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+}
+
+static void printRow(const std::string &label, double scalarNs, double simdNs)
+{
+    std::cout << "  " << std::left << std::setw(12) << label << std::right << std::fixed << std::setprecision(2)
+              << std::setw(10) << scalarNs << " ns" << std::setw(10) << simdNs << " ns"
+              << std::setw(8) << scalarNs / simdNs << "x" << std::endl;
+}
+
+/// @brief Times every Vec/Matrix kernel of the given kernel set over the given data
+template <typename Kernels>
+struct VecKernelTimings
+{
+    double add, dot, cross, matVec, matMat;
+
+    VecKernelTimings(const std::vector<Vec> &vecs, const std::vector<Matrix> &mats, int iterations)
+    {
+        const int count = (int)vecs.size();
+        const int matCount = (int)mats.size();
+        std::vector<Vec> out(count);
+        std::vector<Matrix> matsOut(matCount);
+        const Matrix &m = mats[0];
+
+        this->add = timeNs(iterations, [&]()
+                           {
+            for (int i = 0; i < count; i++)
+            {
+                Kernels::add(&vecs[i].x, &vecs[count - 1 - i].x, &out[i].x);
+            }
+            sink = out[count - 1].x; });
+
+        this->dot = timeNs(iterations, [&]()
+                           {
+            float sum = 0;
+            for (int i = 0; i < count; i++)
+            {
+                sum += Kernels::dot(&vecs[i].x, &vecs[count - 1 - i].x);
+            }
+            sink = sum; });
+
+        this->cross = timeNs(iterations, [&]()
+                             {
+            for (int i = 0; i < count; i++)
+            {
+                Kernels::cross(&vecs[i].x, &vecs[count - 1 - i].x, &out[i].x);
+            }
+            sink = out[count - 1].x; });
+
+        this->matVec = timeNs(iterations, [&]()
+                              {
+            for (int i = 0; i < count; i++)
+            {
+                Kernels::matVec(m.elements, &vecs[i].x, &out[i].x);
+            }
+            sink = out[count - 1].x; });
+
+        this->matMat = timeNs(iterations, [&]()
+                              {
+            for (int i = 0; i < matCount; i++)
+            {
+                Kernels::matMat(m.elements, mats[i].elements, matsOut[i].elements);
+            }
+            sink = matsOut[matCount - 1].elements[0]; });
+    }
+};
+
+/// @brief Compares the scalar reference kernels with the compile-time selected kernels
+void benchVecKernels()
+{
+    const int count = 4096;
+    const int iterations = 200;
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> dist(-10.0f, 10.0f);
+    std::vector<Vec> vecs(count);
+    for (Vec &v : vecs)
+    {
+        v = Vec(dist(rng), dist(rng), dist(rng), 1.0f);
+    }
+    std::vector<Matrix> mats(count);
+    for (Matrix &m : mats)
+    {
+        for (int i = 0; i < 16; i++)
+        {
+            m.elements[i] = dist(rng);
+        }
+    }
+
+    VecKernelTimings<ScalarKernels> scalar(vecs, mats, iterations);
+    VecKernelTimings<VecKernels> simd(vecs, mats, iterations);
+
+    std::cout << "vec kernels: scalar vs " << VecKernels::name() << " (per " << count << " operations)" << std::endl;
+    printRow("add", scalar.add, simd.add);
+    printRow("dot", scalar.dot, simd.dot);
+    printRow("cross", scalar.cross, simd.cross);
+    printRow("mat * vec", scalar.matVec, simd.matVec);
+    printRow("mat * mat", scalar.matMat, simd.matMat);
+}
+
+/// @brief Builds a mesh of the given number of random triangles
+static Mesh randomMesh(int triangleCount)
+{
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> dist(-10.0f, 10.0f);
+    std::vector<Triangle> triangles(triangleCount);
+    for (Triangle &triangle : triangles)
+    {
+        triangle = Triangle(Vec(dist(rng), dist(rng), dist(rng)), Vec(dist(rng), dist(rng), dist(rng)), Vec(dist(rng), dist(rng), dist(rng)));
+    }
+    return Mesh(triangles);
+}
+
+/// @brief Compares transforming a mesh one vertex at a time with the batched transform
+static void benchBatchTransform(int triangleCount, int iterations)
+{
+    Mesh mesh = randomMesh(triangleCount);
+    Matrix m = Matrix::translation(Vec(1, 2, 3)) * Quaternion(0.3f, 0.2f, 0.1f).toRotationMatrix();
+    Mesh out = mesh;
+
+    double perVertex = timeNs(iterations, [&]()
+                              {
+        for (int i = 0; i < triangleCount; i++)
+        {
+            const Triangle &t = mesh.triangles[i];
+            out.triangles[i] = Triangle(
+                MeshVertex(m * t.v1.position, m * t.v1.normal),
+                MeshVertex(m * t.v2.position, m * t.v2.normal),
+                MeshVertex(m * t.v3.position, m * t.v3.normal));
+        }
+        sink = out.triangles[triangleCount - 1].v3.position.x; });
+
+    double batched = timeNs(iterations, [&]()
+                            {
+        const MeshVertex *in = &mesh.triangles[0].v1;
+        MeshVertex *o = &out.triangles[0].v1;
+        m.transformVertices(&in->position, &in->normal, &o->position, &o->normal, (size_t)triangleCount * 3, 2, 2);
+        sink = out.triangles[triangleCount - 1].v3.position.x; });
+
+    printRow(std::to_string(triangleCount) + " tris", perVertex, batched);
+}
+
+void benchBatchTransform()
+{
+    std::cout << "batch transform: per vertex vs batched " << VecKernels::name() << " (positions + normals)" << std::endl;
+    // the small mesh stays in cache, the large one is bound by memory bandwidth
+    benchBatchTransform(1000, 2000);
+    benchBatchTransform(20000, 100);
+}
+
+/// @brief Transforms meshes of increasing size into a reused output buffer
+/// @details The time per triangle should stay flat -- the transform is linear in the triangle count
+void benchTransformScaling()
+{
+    std::cout << "transform scaling: Mesh::transform into a reused buffer (" << VecKernels::name() << ")" << std::endl;
+    const int triangleCounts[] = {10000, 100000, 1000000, 5000000};
+    Matrix m = Matrix::translation(Vec(1, 2, 3)) * Quaternion(0.3f, 0.2f, 0.1f).toRotationMatrix();
+    Mesh out;
+
+    for (int triangleCount : triangleCounts)
+    {
+        Mesh mesh = randomMesh(triangleCount);
+        // the first transform sizes the output buffer, every later one reuses it
+        mesh.transform(m, out);
+        int iterations = std::max(3, 20000000 / triangleCount);
+        double ns = timeNs(iterations, [&]()
+                           {
+            mesh.transform(m, out);
+            sink = out.triangles[triangleCount - 1].v3.position.x; });
+
+        std::cout << "  " << std::left << std::setw(12) << triangleCount << std::right << std::fixed << std::setprecision(3)
+                  << std::setw(12) << ns / 1e6 << " ms" << std::setw(10) << ns / triangleCount << " ns/triangle" << std::endl;
+    }
+}
+
+/// @brief Renders the same scene over and over, and counts the heap allocations of every frame
+/// @details Once the frame arena has grown to fit the scene, a frame should not allocate at all
+void benchFrameAllocations()
+{
+    RasciiRenderer renderer(RenderSettings(200, 60, 90.0f, 0.1f, 100.0f));
+    SceneGraph sceneGraph;
+    for (int i = 0; i < 8; i++)
+    {
+        Mesh mesh = randomMesh(2000);
+        // push the meshes in front of the camera
+        for (Triangle &triangle : mesh.triangles)
+        {
+            triangle.v1.position.z -= 30.0f;
+            triangle.v2.position.z -= 30.0f;
+            triangle.v3.position.z -= 30.0f;
+        }
+        mesh.computeBounds();
+        auto node = std::make_shared<TransformNode>(Transform(), RenderInfo(std::make_shared<Mesh>(mesh)));
+        sceneGraph.root->children.push_back(node);
+    }
+
+    std::cout << "frame allocations: 8 nodes x 2000 triangles, 200x60 (" << VecKernels::name() << ")" << std::endl;
+    for (int frame = 0; frame < 6; frame++)
+    {
+        size_t before = heapAllocations;
+        auto start = std::chrono::high_resolution_clock::now();
+        renderer.invalidate();
+        renderer.prepare();
+        renderer.render(sceneGraph);
+        auto end = std::chrono::high_resolution_clock::now();
+        size_t allocations = heapAllocations - before;
+
+        const RenderStats &stats = renderer.getStats();
+        std::cout << "  frame " << frame << std::fixed << std::setprecision(3)
+                  << std::setw(10) << std::chrono::duration<double, std::milli>(end - start).count() << " ms"
+                  << std::setw(6) << allocations << " heap allocations"
+                  << std::setw(10) << stats.arenaBytesUsed << " arena bytes" << std::endl;
+    }
+}
+
+/// @brief Renders a ring of meshes around the camera -- most of them are behind it or off to the side
+void benchFrustumCulling()
+{
+    RasciiRenderer renderer(RenderSettings(200, 60, 90.0f, 0.1f, 100.0f));
+    SceneGraph sceneGraph;
+    auto mesh = std::make_shared<Mesh>(randomMesh(2000));
+    const int nodeCount = 64;
+    for (int i = 0; i < nodeCount; i++)
+    {
+        float angle = 6.2831853f * i / nodeCount;
+        auto node = std::make_shared<TransformNode>(Transform(), RenderInfo(mesh));
+        node->transform.move(Vec(40.0f * std::sin(angle), 0.0f, -40.0f * std::cos(angle)));
+        sceneGraph.addChild(node);
+    }
+
+    renderer.invalidate();
+
+    renderer.prepare();
+    renderer.render(sceneGraph);
+    double ns = timeNs(20, [&]()
+                       {
+        renderer.invalidate();
+        renderer.prepare();
+        renderer.render(sceneGraph); });
+
+    const RenderStats &stats = renderer.getStats();
+    std::cout << "frustum culling: " << nodeCount << " nodes x 2000 triangles in a ring around the camera" << std::endl;
+    std::cout << "  " << std::fixed << std::setprecision(3) << ns / 1e6 << " ms/frame, " << stats.nodesDrawn << " drawn, "
+              << stats.nodesCulled << " culled" << std::endl;
+}
+
+/// @brief Renders thousands of small props, grouped under parent nodes, and the same props without the groups
+/// @details With groups, each group out of view is rejected with one test of its merged bounds
+void benchHierarchicalCulling()
+{
+    const int groupCount = 100;
+    const int propsPerGroup = 50;
+    auto prop = std::make_shared<Mesh>(Mesh::centeredQuad());
+
+    SceneGraph grouped, ungrouped;
+    for (int g = 0; g < groupCount; g++)
+    {
+        float angle = 6.2831853f * g / groupCount;
+        Vec center(60.0f * std::sin(angle), 0.0f, -60.0f * std::cos(angle));
+        auto group = std::make_shared<TransformNode>();
+        group->transform.move(center);
+        grouped.addChild(group);
+        for (int p = 0; p < propsPerGroup; p++)
+        {
+            Vec offset((float)(p % 10) * 0.5f, (float)(p / 10) * 0.5f, 0.0f);
+            auto groupedProp = std::make_shared<TransformNode>(Transform(), RenderInfo(prop));
+            groupedProp->transform.move(offset);
+            group->addChild(groupedProp);
+
+            auto ungroupedProp = std::make_shared<TransformNode>(Transform(), RenderInfo(prop));
+            ungroupedProp->transform.move(center + offset);
+            ungrouped.addChild(ungroupedProp);
+        }
+    }
+
+    RasciiRenderer renderer(RenderSettings(200, 60, 90.0f, 0.1f, 100.0f));
+    std::cout << "hierarchical culling: " << groupCount << " groups x " << propsPerGroup << " props, ungrouped vs grouped" << std::endl;
+    SceneGraph *graphs[] = {&ungrouped, &grouped};
+    double ns[2];
+    for (int i = 0; i < 2; i++)
+    {
+        renderer.prepare();
+        renderer.render(*graphs[i]);
+        ns[i] = timeNs(200, [&]()
+                       {
+            renderer.invalidate();
+            renderer.prepare();
+            renderer.render(*graphs[i]); });
+        const RenderStats &stats = renderer.getStats();
+        std::cout << "  " << (i == 0 ? "ungrouped" : "grouped  ") << std::fixed << std::setprecision(3) << std::setw(10) << ns[i] / 1e3
+                  << " us/frame" << std::setw(7) << stats.nodesVisited << " visited" << std::setw(7) << stats.nodesDrawn
+                  << " drawn" << std::setw(7) << stats.nodesCulled << " culled" << std::endl;
+    }
+}
+
+/// @brief Builds a closed sphere, wound so that the faces towards the viewer are clockwise on screen
+static Mesh closedSphere(int rings, int segments)
+{
+    std::vector<Triangle> triangles;
+    auto point = [&](int ring, int segment)
+    {
+        float theta = 3.14159265f * ring / rings;
+        float phi = 6.2831853f * segment / segments;
+        return Vec(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+    };
+    for (int r = 0; r < rings; r++)
+    {
+        for (int g = 0; g < segments; g++)
+        {
+            Vec a = point(r, g), b = point(r, g + 1), c = point(r + 1, g + 1), d = point(r + 1, g);
+            Triangle quad[2] = {Triangle(a, b, c), Triangle(a, c, d)};
+            for (Triangle &triangle : quad)
+            {
+                // front faces have their normal pointing away from the viewer -- on a closed mesh, that is inwards
+                Vec centroid = (triangle.v1.position + triangle.v2.position + triangle.v3.position) / 3.0f;
+                if (triangle.v1.normal.dot(centroid.xyz()) > 0.0f)
+                {
+                    triangle.reverseSelf();
+                    triangle.setAutoNormal();
+                }
+                triangles.push_back(triangle);
+            }
+        }
+    }
+    return Mesh(triangles);
+}
+
+/// @brief Renders a closed mesh with and without backface culling
+void benchBackfaceCulling()
+{
+    auto sphere = std::make_shared<Mesh>(closedSphere(64, 128));
+    std::cout << "backface culling: closed sphere, " << sphere->getTriangleCount() << " triangles, 200x60" << std::endl;
+    RasciiRenderer renderer(RenderSettings(200, 60, 90.0f, 0.1f, 100.0f));
+    const CullMode modes[] = {CULL_NONE, CULL_BACK};
+    for (CullMode mode : modes)
+    {
+        SceneGraph sceneGraph;
+        auto node = std::make_shared<TransformNode>(Transform(), RenderInfo(sphere, mode));
+        node->transform.move(Vec(0, 0, -2.5f));
+        sceneGraph.addChild(node);
+
+        renderer.invalidate();
+
+        renderer.prepare();
+        renderer.render(sceneGraph);
+        double ns = timeNs(50, [&]()
+                           {
+            renderer.invalidate();
+            renderer.prepare();
+            renderer.render(sceneGraph); });
+        const RenderStats &stats = renderer.getStats();
+        std::cout << "  " << (mode == CULL_NONE ? "CULL_NONE" : "CULL_BACK") << std::fixed << std::setprecision(3) << std::setw(10)
+                  << ns / 1e6 << " ms/frame" << std::setw(8) << stats.trianglesDrawn << " drawn" << std::setw(8)
+                  << stats.trianglesCulled << " culled" << std::endl;
+    }
+}
+
+/// @brief Builds the world matrix of a node from scratch by recursing to the root, as it was before matrices were cached
+static Matrix uncachedWorldMatrix(const TransformNode *node)
+{
+    Matrix local = node->transform.toTransformationMatrix();
+    return node->parent == nullptr ? local : uncachedWorldMatrix(node->parent) * local;
+}
+
+/// @brief Compares rebuilding every world matrix from scratch with the cached, top-down world matrix pass
+/// @details Uses 20 chains of 50 bones each -- the uncached cost grows with the square of the depth
+void benchWorldMatrices()
+{
+    const int chains = 20;
+    const int depth = 50;
+    const int iterations = 200;
+
+    SceneGraph sceneGraph;
+    std::vector<TransformNode *> nodes;
+    std::vector<TransformNode *> chainRoots;
+    for (int c = 0; c < chains; c++)
+    {
+        TransformNode *parent = sceneGraph.root.get();
+        for (int d = 0; d < depth; d++)
+        {
+            auto node = std::make_shared<TransformNode>();
+            node->transform.move(Vec(0.0f, 1.0f, 0.0f));
+            node->transform.rotate(Quaternion::fromAxisAngle(Vec(0, 0, 1), 0.01f * d));
+            parent->addChild(node);
+            nodes.push_back(node.get());
+            parent = node.get();
+        }
+        chainRoots.push_back(nodes[c * depth]);
+    }
+    Quaternion spin = Quaternion::fromAxisAngle(Vec(0, 1, 0), 0.001f);
+
+    double uncached = timeNs(iterations, [&]()
+                             {
+        float sum = 0;
+        for (TransformNode *node : nodes)
+        {
+            sum += uncachedWorldMatrix(node).elements[3];
+        }
+        sink = sum; });
+
+    // every chain root moves every frame, so every matrix below it is rebuilt -- the worst case for the cache
+    double allDirty = timeNs(iterations, [&]()
+                             {
+        for (TransformNode *root : chainRoots)
+        {
+            root->transform.rotate(spin);
+        }
+        sceneGraph.updateWorldMatrices();
+        sink = nodes.back()->getWorldMatrix().elements[3]; });
+
+    // only the tip of one chain moves
+    double oneDirty = timeNs(iterations, [&]()
+                             {
+        nodes.back()->transform.rotate(spin);
+        sceneGraph.updateWorldMatrices();
+        sink = nodes.back()->getWorldMatrix().elements[3]; });
+
+    // the same two cases, as one sweep in depth first order over the flattened graph
+    FlatSceneGraph flat;
+    flat.update(sceneGraph);
+    double flatAllDirty = timeNs(iterations, [&]()
+                                 {
+        for (TransformNode *root : chainRoots)
+        {
+            root->transform.rotate(spin);
+        }
+        flat.update(sceneGraph);
+        sink = flat.worldMatrices.back().elements[3]; });
+
+    double flatOneDirty = timeNs(iterations, [&]()
+                                 {
+        nodes.back()->transform.rotate(spin);
+        flat.update(sceneGraph);
+        sink = flat.worldMatrices.back().elements[3]; });
+
+    std::cout << "world matrices: " << chains << " chains x " << depth << " levels, uncached vs cached top-down pass" << std::endl;
+    printRow("all dirty", uncached, allDirty);
+    printRow("one dirty", uncached, oneDirty);
+    std::cout << "world matrices: cached tree pass vs flattened sweep" << std::endl;
+    printRow("all dirty", allDirty, flatAllDirty);
+    printRow("one dirty", oneDirty, flatOneDirty);
+}
+
+void benchNearPlaneClipping()
+{
+    // a floor just below the eye that runs from behind the camera to far in front of it, the usual source of near plane
+    // crossings
+    const int tiles = 64;
+    std::vector<Triangle> triangles;
+    for (int i = 0; i < tiles; i++)
+    {
+        for (int j = 0; j < tiles; j++)
+        {
+            float x = (float)(i - tiles / 2) * 0.25f, z = (float)(j - 8) * 0.25f;
+            triangles.push_back(Triangle(Vec(x, -0.01f, z), Vec(x + 0.25f, -0.01f, z), Vec(x, -0.01f, z - 0.25f)));
+            triangles.push_back(Triangle(Vec(x + 0.25f, -0.01f, z), Vec(x + 0.25f, -0.01f, z - 0.25f), Vec(x, -0.01f, z - 0.25f)));
+        }
+    }
+    auto floor = std::make_shared<Mesh>(triangles);
+    std::cout << "near plane clipping: floor through the camera, " << floor->getTriangleCount() << " triangles, 200x60" << std::endl;
+
+    RasciiRenderer renderer(RenderSettings(200, 60, 90.0f, 0.1f, 100.0f));
+    SceneGraph sceneGraph;
+    sceneGraph.root->renderInfo = RenderInfo(floor, CULL_NONE);
+    renderer.prepare();
+    renderer.render(sceneGraph);
+    double ns = timeNs(50, [&]()
+                       {
+        renderer.invalidate();
+        renderer.prepare();
+        renderer.render(sceneGraph); });
+    const RenderStats &stats = renderer.getStats();
+    std::cout << "  " << std::fixed << std::setprecision(3) << ns / 1e6 << " ms/frame" << std::setw(8) << stats.trianglesDrawn
+              << " drawn" << std::setw(8) << stats.trianglesClipped << " clipped" << std::setw(8) << stats.trianglesOutside
+              << " outside" << std::endl;
+}
+
+void benchRenderModes()
+{
+    auto sphere = std::make_shared<Mesh>(closedSphere(64, 128));
+    std::cout << "render modes: closed sphere, " << sphere->getTriangleCount() << " triangles, 200x60, CULL_BACK" << std::endl;
+    const RenderMode modes[] = {RENDER_WIREFRAME, RENDER_SOLID, RENDER_SOLID_WIREFRAME};
+    const char *names[] = {"wireframe", "solid", "solid+wire"};
+    for (int m = 0; m < 3; m++)
+    {
+        RasciiRenderer renderer(RenderSettings(200, 60, 90.0f, 0.1f, 100.0f, modes[m]));
+        SceneGraph sceneGraph;
+        auto node = std::make_shared<TransformNode>(Transform(), RenderInfo(sphere, CULL_BACK));
+        node->transform.move(Vec(0, 0, -2.5f));
+        sceneGraph.addChild(node);
+
+        renderer.invalidate();
+
+        renderer.prepare();
+        renderer.render(sceneGraph);
+        double ns = timeNs(50, [&]()
+                           {
+            renderer.invalidate();
+            renderer.prepare();
+            renderer.render(sceneGraph); });
+        std::cout << "  " << std::left << std::setw(12) << names[m] << std::right << std::fixed << std::setprecision(3)
+                  << std::setw(8) << ns / 1e6 << " ms/frame" << std::endl;
+    }
+}
+
+void benchFillRate()
+{
+    const int width = 200, height = 60, count = 1000;
+    std::cout << "fill rate: " << count << " random triangles per size, " << width << "x" << height
+              << " (scanline, no depth test / scalar edge / " << RasterKernels::name() << " edge, depth tested)" << std::endl;
+    auto texture = std::make_shared<Texture>(width, height);
+    auto depth = std::make_shared<DepthBuffer>(width, height);
+    TextureDrawer drawer(texture, depth);
+    const Color color = Color::greyscale(1.0f);
+
+    const float sizes[] = {4.0f, 16.0f, 64.0f};
+    for (float size : sizes)
+    {
+        std::mt19937 rng(3);
+        std::uniform_real_distribution<float> corner(0.0f, 1.0f), jitter(-size, size), invW(0.1f, 1.0f);
+        std::vector<Vec> corners;
+        for (int i = 0; i < count; i++)
+        {
+            float x = corner(rng) * width, y = corner(rng) * height;
+            for (int k = 0; k < 3; k++)
+            {
+                corners.push_back(Vec(x + jitter(rng), y + jitter(rng) * 0.5f, 0.0f, invW(rng)));
+            }
+        }
+        std::vector<RasterTriangle> triangles(count);
+        std::vector<bool> valid(count);
+        for (int i = 0; i < count; i++)
+        {
+            valid[i] = triangles[i].setup(corners[i * 3], corners[i * 3 + 1], corners[i * 3 + 2], width, height);
+        }
+        RasterTarget target(reinterpret_cast<uint32_t *>(texture->getPixels()), depth->getDepths(), width, height);
+
+        double scanlineNs = timeNs(20, [&]()
+                                   {
+            for (int i = 0; i < count; i++)
+            {
+                drawer.fillTriangleScanline(corners[i * 3], corners[i * 3 + 1], corners[i * 3 + 2], color);
+            } });
+        double scalarNs = timeNs(20, [&]()
+                                 {
+            depth->clear();
+            for (int i = 0; i < count; i++)
+            {
+                if (valid[i])
+                {
+                    ScalarRasterKernels::fill(triangles[i], target, 0xffffffffu);
+                }
+            } });
+        double simdNs = timeNs(20, [&]()
+                               {
+            depth->clear();
+            for (int i = 0; i < count; i++)
+            {
+                if (valid[i])
+                {
+                    RasterKernels::fill(triangles[i], target, 0xffffffffu);
+                }
+            } });
+        std::cout << "  " << std::left << std::setw(12) << ("~" + std::to_string((int)size) + " px") << std::right
+                  << std::fixed << std::setprecision(3) << std::setw(10) << scanlineNs / 1e6 << " ms" << std::setw(10)
+                  << scalarNs / 1e6 << " ms" << std::setw(10) << simdNs / 1e6 << " ms" << std::setw(8) << std::setprecision(2)
+                  << scalarNs / simdNs << "x" << std::endl;
+    }
+}
+
+void benchTiledRaster()
+{
+    // many small, overlapping spheres, so that the raster has plenty of work in every tile
+    auto sphere = std::make_shared<Mesh>(closedSphere(32, 64));
+    SceneGraph sceneGraph;
+    for (int i = 0; i < 64; i++)
+    {
+        auto node = std::make_shared<TransformNode>(Transform(), RenderInfo(sphere, CULL_BACK));
+        node->transform.move(Vec((float)(i % 8) * 0.1f - 0.35f, (float)(i / 8) * 0.1f - 0.35f, -3.0f - (float)(i % 3) * 0.2f));
+        node->transform.scaleBy(Vec(0.1f, 0.1f, 0.1f));
+        sceneGraph.addChild(node);
+    }
+    std::cout << "tiled raster: 64 spheres, " << 64 * sphere->getTriangleCount() << " triangles, 300x100, solid+wire ("
+              << std::thread::hardware_concurrency() << " hardware threads)" << std::endl;
+
+    double baseline = 0.0;
+    const int threadCounts[] = {1, 2, 4, 8};
+    for (int threads : threadCounts)
+    {
+        RasciiRenderer renderer(RenderSettings(300, 100, 90.0f, 0.1f, 100.0f, RENDER_SOLID_WIREFRAME, threads));
+        renderer.prepare();
+        renderer.render(sceneGraph);
+        double ns = timeNs(20, [&]()
+                           {
+            renderer.invalidate();
+            renderer.prepare();
+            renderer.render(sceneGraph); });
+        baseline = threads == 1 ? ns : baseline;
+        const RenderStats &stats = renderer.getStats();
+        std::cout << "  " << std::setw(2) << threads << " threads" << std::fixed << std::setprecision(3) << std::setw(10)
+                  << ns / 1e6 << " ms/frame" << std::setw(8) << std::setprecision(2) << baseline / ns << "x" << std::setw(9)
+                  << stats.drawCommands << " commands" << std::setw(9) << stats.binnedCommands << " binned" << std::endl;
+    }
+}
+
+/// @brief Renders a vertex heavy scene with a serial and a parallel vertex stage, over several thread counts
+void benchVertexStage()
+{
+    // a few dense meshes, plain and indexed, that each split into many jobs -- drawn as wireframes, so that the vertex
+    // stage dominates the frame
+    auto sphere = std::make_shared<Mesh>(closedSphere(128, 256));
+    auto indexed = std::make_shared<IndexedMesh>(IndexedMesh::fromMesh(*sphere));
+    SceneGraph sceneGraph;
+    for (int i = 0; i < 8; i++)
+    {
+        RenderInfo renderInfo = i % 2 == 0 ? RenderInfo(sphere, CULL_BACK) : RenderInfo(indexed, CULL_BACK);
+        auto node = std::make_shared<TransformNode>(Transform(), renderInfo);
+        node->transform.move(Vec((float)(i % 4) * 0.3f - 0.45f, (float)(i / 4) * 0.3f - 0.15f, -3.0f));
+        node->transform.scaleBy(Vec(0.12f, 0.12f, 0.12f));
+        sceneGraph.addChild(node);
+    }
+    std::cout << "vertex stage: 8 spheres, " << 8 * sphere->getTriangleCount() << " triangles, 200x60, wireframe ("
+              << std::thread::hardware_concurrency() << " hardware threads)" << std::endl;
+
+    double baseline = 0.0;
+    const int threadCounts[] = {1, 2, 4, 8};
+    for (int threads : threadCounts)
+    {
+        const int vertexThreads[] = {1, 0};
+        for (int vertexThreadCount : vertexThreads)
+        {
+            RasciiRenderer renderer(RenderSettings(200, 60, 90.0f, 0.1f, 100.0f, RENDER_WIREFRAME, threads, vertexThreadCount));
+            renderer.prepare();
+            renderer.render(sceneGraph);
+            double ns = timeNs(20, [&]()
+                               {
+                renderer.invalidate();
+                renderer.prepare();
+                renderer.render(sceneGraph); });
+            baseline = threads == 1 && vertexThreadCount == 1 ? ns : baseline;
+            std::cout << "  " << std::setw(2) << threads << " threads, " << (vertexThreadCount == 1 ? "serial  " : "parallel")
+                      << " vertex stage" << std::fixed << std::setprecision(3) << std::setw(10) << ns / 1e6 << " ms/frame"
+                      << std::setw(8) << std::setprecision(2) << baseline / ns << "x" << std::setw(6)
+                      << renderer.getStats().vertexJobs << " jobs" << std::endl;
+        }
+    }
+}
+
+/// @brief Renders plain sphere meshes with the vertex cache off and on
+/// @details Each vertex of a sphere is a corner of about 6 triangles -- the cache transforms it once instead
+void benchVertexCache()
+{
+    auto sphere = std::make_shared<Mesh>(closedSphere(128, 256));
+    SceneGraph sceneGraph;
+    for (int i = 0; i < 8; i++)
+    {
+        auto node = std::make_shared<TransformNode>(Transform(), RenderInfo(sphere, CULL_BACK));
+        node->transform.move(Vec((float)(i % 4) * 0.3f - 0.45f, (float)(i / 4) * 0.3f - 0.15f, -3.0f));
+        node->transform.scaleBy(Vec(0.12f, 0.12f, 0.12f));
+        sceneGraph.addChild(node);
+    }
+    std::cout << "vertex cache: 8 spheres, " << 8 * sphere->getTriangleCount() << " triangles, 200x60, solid, 1 thread"
+              << std::endl;
+
+    double baseline = 0.0;
+    const bool caches[] = {false, true};
+    for (bool vertexCache : caches)
+    {
+        RasciiRenderer renderer(RenderSettings(200, 60, 90.0f, 0.1f, 100.0f, RENDER_SOLID, 1, 1, vertexCache));
+        renderer.prepare();
+        renderer.render(sceneGraph);
+        double ns = timeNs(20, [&]()
+                           {
+            renderer.invalidate();
+            renderer.prepare();
+            renderer.render(sceneGraph); });
+        baseline = vertexCache ? baseline : ns;
+        const RenderStats &stats = renderer.getStats();
+        std::cout << "  cache " << (vertexCache ? "on " : "off") << std::fixed << std::setprecision(3) << std::setw(10)
+                  << ns / 1e6 << " ms/frame" << std::setw(8) << std::setprecision(2) << baseline / ns << "x"
+                  << std::setw(9) << stats.verticesTransformed << " vertices" << std::setw(7) << std::setprecision(1)
+                  << stats.getVertexCacheHitRate() * 100.0f << "% hits" << std::endl;
+    }
+}
+
+/// @brief Renders a ring of props with a still camera, and with a camera that turns every frame
+/// @details A turning camera only rebuilds the view -- the world matrices and bounds of the props stay cached
+void benchCameraMotion()
+{
+    const int propCount = 2000;
+    auto prop = std::make_shared<Mesh>(Mesh::centeredQuad());
+    SceneGraph sceneGraph;
+    for (int i = 0; i < propCount; i++)
+    {
+        float angle = 6.2831853f * i / propCount;
+        auto node = std::make_shared<TransformNode>(Transform(), RenderInfo(prop, CULL_NONE));
+        node->transform.move(Vec(20.0f * std::sin(angle), (float)(i % 5) - 2.0f, -20.0f * std::cos(angle)));
+        sceneGraph.addChild(node);
+    }
+    auto camera = std::make_shared<Camera>(90.0f, 0.1f, 100.0f);
+    sceneGraph.addChild(camera);
+
+    RasciiRenderer renderer(RenderSettings(200, 60, 90.0f, 0.1f, 100.0f));
+    renderer.setCamera(camera);
+    std::cout << "camera motion: " << propCount << " props in a ring around the camera, 200x60" << std::endl;
+    const char *names[] = {"still  ", "turning"};
+    for (int turning = 0; turning < 2; turning++)
+    {
+        renderer.prepare();
+        renderer.render(sceneGraph);
+        int viewRebuilds = 0;
+        double ns = timeNs(200, [&]()
+                           {
+            if (turning)
+            {
+                camera->look(0.01f, 0.0f);
+            }
+            renderer.prepare();
+            renderer.render(sceneGraph);
+            viewRebuilds += renderer.getStats().viewRebuilds; });
+        std::cout << "  " << names[turning] << std::fixed << std::setprecision(3) << std::setw(10) << ns / 1e3 << " us/frame"
+                  << std::setw(7) << renderer.getStats().nodesDrawn << " drawn" << std::setw(7) << viewRebuilds
+                  << " view rebuilds" << std::endl;
+    }
+}
+
+/// @brief Renders a wall of spheres where only one of them spins -- drawn in full, incrementally, and with nothing moving
+/// @details Incremental frames only draw the tiles around the spinning sphere again, and a still frame draws nothing
+void benchDirtyRegions()
+{
+    auto sphere = std::make_shared<Mesh>(closedSphere(16, 32));
+    SceneGraph sceneGraph;
+    std::vector<std::shared_ptr<TransformNode>> nodes;
+    for (int i = 0; i < 400; i++)
+    {
+        auto node = std::make_shared<TransformNode>(Transform(), RenderInfo(sphere, CULL_BACK));
+        node->transform.move(Vec((float)(i % 20) * 0.4f - 3.8f, (float)(i / 20) * 0.25f - 2.375f, -6.0f));
+        node->transform.scaleBy(Vec(0.12f, 0.12f, 0.12f));
+        sceneGraph.addChild(node);
+        nodes.push_back(node);
+    }
+    Quaternion spin = Quaternion::fromAxisAngle(Vec(0, 1, 0), 0.05f);
+    std::cout << "dirty regions: 400 spheres, " << 400 * sphere->getTriangleCount() << " triangles, 200x60, solid" << std::endl;
+
+    const char *names[] = {"full redraw", "one spinning", "still"};
+    double baseline = 0.0;
+    for (int run = 0; run < 3; run++)
+    {
+        RasciiRenderer renderer(RenderSettings(200, 60, 90.0f, 0.1f, 100.0f, RENDER_SOLID, 1));
+        renderer.prepare();
+        renderer.render(sceneGraph);
+        double ns = timeNs(50, [&]()
+                           {
+            if (run == 0)
+            {
+                renderer.invalidate();
+            }
+            if (run < 2)
+            {
+                nodes[210]->transform.rotate(spin);
+            }
+            renderer.prepare();
+            renderer.render(sceneGraph); });
+        baseline = run == 0 ? ns : baseline;
+        const RenderStats &stats = renderer.getStats();
+        std::cout << "  " << std::left << std::setw(13) << names[run] << std::right << std::fixed << std::setprecision(3)
+                  << std::setw(10) << ns / 1e3 << " us/frame" << std::setw(9) << std::setprecision(1) << baseline / ns
+                  << "x" << std::setw(5) << stats.tilesRedrawn << " tiles" << std::setw(6) << stats.nodesDrawn << " drawn"
+                  << std::endl;
+    }
+}
+
+/// @brief Sends rendered frames through the ascii display, into /dev/null, and counts the bytes of each frame
+/// @details A full repaint sends every cell; the diff only sends the runs of cells that changed
+void benchAsciiDisplay()
+{
+    auto sphere = std::make_shared<Mesh>(closedSphere(16, 32));
+    SceneGraph sceneGraph;
+    std::vector<std::shared_ptr<TransformNode>> nodes;
+    for (int i = 0; i < 25; i++)
+    {
+        auto node = std::make_shared<TransformNode>(Transform(), RenderInfo(sphere, CULL_BACK));
+        node->transform.move(Vec((float)(i % 5) * 1.2f - 2.4f, (float)(i / 5) * 0.8f - 1.6f, -4.0f));
+        node->transform.scaleBy(Vec(0.35f, 0.35f, 0.35f));
+        sceneGraph.addChild(node);
+        nodes.push_back(node);
+    }
+    auto camera = std::make_shared<Camera>(90.0f, 0.1f, 100.0f);
+    sceneGraph.addChild(camera);
+    Quaternion spin = Quaternion::fromAxisAngle(Vec(1, 1, 0), 0.1f);
+
+    FILE *devNull = fopen("/dev/null", "w");
+    if (devNull == nullptr)
+    {
+        return;
+    }
+    const int width = 200, height = 60;
+    std::cout << "ascii display: 25 spheres, 200x60, solid, into /dev/null -- a full frame is "
+              << AsciiDisplay(width, height).getBufferSize() + 3 << " bytes" << std::endl;
+    const char *names[] = {"one spinning", "camera turning", "still"};
+    for (int run = 0; run < 3; run++)
+    {
+        RasciiRenderer renderer(RenderSettings(width, height, 90.0f, 0.1f, 100.0f, RENDER_SOLID, 1));
+        renderer.setCamera(camera);
+        AsciiDisplay display(width, height, fileno(devNull));
+        display.prepare();
+        renderer.prepare();
+        renderer.render(sceneGraph);
+        display.draw(*renderer.getOutput(), renderer.getDirtyRects());
+
+        const int frames = 50;
+        size_t bytes = 0;
+        int repaints = 0;
+        int writes = 0;
+        double displayNs = 0.0;
+        for (int frame = 0; frame < frames; frame++)
+        {
+            if (run == 0)
+            {
+                nodes[12]->transform.rotate(spin);
+            }
+            else if (run == 1)
+            {
+                camera->look(0.01f, 0.0f);
+            }
+            renderer.prepare();
+            renderer.render(sceneGraph);
+            displayNs += timeNs(1, [&]()
+                                {
+                display.prepare();
+                display.draw(*renderer.getOutput(), renderer.getDirtyRects()); });
+            bytes += display.getStats().bytesWritten;
+            repaints += display.getStats().fullRepaint ? 1 : 0;
+            writes += display.getStats().writeCalls;
+        }
+        std::cout << "  " << std::left << std::setw(15) << names[run] << std::right << std::setw(8) << bytes / frames
+                  << " bytes/frame" << std::setw(4) << repaints << " repaints" << std::fixed << std::setprecision(2)
+                  << std::setw(6) << (double)writes / frames << " writes/frame" << std::setprecision(3)
+                  << std::setw(10) << displayNs / frames / 1e3 << " us/draw" << std::endl;
+    }
+    fclose(devNull);
+}
+
+void benchColorDisplay()
+{
+    auto sphere = std::make_shared<Mesh>(closedSphere(16, 32));
+    SceneGraph sceneGraph;
+    std::vector<std::shared_ptr<TransformNode>> nodes;
+    for (int i = 0; i < 25; i++)
+    {
+        auto node = std::make_shared<TransformNode>(Transform(), RenderInfo(sphere, CULL_BACK));
+        node->transform.move(Vec((float)(i % 5) * 1.2f - 2.4f, (float)(i / 5) * 0.8f - 1.6f, -4.0f));
+        node->transform.scaleBy(Vec(0.35f, 0.35f, 0.35f));
+        sceneGraph.addChild(node);
+        nodes.push_back(node);
+    }
+    Quaternion spin = Quaternion::fromAxisAngle(Vec(1, 1, 0), 0.1f);
+
+    FILE *devNull = fopen("/dev/null", "w");
+    if (devNull == nullptr)
+    {
+        return;
+    }
+    const int width = 200, height = 60;
+    std::cout << "color display: 25 spheres, 200x60, solid, 10 of them spinning, into /dev/null" << std::endl;
+    std::vector<std::shared_ptr<TerminalDisplay>> displays = {
+        std::make_shared<AsciiDisplay>(width, height, fileno(devNull)),
+        std::make_shared<ColorDisplay>(width, height, COLOR_TRUECOLOR, 256, fileno(devNull)),
+        std::make_shared<ColorDisplay>(width, height, COLOR_TRUECOLOR, 32, fileno(devNull)),
+        std::make_shared<ColorDisplay>(width, height, COLOR_TRUECOLOR, 8, fileno(devNull)),
+        std::make_shared<ColorDisplay>(width, height, COLOR_256, 0, fileno(devNull))};
+    const char *names[] = {"ascii", "truecolor", "truecolor/32", "truecolor/8", "256 colors"};
+    for (size_t run = 0; run < displays.size(); run++)
+    {
+        RasciiRenderer renderer(RenderSettings(width, height, 90.0f, 0.1f, 100.0f, RENDER_SOLID, 1));
+        TerminalDisplay &display = *displays[run];
+        display.prepare();
+        renderer.prepare();
+        renderer.render(sceneGraph);
+        display.draw(*renderer.getOutput(), renderer.getDirtyRects());
+        size_t firstFrame = display.getStats().bytesWritten;
+
+        const int frames = 50;
+        size_t bytes = 0, colorChanges = 0;
+        double displayNs = 0.0;
+        for (int frame = 0; frame < frames; frame++)
+        {
+            for (int i = 6; i < 25; i += 2)
+            {
+                nodes[i]->transform.rotate(spin);
+            }
+            renderer.prepare();
+            renderer.render(sceneGraph);
+            displayNs += timeNs(1, [&]()
+                                {
+                display.prepare();
+                display.draw(*renderer.getOutput(), renderer.getDirtyRects()); });
+            bytes += display.getStats().bytesWritten;
+            colorChanges += display.getStats().colorChanges;
+        }
+        std::cout << "  " << std::left << std::setw(14) << names[run] << std::right << std::setw(8) << firstFrame
+                  << " bytes first" << std::setw(8) << bytes / frames << " bytes/frame" << std::setw(7)
+                  << colorChanges / frames << " colors/frame" << std::fixed << std::setprecision(3) << std::setw(10)
+                  << displayNs / frames / 1e3 << " us/draw" << std::endl;
+        display.cleanup();
+    }
+    fclose(devNull);
+}
+
+void benchSubCellDisplays()
+{
+    auto sphere = std::make_shared<Mesh>(closedSphere(16, 32));
+    SceneGraph sceneGraph;
+    std::vector<std::shared_ptr<TransformNode>> nodes;
+    for (int i = 0; i < 25; i++)
+    {
+        auto node = std::make_shared<TransformNode>(Transform(), RenderInfo(sphere, CULL_BACK));
+        node->transform.move(Vec((float)(i % 5) * 1.2f - 2.4f, (float)(i / 5) * 0.8f - 1.6f, -4.0f));
+        node->transform.scaleBy(Vec(0.35f, 0.35f, 0.35f));
+        sceneGraph.addChild(node);
+        nodes.push_back(node);
+    }
+    Quaternion spin = Quaternion::fromAxisAngle(Vec(1, 1, 0), 0.1f);
+
+    FILE *devNull = fopen("/dev/null", "w");
+    if (devNull == nullptr)
+    {
+        return;
+    }
+    const int columns = 100, rows = 30;
+    std::cout << "sub-cell displays: 25 spheres, 100x30 cells, 10 of them spinning, into /dev/null" << std::endl;
+    std::vector<std::shared_ptr<TerminalDisplay>> displays = {
+        std::make_shared<AsciiDisplay>(columns, rows, fileno(devNull)),
+        std::make_shared<HalfBlockDisplay>(columns, rows, COLOR_TRUECOLOR, 32, fileno(devNull)),
+        std::make_shared<HalfBlockDisplay>(columns, rows, COLOR_256, 0, fileno(devNull)),
+        std::make_shared<BrailleDisplay>(columns, rows, 64, fileno(devNull))};
+    const char *names[] = {"ascii", "half blocks", "half/256", "braille"};
+    const RenderMode modes[] = {RENDER_SOLID, RENDER_SOLID, RENDER_SOLID, RENDER_WIREFRAME};
+    for (size_t run = 0; run < displays.size(); run++)
+    {
+        TerminalDisplay &display = *displays[run];
+        RenderSettings settings(1, 1, 90.0f, 0.1f, 100.0f, modes[run], 1);
+        settings.setPixelGrid(columns, rows, display.getPixelsPerColumn(), display.getPixelsPerRow());
+        RasciiRenderer renderer(settings);
+        display.prepare();
+        renderer.prepare();
+        renderer.render(sceneGraph);
+        display.draw(*renderer.getOutput(), renderer.getDirtyRects());
+        size_t firstFrame = display.getStats().bytesWritten;
+
+        const int frames = 50;
+        size_t bytes = 0;
+        double displayNs = 0.0;
+        for (int frame = 0; frame < frames; frame++)
+        {
+            for (int i = 6; i < 25; i += 2)
+            {
+                nodes[i]->transform.rotate(spin);
+            }
+            renderer.prepare();
+            renderer.render(sceneGraph);
+            displayNs += timeNs(1, [&]()
+                                {
+                display.prepare();
+                display.draw(*renderer.getOutput(), renderer.getDirtyRects()); });
+            bytes += display.getStats().bytesWritten;
+        }
+        std::cout << "  " << std::left << std::setw(12) << names[run] << std::right << std::setw(4) << settings.width
+                  << "x" << std::left << std::setw(4) << settings.height << std::right << std::setw(8) << firstFrame
+                  << " bytes first" << std::setw(8) << bytes / frames << " bytes/frame" << std::fixed
+                  << std::setprecision(3) << std::setw(10) << displayNs / frames / 1e3 << " us/draw" << std::endl;
+        display.cleanup();
+    }
+    fclose(devNull);
+
+    // the glyphs come out of a table -- against encoding every cell as it is written
+    std::vector<unsigned char> dots(columns * rows * 4);
+    std::mt19937 rng(5);
+    for (unsigned char &d : dots)
+    {
+        d = (unsigned char)(rng() & 0xFF);
+    }
+    std::vector<char> out;
+    out.reserve(dots.size() * 3);
+    double encoded = timeNs(200, [&]()
+                            {
+        out.clear();
+        for (unsigned char d : dots)
+        {
+            char bytes[4];
+            int length = TerminalDisplay::encodeUtf8(0x2800 + d, bytes);
+            out.insert(out.end(), bytes, bytes + length);
+        }
+        sink = out.back(); });
+    double table = timeNs(200, [&]()
+                          {
+        out.clear();
+        const char *patterns = BrailleDisplay::patterns();
+        for (unsigned char d : dots)
+        {
+            out.insert(out.end(), patterns + d * 3, patterns + d * 3 + 3);
+        }
+        sink = out.back(); });
+    std::cout << "  braille utf-8 of " << dots.size() << " cells: encoded vs table" << std::endl;
+    printRow("utf-8", encoded, table);
+}
+
+/// @brief An ascii display on a slow terminal -- every draw takes at least the given time, like a write that blocks
+struct SlowDisplay : public IDisplay
+{
+    AsciiDisplay display;
+    std::chrono::microseconds delay;
+
+    SlowDisplay(int width, int height, int output, std::chrono::microseconds delay)
+        : display(width, height, output), delay(delay) {}
+
+    void draw(const Texture &tex)
+    {
+        this->display.draw(tex);
+        std::this_thread::sleep_for(this->delay);
+    }
+
+    void draw(const Texture &tex, const std::vector<Rect> &dirtyRects)
+    {
+        this->display.draw(tex, dirtyRects);
+        std::this_thread::sleep_for(this->delay);
+    }
+
+    void prepare()
+    {
+        this->display.prepare();
+    }
+
+    void cleanup()
+    {
+        this->display.cleanup();
+    }
+};
+
+void benchDisplayPresenter()
+{
+    auto sphere = std::make_shared<Mesh>(closedSphere(16, 32));
+    SceneGraph sceneGraph;
+    std::vector<std::shared_ptr<TransformNode>> nodes;
+    for (int i = 0; i < 25; i++)
+    {
+        auto node = std::make_shared<TransformNode>(Transform(), RenderInfo(sphere, CULL_BACK));
+        node->transform.move(Vec((float)(i % 5) * 1.2f - 2.4f, (float)(i / 5) * 0.8f - 1.6f, -4.0f));
+        node->transform.scaleBy(Vec(0.35f, 0.35f, 0.35f));
+        sceneGraph.addChild(node);
+        nodes.push_back(node);
+    }
+    Quaternion spin = Quaternion::fromAxisAngle(Vec(1, 1, 0), 0.1f);
+
+    FILE *devNull = fopen("/dev/null", "w");
+    if (devNull == nullptr)
+    {
+        return;
+    }
+    const int width = 200, height = 60, frames = 100;
+    std::cout << "display presenter: 25 spheres, 200x60, solid, a terminal that takes 5 ms a frame, " << frames
+              << " frames" << std::endl;
+    for (int run = 0; run < 2; run++)
+    {
+        RasciiRenderer renderer(RenderSettings(width, height, 90.0f, 0.1f, 100.0f, RENDER_SOLID, 1));
+        auto display = std::make_shared<SlowDisplay>(width, height, fileno(devNull), std::chrono::microseconds(5000));
+        std::unique_ptr<DisplayPresenter> presenter(run == 1 ? new DisplayPresenter(display) : nullptr);
+
+        auto start = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < frames; frame++)
+        {
+            for (int i = 6; i < 25; i += 2)
+            {
+                nodes[i]->transform.rotate(spin);
+            }
+            renderer.prepare();
+            renderer.render(sceneGraph);
+            if (presenter != nullptr)
+            {
+                presenter->submit(*renderer.getOutput(), renderer.getDirtyRects());
+            }
+            else
+            {
+                display->prepare();
+                display->draw(*renderer.getOutput(), renderer.getDirtyRects());
+            }
+        }
+        double renderMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        if (presenter != nullptr)
+        {
+            presenter->flush();
+            PresenterStats stats = presenter->getStats();
+            std::cout << "  presenter  " << std::fixed << std::setprecision(3) << std::setw(8) << renderMs / frames
+                      << " ms/frame rendered" << std::setw(5) << stats.framesPresented << " presented" << std::setw(5)
+                      << stats.framesDropped << " dropped" << std::endl;
+        }
+        else
+        {
+            display->cleanup();
+            std::cout << "  in line    " << std::fixed << std::setprecision(3) << std::setw(8) << renderMs / frames
+                      << " ms/frame rendered" << std::setw(5) << frames << " presented" << std::setw(5) << 0
+                      << " dropped" << std::endl;
+        }
+    }
+    fclose(devNull);
+}
+
+void benchFrameOutput()
+{
+    FILE *devNull = fopen("/dev/null", "w");
+    if (devNull == nullptr)
+    {
+        return;
+    }
+    const int width = 200, height = 60;
+    Texture texture(width, height);
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            texture.set(x, y, Color::greyscale((float)((x + y) % 10) / 10.0f));
+        }
+    }
+    AsciiDisplay display(width, height, fileno(devNull));
+    display.prepare();
+    display.draw(texture);
+    const int frameWrites = display.getStats().writeCalls;
+    display.cleanup();
+    const int cleanupWrites = display.getStats().writeCalls - frameWrites;
+
+    // the bytes of a first frame and of the cleanup after it, written the way they went out before -- every control
+    // sequence a write of its own -- and gathered the way the display writes them now
+    std::string frame = "\x1b[H";
+    for (int y = 0; y < height; y++)
+    {
+        frame += std::string(width, '#') + "\n";
+    }
+    std::string clear = "\x1b[H\x1b[J", hide = "\x1b[?25l", show = "\x1b[?25h";
+    std::string opening = clear + hide, closing = clear + show;
+    const int fd = fileno(devNull);
+    const int iters = 2000;
+    ssize_t sink = 0;
+    double separate = timeNs(iters, [&]()
+                             {
+        sink += ::write(fd, clear.data(), clear.size());
+        sink += ::write(fd, hide.data(), hide.size());
+        sink += ::write(fd, frame.data(), frame.size());
+        sink += ::write(fd, clear.data(), clear.size());
+        sink += ::write(fd, show.data(), show.size()); });
+    double gathered = timeNs(iters, [&]()
+                             {
+        struct iovec parts[2] = {{&opening[0], opening.size()}, {&frame[0], frame.size()}};
+        sink += ::writev(fd, parts, 2);
+        sink += ::write(fd, closing.data(), closing.size()); });
+    std::cout << "frame output: a first frame of 200x60 and the cleanup after it, into /dev/null -- the display takes "
+              << frameWrites << " write for the frame and " << cleanupWrites << " for the cleanup, 5 before"
+              << std::endl;
+    printRow("first frame", separate, gathered);
+    fclose(devNull);
+}
+
+void benchAsciiConvert()
+{
+    const int width = 400, height = 120;
+    std::mt19937 rng(11);
+    std::uniform_int_distribution<int> channel(0, 255);
+    Texture texture(width, height);
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            texture.set(x, y, Color((unsigned char)channel(rng), (unsigned char)channel(rng), (unsigned char)channel(rng)));
+        }
+    }
+    // laid out like the output buffer of the display, a newline after every row
+    std::vector<char> buffer((width + 1) * height, '\n');
+    const int iterations = 200;
+
+    double perPixel = timeNs(iterations, [&]()
+                             {
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                buffer[y * (width + 1) + x] = AsciiDisplay::luminanceToAscii(texture.get(x, y).getLuminance());
+            }
+        }
+        sink = buffer[0]; });
+
+    double kernel = timeNs(iterations, [&]()
+                           {
+        for (int y = 0; y < height; y++)
+        {
+            AsciiDisplay::convertRow(texture.getPixels() + y * width, width, buffer.data() + y * (width + 1));
+        }
+        sink = buffer[0]; });
+
+    std::cout << "ascii convert: per pixel float luminance vs " << VecKernels::name()
+              << " luma + table (per frame)" << std::endl;
+    printRow(std::to_string(width) + "x" + std::to_string(height), perPixel, kernel);
+}
+
+int main(int argc, char **argv)
+{
+    struct
+    {
+        const char *name;
+        void (*run)();
+    } benchmarks[] = {
+        {"vec_kernels", benchVecKernels},
+        {"batch_transform", benchBatchTransform},
+        {"transform_scaling", benchTransformScaling},
+        {"frame_allocations", benchFrameAllocations},
+        {"world_matrices", benchWorldMatrices},
+        {"frustum_culling", benchFrustumCulling},
+        {"hierarchical_culling", benchHierarchicalCulling},
+        {"backface_culling", benchBackfaceCulling},
+        {"near_plane_clipping", benchNearPlaneClipping},
+        {"render_modes", benchRenderModes},
+        {"fill_rate", benchFillRate},
+        {"tiled_raster", benchTiledRaster},
+        {"vertex_stage", benchVertexStage},
+        {"camera_motion", benchCameraMotion},
+        {"vertex_cache", benchVertexCache},
+        {"dirty_regions", benchDirtyRegions},
+        {"ascii_display", benchAsciiDisplay},
+        {"ascii_convert", benchAsciiConvert},
+        {"color_display", benchColorDisplay},
+        {"subcell_displays", benchSubCellDisplays},
+        {"display_presenter", benchDisplayPresenter},
+        {"frame_output", benchFrameOutput},
+    };
+
+    std::string filter = argc > 1 ? argv[1] : "";
+    for (auto &benchmark : benchmarks)
+    {
+        if (std::string(benchmark.name).find(filter) == std::string::npos)
+        {
+            continue;
+        }
+        benchmark.run();
+        std::cout << std::endl;
+    }
+
+    return 0;
+}
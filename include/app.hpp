@@ -7,8 +7,11 @@
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <atomic>
 #include <functional>
+#include <memory>
 #include "display.hpp"
+#include "presenter.hpp"
 #include "runtime_input.hpp"
 #include "control.hpp"
 
@@ -31,12 +34,27 @@ public:
     /// @details This is the main function of the application
     void run();
 
-    /// @brief Called when the application is started
-    /// @details This function is called before the main loop
+    /// @brief Asks the application to stop
+    /// @details Safe to call from a signal handler -- run() finishes the frame it is on, stops the display and returns
+    /// @param exitCode The code that the application exits with
     void onExit(int exitCode);
+
+    /// @brief Returns the code that the application exits with
+    int getExitCode() const;
 private:
     std::shared_ptr<InputListener> _inputListener;
-    AsciiDisplay _display;
+    std::shared_ptr<AsciiDisplay> _display;
+    // draws the frames on a thread of its own, so that a slow terminal doesn't hold up rendering -- owns the display
+    // once it is started
+    std::unique_ptr<DisplayPresenter> _presenter;
+    // set by onExit(), possibly from another thread, and read by the main loop
+    std::atomic<bool> _stopping;
+    std::atomic<int> _exitCode;
+    bool _displayStopped; // the display was cleaned up, so it is not cleaned up again
+
+    /// @brief Stops the presenter, which cleans up the display, or cleans up the display if it never started
+    /// @details Only does anything the first time it is called
+    void stopDisplay();
 
     int OUTPUT_HEIGHT;
     int OUTPUT_WIDTH;
@@ -0,0 +1,182 @@
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+// Header file for the per-frame memory arena
+// A linear (bump) allocator that all of the transient, per-frame data of the renderer comes from
+
+// Dependencies
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <type_traits>
+#include <sstream>
+#include <string>
+
+/// @brief A linear allocator whose allocations all live until the next reset
+/// @details Allocating is a pointer bump; nothing is freed individually, the whole arena is rewound by reset()
+/// @details The arena only goes to the heap when it runs out of room -- once it has grown to fit the largest frame,
+/// @details a steady state frame does not allocate at all
+class FrameArena
+{
+public:
+    /// @brief Default alignment of every allocation -- enough for Vec, Matrix and SSE loads
+    static const size_t DEFAULT_ALIGNMENT = 16;
+
+    /// @brief Constructor
+    /// @param initialCapacity The size of the first block, in bytes -- no memory is allocated until it is needed
+    FrameArena(size_t initialCapacity = 64 * 1024) : _blockSize(initialCapacity), _current(0), _offset(0), _bytesUsed(0),
+                                                      _highWaterMark(0), _heapAllocations(0), _heapBytes(0) {}
+
+    FrameArena(const FrameArena &arena) = delete;
+    FrameArena &operator=(const FrameArena &arena) = delete;
+
+    /// @brief Allocates uninitialized, aligned room for the given number of objects
+    /// @details The objects are not constructed; the memory is only valid until the next reset
+    /// @param count The number of objects
+    /// @return A pointer to the first object, or nullptr if count is 0
+    template <typename T>
+    T *allocate(size_t count)
+    {
+        static_assert(std::is_trivially_destructible<T>::value, "FrameArena never runs destructors");
+        size_t alignment = alignof(T) > DEFAULT_ALIGNMENT ? alignof(T) : DEFAULT_ALIGNMENT;
+        return static_cast<T *>(this->allocateBytes(sizeof(T) * count, alignment));
+    }
+
+    /// @brief Allocates uninitialized, aligned bytes
+    /// @param size The number of bytes
+    /// @param alignment The alignment of the allocation, must be a power of two
+    /// @return A pointer to the allocation, or nullptr if size is 0
+    void *allocateBytes(size_t size, size_t alignment = DEFAULT_ALIGNMENT)
+    {
+        if (size == 0)
+        {
+            return nullptr;
+        }
+
+        while (this->_current < this->_blocks.size())
+        {
+            Block &block = this->_blocks[this->_current];
+            uintptr_t base = reinterpret_cast<uintptr_t>(block.data.get());
+            uintptr_t aligned = (base + this->_offset + alignment - 1) & ~(uintptr_t)(alignment - 1);
+            size_t end = (size_t)(aligned - base) + size;
+            if (end <= block.size)
+            {
+                this->_bytesUsed += end - this->_offset;
+                this->_offset = end;
+                return reinterpret_cast<void *>(aligned);
+            }
+
+            // out of room -- move on to the next block
+            this->_current++;
+            this->_offset = 0;
+        }
+
+        // every block is full -- grow geometrically, so that a frame needs few blocks
+        size_t blockSize = this->_blockSize;
+        while (blockSize < size + alignment)
+        {
+            blockSize *= 2;
+        }
+        this->addBlock(blockSize);
+        this->_blockSize = blockSize * 2;
+        return this->allocateBytes(size, alignment);
+    }
+
+    /// @brief Releases every allocation at once
+    /// @details If the last frame did not fit into one block, the blocks are merged into a single one big enough
+    /// @details for the whole frame, so that the following frames are a single contiguous bump
+    void reset()
+    {
+        if (this->_bytesUsed > this->_highWaterMark)
+        {
+            this->_highWaterMark = this->_bytesUsed;
+        }
+
+        if (this->_blocks.size() > 1)
+        {
+            size_t total = 0;
+            for (const Block &block : this->_blocks)
+            {
+                total += block.size;
+            }
+            this->_blocks.clear();
+            this->addBlock(total);
+        }
+
+        this->_current = 0;
+        this->_offset = 0;
+        this->_bytesUsed = 0;
+    }
+
+    /// @brief Returns the number of bytes handed out since the last reset, including alignment padding
+    size_t getBytesUsed() const
+    {
+        return this->_bytesUsed;
+    }
+
+    /// @brief Returns the largest number of bytes that a single frame used
+    size_t getHighWaterMark() const
+    {
+        return this->_bytesUsed > this->_highWaterMark ? this->_bytesUsed : this->_highWaterMark;
+    }
+
+    /// @brief Returns the number of bytes the arena currently owns
+    size_t getCapacity() const
+    {
+        size_t total = 0;
+        for (const Block &block : this->_blocks)
+        {
+            total += block.size;
+        }
+        return total;
+    }
+
+    /// @brief Returns the number of times the arena has gone to the heap, over its whole lifetime
+    size_t getHeapAllocations() const
+    {
+        return this->_heapAllocations;
+    }
+
+    /// @brief Returns the number of bytes the arena has requested from the heap, over its whole lifetime
+    size_t getHeapBytes() const
+    {
+        return this->_heapBytes;
+    }
+
+    std::string toString() const
+    {
+        std::stringstream ss;
+        ss << "FrameArena(used: " << this->getBytesUsed() << ", capacity: " << this->getCapacity()
+           << ", high water mark: " << this->getHighWaterMark() << ", heap allocations: " << this->_heapAllocations << ")";
+        return ss.str();
+    }
+
+private:
+    struct Block
+    {
+        std::unique_ptr<unsigned char[]> data;
+        size_t size;
+    };
+
+    std::vector<Block> _blocks;
+    size_t _blockSize;      // size of the next block to allocate
+    size_t _current;        // index of the block being bumped
+    size_t _offset;         // offset of the bump pointer in the current block
+    size_t _bytesUsed;      // since the last reset
+    size_t _highWaterMark;  // over all finished frames
+    size_t _heapAllocations;
+    size_t _heapBytes;
+
+    void addBlock(size_t size)
+    {
+        Block block;
+        block.data.reset(new unsigned char[size]);
+        block.size = size;
+        this->_blocks.push_back(std::move(block));
+        this->_heapAllocations++;
+        this->_heapBytes += size;
+    }
+};
+
+#endif // __ARENA_H__
@@ -0,0 +1,361 @@
+#ifndef __BOUNDS_H__
+#define __BOUNDS_H__
+
+// Header file for all things related to bounding volumes
+// Axis aligned bounding boxes, bounding spheres, and view frustums
+
+// Dependencies
+#include <string>
+#include <sstream>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include "vec.hpp"
+#include "matrix.hpp"
+
+/// @brief An axis aligned bounding box
+/// @details A box with min > max on any axis is empty -- the default box is empty, and grows as points are added
+struct AABB
+{
+    Vec min;
+    Vec max;
+
+#pragma region Constructors
+    /// @brief Default constructor
+    /// @details Initializes the box to an empty box
+    AABB() : min(Vec(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max())),
+             max(Vec(-std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max())) {}
+
+    /// @brief Constructor
+    /// @details Initializes the box to the given corners
+    AABB(const Vec &min, const Vec &max) : min(Vec(min.x, min.y, min.z)), max(Vec(max.x, max.y, max.z)) {}
+#pragma endregion
+
+#pragma region AABB Methods
+    /// @brief Returns true if the box contains nothing
+    bool isEmpty() const
+    {
+        return this->min.x > this->max.x || this->min.y > this->max.y || this->min.z > this->max.z;
+    }
+
+    /// @brief Grows the box to contain the given point
+    void expand(float x, float y, float z)
+    {
+        this->min.x = std::min(this->min.x, x);
+        this->min.y = std::min(this->min.y, y);
+        this->min.z = std::min(this->min.z, z);
+        this->max.x = std::max(this->max.x, x);
+        this->max.y = std::max(this->max.y, y);
+        this->max.z = std::max(this->max.z, z);
+    }
+
+    /// @brief Grows the box to contain the given point
+    void expand(const Vec &point)
+    {
+        this->expand(point.x, point.y, point.z);
+    }
+
+    /// @brief Grows the box to contain the given box
+    void merge(const AABB &box)
+    {
+        if (box.isEmpty())
+        {
+            return;
+        }
+        this->expand(box.min);
+        this->expand(box.max);
+    }
+
+    /// @brief Returns the center of the box
+    Vec getCenter() const
+    {
+        return Vec((this->min.x + this->max.x) * 0.5f, (this->min.y + this->max.y) * 0.5f, (this->min.z + this->max.z) * 0.5f);
+    }
+
+    /// @brief Returns the half size of the box along each axis
+    Vec getExtents() const
+    {
+        return Vec((this->max.x - this->min.x) * 0.5f, (this->max.y - this->min.y) * 0.5f, (this->max.z - this->min.z) * 0.5f, 0.0f);
+    }
+
+    /// @brief Returns the box that contains this box after it is transformed by the given matrix
+    /// @details Projects the box onto each axis of the matrix (Arvo's method) -- the result is axis aligned again, so it
+    /// @details may be larger than the transformed box itself
+    AABB transform(const Matrix &m) const
+    {
+        if (this->isEmpty())
+        {
+            return AABB();
+        }
+
+        const float lo[3] = {this->min.x, this->min.y, this->min.z};
+        const float hi[3] = {this->max.x, this->max.y, this->max.z};
+        float outMin[3], outMax[3];
+        for (int row = 0; row < 3; row++)
+        {
+            outMin[row] = outMax[row] = m.at(row, 3);
+            for (int col = 0; col < 3; col++)
+            {
+                float a = m.at(row, col) * lo[col];
+                float b = m.at(row, col) * hi[col];
+                outMin[row] += std::min(a, b);
+                outMax[row] += std::max(a, b);
+            }
+        }
+        return AABB(Vec(outMin[0], outMin[1], outMin[2]), Vec(outMax[0], outMax[1], outMax[2]));
+    }
+
+    std::string toString() const
+    {
+        std::stringstream ss;
+        ss << "AABB(" << this->min.toString() << ", " << this->max.toString() << ")";
+        return ss.str();
+    }
+#pragma endregion
+};
+
+/// @brief A bounding sphere
+/// @details A sphere with a negative radius is empty
+struct BoundingSphere
+{
+    Vec center;
+    float radius;
+
+#pragma region Constructors
+    /// @brief Default constructor
+    /// @details Initializes the sphere to an empty sphere
+    BoundingSphere() : center(Vec()), radius(-1.0f) {}
+
+    /// @brief Constructor
+    /// @details Initializes the sphere to the given center and radius
+    BoundingSphere(const Vec &center, float radius) : center(Vec(center.x, center.y, center.z)), radius(radius) {}
+
+    /// @brief Returns the sphere that passes through the corners of the given box
+    static BoundingSphere fromAABB(const AABB &box)
+    {
+        if (box.isEmpty())
+        {
+            return BoundingSphere();
+        }
+        return BoundingSphere(box.getCenter(), box.getExtents().length());
+    }
+#pragma endregion
+
+#pragma region BoundingSphere Methods
+    /// @brief Returns true if the sphere contains nothing
+    bool isEmpty() const
+    {
+        return this->radius < 0.0f;
+    }
+
+    /// @brief Returns the sphere that contains this sphere after it is transformed by the given matrix
+    /// @details The radius is scaled by the largest axis scale of the matrix, so non-uniform scales stay conservative
+    BoundingSphere transform(const Matrix &m) const
+    {
+        if (this->isEmpty())
+        {
+            return BoundingSphere();
+        }
+
+        float maxScaleSquared = 0.0f;
+        for (int col = 0; col < 3; col++)
+        {
+            float x = m.at(0, col), y = m.at(1, col), z = m.at(2, col);
+            maxScaleSquared = std::max(maxScaleSquared, x * x + y * y + z * z);
+        }
+        Vec center = m * Vec(this->center.x, this->center.y, this->center.z, 1.0f);
+        return BoundingSphere(center, this->radius * std::sqrt(maxScaleSquared));
+    }
+
+    std::string toString() const
+    {
+        std::stringstream ss;
+        ss << "BoundingSphere(" << this->center.toString() << ", " << this->radius << ")";
+        return ss.str();
+    }
+#pragma endregion
+};
+
+/// @brief The planes of a frustum, in the order that they are stored
+enum FrustumPlane
+{
+    FRUSTUM_LEFT,
+    FRUSTUM_RIGHT,
+    FRUSTUM_BOTTOM,
+    FRUSTUM_TOP,
+    FRUSTUM_NEAR,
+    FRUSTUM_FAR,
+    FRUSTUM_PLANE_COUNT
+};
+
+/// @brief The result of testing a volume against a frustum
+enum FrustumTest
+{
+    FRUSTUM_OUTSIDE,
+    FRUSTUM_INTERSECTING,
+    FRUSTUM_INSIDE
+};
+
+/// @brief A view frustum, as six planes facing inwards
+/// @details Each plane is stored as (a, b, c, d) with a unit normal -- a point p is inside the plane when
+/// @details a * p.x + b * p.y + c * p.z + d >= 0
+struct Frustum
+{
+    Vec planes[FRUSTUM_PLANE_COUNT];
+
+    /// @brief Default constructor
+    /// @details Initializes the frustum to one that contains everything
+    Frustum()
+    {
+        for (int i = 0; i < FRUSTUM_PLANE_COUNT; i++)
+        {
+            this->planes[i] = Vec(0, 0, 0, 1);
+        }
+    }
+
+    /// @brief Builds the frustum of the given projection matrix
+    /// @details The side planes come from the rows of the projection (w + x >= 0, w - x >= 0, ...), so they match exactly
+    /// @details what the projection maps onto the screen; the near and far planes are given as distances in front of the
+    /// @details camera, which looks down -z
+    /// @param projection The projection matrix, taking view space to clip space
+    /// @param nearPlane The distance to the near plane
+    /// @param farPlane The distance to the far plane
+    static Frustum fromProjection(const Matrix &projection, float nearPlane, float farPlane)
+    {
+        Frustum frustum;
+        Vec rowX(projection.at(0, 0), projection.at(0, 1), projection.at(0, 2), projection.at(0, 3));
+        Vec rowY(projection.at(1, 0), projection.at(1, 1), projection.at(1, 2), projection.at(1, 3));
+        Vec rowW(projection.at(3, 0), projection.at(3, 1), projection.at(3, 2), projection.at(3, 3));
+
+        frustum.planes[FRUSTUM_LEFT] = normalizePlane(rowW + rowX);
+        frustum.planes[FRUSTUM_RIGHT] = normalizePlane(rowW - rowX);
+        frustum.planes[FRUSTUM_BOTTOM] = normalizePlane(rowW + rowY);
+        frustum.planes[FRUSTUM_TOP] = normalizePlane(rowW - rowY);
+        frustum.planes[FRUSTUM_NEAR] = Vec(0, 0, -1, -nearPlane); // -z >= near
+        frustum.planes[FRUSTUM_FAR] = Vec(0, 0, 1, farPlane);     // -z <= far
+        return frustum;
+    }
+
+    /// @brief Returns this frustum, moved into another space
+    /// @details Takes a matrix from the other space into the space of this frustum -- e.g. a frustum built in view space,
+    /// @details and the view matrix, give the frustum in world space
+    /// @param toFrustumSpace The matrix that takes points from the other space into the space of this frustum
+    Frustum transformed(const Matrix &toFrustumSpace) const
+    {
+        // p . (M x) = (M^T p) . x
+        Frustum frustum;
+        for (int i = 0; i < FRUSTUM_PLANE_COUNT; i++)
+        {
+            const Vec &p = this->planes[i];
+            Vec plane;
+            float *out = &plane.x;
+            for (int col = 0; col < 4; col++)
+            {
+                out[col] = p.x * toFrustumSpace.at(0, col) + p.y * toFrustumSpace.at(1, col) +
+                           p.z * toFrustumSpace.at(2, col) + p.w * toFrustumSpace.at(3, col);
+            }
+            frustum.planes[i] = normalizePlane(plane);
+        }
+        return frustum;
+    }
+
+    /// @brief Returns the signed distance of the given point to the given plane -- positive is inside
+    float distance(int plane, float x, float y, float z) const
+    {
+        const Vec &p = this->planes[plane];
+        return p.x * x + p.y * y + p.z * z + p.w;
+    }
+
+    /// @brief Returns false if the sphere is entirely outside of the frustum
+    /// @details Conservative -- a sphere near a corner may pass although it is outside
+    bool intersects(const BoundingSphere &sphere) const
+    {
+        if (sphere.isEmpty())
+        {
+            return false;
+        }
+        for (int i = 0; i < FRUSTUM_PLANE_COUNT; i++)
+        {
+            if (this->distance(i, sphere.center.x, sphere.center.y, sphere.center.z) < -sphere.radius)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// @brief Returns false if the box is entirely outside of the frustum
+    /// @details Tests the corner of the box furthest along each plane's normal -- conservative like the sphere test
+    bool intersects(const AABB &box) const
+    {
+        if (box.isEmpty())
+        {
+            return false;
+        }
+        for (int i = 0; i < FRUSTUM_PLANE_COUNT; i++)
+        {
+            const Vec &p = this->planes[i];
+            float x = p.x >= 0.0f ? box.max.x : box.min.x;
+            float y = p.y >= 0.0f ? box.max.y : box.min.y;
+            float z = p.z >= 0.0f ? box.max.z : box.min.z;
+            if (this->distance(i, x, y, z) < 0.0f)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// @brief Returns whether the box is entirely outside of, entirely inside of, or crossing the frustum
+    /// @details Like intersects(), a box near a corner may be reported as intersecting although it is outside
+    FrustumTest classify(const AABB &box) const
+    {
+        if (box.isEmpty())
+        {
+            return FRUSTUM_OUTSIDE;
+        }
+
+        FrustumTest result = FRUSTUM_INSIDE;
+        for (int i = 0; i < FRUSTUM_PLANE_COUNT; i++)
+        {
+            const Vec &p = this->planes[i];
+            // the corners furthest along and furthest against the plane's normal
+            float farthest = this->distance(i, p.x >= 0.0f ? box.max.x : box.min.x, p.y >= 0.0f ? box.max.y : box.min.y,
+                                            p.z >= 0.0f ? box.max.z : box.min.z);
+            if (farthest < 0.0f)
+            {
+                return FRUSTUM_OUTSIDE;
+            }
+            float nearest = this->distance(i, p.x >= 0.0f ? box.min.x : box.max.x, p.y >= 0.0f ? box.min.y : box.max.y,
+                                           p.z >= 0.0f ? box.min.z : box.max.z);
+            if (nearest < 0.0f)
+            {
+                result = FRUSTUM_INTERSECTING;
+            }
+        }
+        return result;
+    }
+
+    std::string toString() const
+    {
+        std::stringstream ss;
+        ss << "Frustum(" << std::endl;
+        for (int i = 0; i < FRUSTUM_PLANE_COUNT; i++)
+        {
+            ss << "  " << this->planes[i].toString() << std::endl;
+        }
+        ss << ")";
+        return ss.str();
+    }
+
+private:
+    /// @brief Scales the plane so that its normal has unit length, so that distances are in world units
+    static Vec normalizePlane(const Vec &plane)
+    {
+        float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+        return length > 0.0f ? plane / length : plane;
+    }
+};
+
+#endif // __BOUNDS_H__
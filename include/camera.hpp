@@ -0,0 +1,129 @@
+#ifndef __CAMERA_H__
+#define __CAMERA_H__
+
+// Header file for the camera
+// The point of view that the renderer draws the scene graph from
+
+// Dependencies
+#include <cmath>
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+#include "vec.hpp"
+#include "matrix.hpp"
+#include "quaternion.hpp"
+#include "scene_graph.hpp"
+
+/// @brief A camera, placed like any other node of the scene graph
+/// @details The position and orientation come from the transform of the node, and from its parents when it is a child
+/// @details -- the camera looks down its local -z, with +y up; the scale of the node is ignored
+/// @details The projection parameters live alongside, and bump a version of their own when they change, so that a
+/// @details renderer can tell a moving camera (only the view changes) from a zooming one (the projection changes too)
+class Camera : public TransformNode
+{
+public:
+    /// @brief Constructor
+    /// @param fov The vertical field of view, in degrees
+    /// @param nearPlane The distance to the near plane
+    /// @param farPlane The distance to the far plane
+    Camera(float fov = 90.0f, float nearPlane = 0.1f, float farPlane = 100.0f)
+        : TransformNode(), _fov(fov), _nearPlane(nearPlane), _farPlane(farPlane), _projectionVersion(0) {}
+
+    /// @brief Sets the projection parameters of the camera
+    /// @param fov The vertical field of view, in degrees
+    /// @param nearPlane The distance to the near plane
+    /// @param farPlane The distance to the far plane
+    void setProjection(float fov, float nearPlane, float farPlane)
+    {
+        this->_fov = fov;
+        this->_nearPlane = nearPlane;
+        this->_farPlane = farPlane;
+        this->_projectionVersion++;
+    }
+
+    /// @brief Returns the vertical field of view, in degrees
+    float getFov() const
+    {
+        return this->_fov;
+    }
+
+    /// @brief Returns the distance to the near plane
+    float getNearPlane() const
+    {
+        return this->_nearPlane;
+    }
+
+    /// @brief Returns the distance to the far plane
+    float getFarPlane() const
+    {
+        return this->_farPlane;
+    }
+
+    /// @brief Returns a counter that changes whenever the projection parameters change
+    uint64_t getProjectionVersion() const
+    {
+        return this->_projectionVersion;
+    }
+
+    /// @brief Returns the view matrix, taking world space to the space of the camera
+    /// @details The inverse of the world matrix, without its scale -- the axes are normalized, so that the inverse of the
+    /// @details rotation is its transpose
+    Matrix getViewMatrix() const
+    {
+        const Matrix &world = this->getWorldMatrix();
+        Vec position(world.at(0, 3), world.at(1, 3), world.at(2, 3));
+
+        Matrix view;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float x = world.at(0, axis), y = world.at(1, axis), z = world.at(2, axis);
+            float length = std::sqrt(x * x + y * y + z * z);
+            float scale = length > 0.0f ? 1.0f / length : 0.0f;
+            x *= scale;
+            y *= scale;
+            z *= scale;
+            view.set(axis, 0, x);
+            view.set(axis, 1, y);
+            view.set(axis, 2, z);
+            view.set(axis, 3, -(x * position.x + y * position.y + z * position.z));
+        }
+        return view;
+    }
+
+    /// @brief Moves the camera along its own axes -- -z is forward, +x is right, +y is up
+    /// @param offset The distance to move along each axis
+    void moveLocal(const Vec &offset)
+    {
+        Vec direction = Vec(offset.x, offset.y, offset.z, 0.0f);
+        this->transform.move(this->transform.rotation.toRotationMatrix() * direction);
+    }
+
+    /// @brief Turns the camera, like a first person view
+    /// @details Yaw turns around the parent's +y, so that the horizon stays level; pitch turns around the camera's own +x
+    /// @param yaw The angle to turn left by, in radians
+    /// @param pitch The angle to turn up by, in radians
+    void look(float yaw, float pitch)
+    {
+        Quaternion rotation = Quaternion::fromAxisAngle(Vec(0, 1, 0), yaw) * this->transform.rotation *
+                              Quaternion::fromAxisAngle(Vec(1, 0, 0), pitch);
+        this->transform.setRotation(rotation.normalized());
+    }
+
+    /// @brief Returns a string representation of this camera
+    std::string toString() const
+    {
+        std::stringstream ss;
+        ss << "Camera(" << this->transform.toString() << ", fov: " << this->_fov << ", nearPlane: " << this->_nearPlane
+           << ", farPlane: " << this->_farPlane << ")";
+        return ss.str();
+    }
+
+private:
+    float _fov;
+    float _nearPlane;
+    float _farPlane;
+    uint64_t _projectionVersion; // bumped by setProjection()
+};
+
+#endif // __CAMERA_H__
@@ -0,0 +1,247 @@
+#ifndef __CLIP_H__
+#define __CLIP_H__
+
+// Header file for all things related to clipping
+// Outcodes and polygon clipping in homogeneous clip space, before the perspective divide
+
+// Dependencies
+#include <cstdint>
+#include <string>
+#include <sstream>
+#include <utility>
+
+#include "vec.hpp"
+#include "matrix.hpp"
+
+/// @brief The bits of a clip space outcode
+/// @details The side bits say which side of the view a vertex is outside of, and are only used to reject triangles
+/// @details The near, far and guard band bits say that a vertex cannot be divided by w and rasterized as is
+enum ClipBits
+{
+    CLIP_LEFT = 1 << 0,
+    CLIP_RIGHT = 1 << 1,
+    CLIP_BOTTOM = 1 << 2,
+    CLIP_TOP = 1 << 3,
+    CLIP_NEAR = 1 << 4,
+    CLIP_FAR = 1 << 5,
+    CLIP_GUARD_BAND = 1 << 6, // outside of the guard band, on any side
+
+    CLIP_SIDES = CLIP_LEFT | CLIP_RIGHT | CLIP_BOTTOM | CLIP_TOP,
+    CLIP_MUST_CLIP = CLIP_NEAR | CLIP_FAR | CLIP_GUARD_BAND
+};
+
+/// @brief The largest number of vertices a clipped triangle can have -- each of the 6 clip planes can add one
+static const int CLIP_MAX_VERTICES = 9;
+
+/// @brief Clips triangles in homogeneous clip space, against the near and far planes and a guard band
+/// @details Triangles are only clipped against the near and far planes, and against the sides of a guard band that is
+/// @details several times larger than the screen -- anything between the screen and the guard band is left for the
+/// @details rasterizer to skip, which is much cheaper than clipping it
+class Clipper
+{
+public:
+    /// @brief How many times larger than the screen the guard band is, on each axis
+    static constexpr float DEFAULT_GUARD_BAND = 8.0f;
+
+    /// @brief Default constructor
+    /// @details Clips nothing but points behind the camera
+    Clipper() : _wNear(0.0f), _wFar(0.0f), _guardBand(DEFAULT_GUARD_BAND), _hasFar(false) {}
+
+    /// @brief Constructor
+    /// @details The near and far planes are turned into bounds on clip space w, by projecting a point at each distance
+    /// @param projection The projection matrix, taking view space to clip space -- the camera looks down -z
+    /// @param nearPlane The distance to the near plane
+    /// @param farPlane The distance to the far plane
+    /// @param guardBand How many times larger than the screen the guard band is
+    Clipper(const Matrix &projection, float nearPlane, float farPlane, float guardBand = DEFAULT_GUARD_BAND)
+        : _wNear(Clipper::projectW(projection, nearPlane)), _wFar(Clipper::projectW(projection, farPlane)),
+          _guardBand(guardBand), _hasFar(true) {}
+
+    /// @brief Returns the outcode of the given clip space vertex
+    uint8_t outcode(const Vec &v) const
+    {
+        uint8_t code = 0;
+        if (v.x < -v.w)
+        {
+            code |= CLIP_LEFT;
+        }
+        if (v.x > v.w)
+        {
+            code |= CLIP_RIGHT;
+        }
+        if (v.y < -v.w)
+        {
+            code |= CLIP_BOTTOM;
+        }
+        if (v.y > v.w)
+        {
+            code |= CLIP_TOP;
+        }
+        if (!(v.w >= this->_wNear) || v.w <= 0.0f)
+        {
+            code |= CLIP_NEAR;
+        }
+        if (this->_hasFar && v.w > this->_wFar)
+        {
+            code |= CLIP_FAR;
+        }
+
+        float band = this->_guardBand * v.w;
+        if (v.x < -band || v.x > band || v.y < -band || v.y > band)
+        {
+            code |= CLIP_GUARD_BAND;
+        }
+        return code;
+    }
+
+    /// @brief Clips a triangle against every plane that one of its vertices is outside of (Sutherland-Hodgman)
+    /// @details Every output vertex carries an edge flag: true if the edge from it to the next vertex is part of an edge
+    /// @details of the original triangle, false if it runs along a clip plane -- a wireframe only draws flagged edges
+    /// @param triangle The 3 clip space vertices of the triangle
+    /// @param codes The outcodes of the 3 vertices
+    /// @param out Room for CLIP_MAX_VERTICES vertices -- the clipped polygon, in order
+    /// @param edgeFlags Room for CLIP_MAX_VERTICES flags
+    /// @return The number of vertices of the clipped polygon -- 0 if nothing is left
+    int clipTriangle(const Vec *triangle, const uint8_t *codes, Vec *out, bool *edgeFlags) const
+    {
+        Vec bufferA[CLIP_MAX_VERTICES], bufferB[CLIP_MAX_VERTICES];
+        bool flagsA[CLIP_MAX_VERTICES], flagsB[CLIP_MAX_VERTICES];
+        Vec *in = bufferA, *next = bufferB;
+        bool *inFlags = flagsA, *nextFlags = flagsB;
+
+        for (int i = 0; i < 3; i++)
+        {
+            in[i] = triangle[i];
+            inFlags[i] = true;
+        }
+        int count = 3;
+
+        uint8_t any = codes[0] | codes[1] | codes[2];
+        for (int plane = 0; plane < CLIP_PLANE_COUNT && count > 0; plane++)
+        {
+            if ((any & Clipper::planeBit(plane)) == 0)
+            {
+                continue;
+            }
+            count = this->clipAgainstPlane(plane, in, inFlags, count, next, nextFlags);
+            std::swap(in, next);
+            std::swap(inFlags, nextFlags);
+        }
+
+        for (int i = 0; i < count; i++)
+        {
+            out[i] = in[i];
+            edgeFlags[i] = inFlags[i];
+        }
+        return count;
+    }
+
+    /// @brief Returns the clip space w of the near plane
+    float getNearW() const
+    {
+        return this->_wNear;
+    }
+
+    /// @brief Returns the clip space w of the far plane
+    float getFarW() const
+    {
+        return this->_wFar;
+    }
+
+    std::string toString() const
+    {
+        std::stringstream ss;
+        ss << "Clipper(wNear: " << this->_wNear << ", wFar: " << this->_wFar << ", guardBand: " << this->_guardBand << ")";
+        return ss.str();
+    }
+
+private:
+    // the planes that triangles are actually clipped against
+    enum ClipPlane
+    {
+        PLANE_NEAR,
+        PLANE_FAR,
+        PLANE_GUARD_LEFT,
+        PLANE_GUARD_RIGHT,
+        PLANE_GUARD_BOTTOM,
+        PLANE_GUARD_TOP,
+        CLIP_PLANE_COUNT
+    };
+
+    float _wNear;
+    float _wFar;
+    float _guardBand;
+    bool _hasFar;
+
+    /// @brief Returns the clip space w of a point at the given distance in front of the camera
+    static float projectW(const Matrix &projection, float distance)
+    {
+        return (projection * Vec(0.0f, 0.0f, -distance, 1.0f)).w;
+    }
+
+    /// @brief Returns the outcode bit that says a vertex may be outside of the given plane
+    static uint8_t planeBit(int plane)
+    {
+        switch (plane)
+        {
+        case PLANE_NEAR:
+            return CLIP_NEAR;
+        case PLANE_FAR:
+            return CLIP_FAR;
+        default:
+            return CLIP_GUARD_BAND;
+        }
+    }
+
+    /// @brief Returns the signed distance of the vertex to the given plane -- positive is inside
+    float distance(int plane, const Vec &v) const
+    {
+        switch (plane)
+        {
+        case PLANE_NEAR:
+            return v.w - this->_wNear;
+        case PLANE_FAR:
+            return this->_wFar - v.w;
+        case PLANE_GUARD_LEFT:
+            return this->_guardBand * v.w + v.x;
+        case PLANE_GUARD_RIGHT:
+            return this->_guardBand * v.w - v.x;
+        case PLANE_GUARD_BOTTOM:
+            return this->_guardBand * v.w + v.y;
+        default:
+            return this->_guardBand * v.w - v.y;
+        }
+    }
+
+    /// @brief One Sutherland-Hodgman pass, keeping the edge flags
+    int clipAgainstPlane(int plane, const Vec *in, const bool *inFlags, int count, Vec *out, bool *outFlags) const
+    {
+        int outCount = 0;
+        for (int i = 0; i < count; i++)
+        {
+            const Vec &current = in[i];
+            const Vec &following = in[(i + 1) % count];
+            float dCurrent = this->distance(plane, current);
+            float dFollowing = this->distance(plane, following);
+            bool currentInside = dCurrent >= 0.0f;
+            bool followingInside = dFollowing >= 0.0f;
+
+            if (currentInside)
+            {
+                out[outCount] = current;
+                outFlags[outCount++] = inFlags[i];
+            }
+            if (currentInside != followingInside)
+            {
+                // clip space is linear, so every component is interpolated the same way
+                float t = dCurrent / (dCurrent - dFollowing);
+                out[outCount] = current + (following - current) * t;
+                // leaving: the next edge runs along the plane -- entering: it is the rest of the original edge
+                outFlags[outCount++] = currentInside ? false : inFlags[i];
+            }
+        }
+        return outCount;
+    }
+};
+
+#endif // __CLIP_H__
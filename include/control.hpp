@@ -22,6 +22,9 @@ public:
     Controls()
     {
         this->_inputListener = std::make_shared<InputListener>();
+        // the WASD axis is built from key presses, so it has to hook into the input listener
+        this->_axisControls[this->MoveAxis] = std::make_shared<WASDListener>(*this->_inputListener);
+        this->buildControls();
     }
 
     std::shared_ptr<InputListener> getInputListener() const
@@ -62,7 +65,6 @@ private:
     std::map<std::string, std::string> _buttonControls = {
         {this->Jump, "Space"}};
     std::map<std::string, std::shared_ptr<AxisListener>> _axisControls = {
-        {this->MoveAxis, std::make_shared<WASDListener>()},
         {this->LookAxis, std::make_shared<MouseListener>()}};
 
     void buildControls()
@@ -8,8 +8,21 @@
 #include <string>
 #include <algorithm>
 #include <sstream>
+#include <stdio.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include <vector>
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <errno.h>
+#include <poll.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
 #include "tex.hpp"
+#include "simd.hpp"
 
 /// @brief An interface that all Displays must implement
 /// @details A Display is responsible for taking a texture and rendering it into some output
@@ -27,6 +40,25 @@ public:
     /// @param output The output to render to
     virtual void draw(const Texture& tex) = 0;
 
+    /// @brief Renders the parts of the texture that changed since the last draw
+    /// @details Displays that keep the last frame only need to look at the dirty rectangles -- by default, the whole
+    /// @details texture is drawn
+    /// @param tex The texture to render
+    /// @param dirtyRects The parts of the texture that changed, in pixels
+    virtual void draw(const Texture& tex, const std::vector<Rect>& /*dirtyRects*/) {
+        this->draw(tex);
+    }
+
+    /// @brief Returns the number of pixels of the texture that one cell of the output shows, across
+    virtual int getPixelsPerColumn() const {
+        return 1;
+    }
+
+    /// @brief Returns the number of pixels of the texture that one cell of the output shows, down
+    virtual int getPixelsPerRow() const {
+        return 1;
+    }
+
     /// @brief Prepares the Display for rendering
     /// @details This function is called before rendering
     virtual void prepare() = 0;
@@ -36,149 +68,426 @@ public:
     virtual void cleanup() = 0;
 };
 
-/// @brief A Display that renders to the terminal
-/// @details This Display renders the texture to the terminal
-/// @details The terminal must be large enough to fit the texture
-class AsciiDisplay : public IDisplay {
-public:
+/// @brief Statistics about the last frame that a Display drew
+/// @details Reset in prepare(), filled in by draw()
+struct DisplayStats {
+    size_t bytesWritten = 0; // bytes sent to the output, escape sequences included
+    int cellsChanged = 0;    // cells that differ from what the terminal showed
+    int runs = 0;            // runs of cells written after a cursor move -- 0 for a full repaint
+    int colorChanges = 0;    // color sequences written, by the displays that write colors
+    int writeCalls = 0;      // system calls that wrote to the output -- 1 per frame, unless the output is full
+    int writeErrors = 0;     // writes that failed -- the next frame is repainted in full
+    int framesDropped = 0;   // frames given up on part way, because the output stayed full past the write timeout
+    bool fullRepaint = false;
 
-    /// @brief Default constructor
-    /// @details Initializes the Display to the default values
-    AsciiDisplay() : _width(1), _height(1) {
-        // malloc the output buffer
-        int bufferSize = this->getBufferSize();
-        this->_outputBuffer = (char*)malloc(sizeof(char) * bufferSize);
-        this->_outputBuffer[bufferSize - 1] = '\0';
-
-        // create the rewind string -- brings the cursor to the top left
-        sprintf(rewindStr, "\x1b[%dA", _height+1);
-        // create the cleanup string -- clears the terminal
-        sprintf(cleanupStr, "\x1b[%dA\x1b[J", _height+1);
+    std::string toString() const {
+        std::stringstream ss;
+        ss << "DisplayStats(bytesWritten: " << this->bytesWritten << ", cellsChanged: " << this->cellsChanged
+           << ", runs: " << this->runs << ", colorChanges: " << this->colorChanges << ", writeCalls: " << this->writeCalls
+           << ", writeErrors: " << this->writeErrors << ", framesDropped: " << this->framesDropped
+           << ", fullRepaint: " << this->fullRepaint << ")";
+        return ss.str();
     }
+};
+
+/// @brief The colors that the color Displays can write
+enum ColorMode {
+    COLOR_TRUECOLOR, // 24 bit colors, ESC[38;2;r;g;bm
+    COLOR_256        // the 256 color palette, ESC[38;5;nm
+};
+
+/// @brief Quantizes colors for the Displays that write colors, and writes the parameters that select them
+/// @details Colors are quantized to the given number of levels per channel or to the 256 color palette, so that small
+/// @details changes of shading don't make for new sequences -- a quantized color is rgb, or an index of the palette
+struct ColorQuantizer {
+    // a color that was not set -- blank cells, or a terminal that was not given a color yet
+    static constexpr uint32_t noColor = 0xFFFFFFFF;
+
+    ColorMode mode;
+    int levels;
 
     /// @brief Constructor
-    /// @details Initializes the Display to the given values
-    /// @param width The width of the terminal
-    /// @param height The height of the terminal
-    AsciiDisplay(int width, int height) : _width(width), _height(height) {
-        // malloc the output buffer
-        int bufferSize = this->getBufferSize();
-        this->_outputBuffer = (char*)malloc(sizeof(char) * bufferSize);
-        this->_outputBuffer[bufferSize - 1] = '\0';
+    /// @param mode The colors to write
+    /// @param levels The number of levels per channel that truecolor is quantized to (2-256), the palette otherwise
+    ColorQuantizer(ColorMode mode = COLOR_TRUECOLOR, int levels = 32)
+        : mode(mode), levels(std::max(2, std::min(levels, 256))) {}
 
-        // create the rewind string -- brings the cursor to the top left
-        sprintf(rewindStr, "\x1b[%dA", height+1);
-        // create the cleanup string -- clears the terminal
-        sprintf(cleanupStr, "\x1b[%dA\x1b[J", height+1);
+    /// @brief Returns the color that is written for the given pixel
+    uint32_t quantize(const Color& c) const {
+        if (this->mode == COLOR_256) {
+            return (uint32_t)ColorQuantizer::toPalette(c.r, c.g, c.b);
+        }
+        return (this->quantizeChannel(c.r) << 16) | (this->quantizeChannel(c.g) << 8) | this->quantizeChannel(c.b);
     }
 
-    /// @brief Copy constructor
-    /// @details Initializes the Display to the values of the given Display
-    /// @param other The Display to copy
-    AsciiDisplay(const AsciiDisplay& other) : _width(other._width), _height(other._height) {
-        // malloc the output buffer
-        int bufferSize = this->getBufferSize();
-        this->_outputBuffer = (char*)malloc(sizeof(char) * bufferSize);
-        this->_outputBuffer[bufferSize - 1] = '\0';
+    /// @brief Writes the parameters of the sequence that selects the given color, without ESC[ or m
+    /// @param out Where the parameters are written to, 20 bytes at most
+    /// @param color The quantized color
+    /// @param layer 38 for the foreground, 48 for the background
+    /// @return The number of bytes written
+    int writeParameters(char* out, uint32_t color, int layer) const {
+        if (this->mode == COLOR_256) {
+            return snprintf(out, 20, "%d;5;%u", layer, color);
+        }
+        return snprintf(out, 20, "%d;2;%u;%u;%u", layer, color >> 16, (color >> 8) & 0xFF, color & 0xFF);
+    }
 
-        // create the rewind string -- brings the cursor to the top left
-        sprintf(rewindStr, "\x1b[%dA", _height+1);
-        // create the cleanup string -- clears the terminal
-        sprintf(cleanupStr, "\x1b[%dA\x1b[J", _height+1);
+    /// @brief Returns the index of the color of the 256 color palette that is closest to the given one
+    /// @details Only the 6x6x6 cube (16-231) and the grey ramp (232-255) are used -- the first 16 colors are themed by
+    /// @details most terminals
+    static int toPalette(int r, int g, int b) {
+        static const int cubeLevels[6] = {0, 95, 135, 175, 215, 255};
+        int cr = ColorQuantizer::toCubeLevel(r), cg = ColorQuantizer::toCubeLevel(g), cb = ColorQuantizer::toCubeLevel(b);
+        int cube = 16 + 36 * cr + 6 * cg + cb;
+        int cubeError = ColorQuantizer::distance(r, g, b, cubeLevels[cr], cubeLevels[cg], cubeLevels[cb]);
+
+        // the greys are 8, 18, ..., 238
+        int average = (r + g + b) / 3;
+        int grey = average < 8 ? 0 : std::min((average - 3) / 10, 23);
+        int greyValue = 8 + 10 * grey;
+        int greyError = ColorQuantizer::distance(r, g, b, greyValue, greyValue, greyValue);
+        return greyError < cubeError ? 232 + grey : cube;
     }
 
+private:
+    /// @brief Rounds a channel to the closest of the levels, spread evenly over 0-255
+    uint32_t quantizeChannel(int value) const {
+        int steps = this->levels - 1;
+        int level = (value * steps + 127) / 255;
+        return (uint32_t)((level * 255 + steps / 2) / steps);
+    }
+
+    static int toCubeLevel(int value) {
+        return value < 48 ? 0 : value < 115 ? 1 : (value - 35) / 40;
+    }
+
+    static int distance(int r0, int g0, int b0, int r1, int g1, int b1) {
+        return (r0 - r1) * (r0 - r1) + (g0 - g1) * (g0 - g1) + (b0 - b1) * (b0 - b1);
+    }
+};
+
+/// @brief The parts that every Display writing to a terminal shares
+/// @details Keeps the output and the statistics of the frame, and knows the escape sequences that clear the terminal,
+/// @details move the cursor and hide it -- the frame sits at the top left of the terminal
+/// @details The output is a file descriptor -- a terminal, a pipe or a file; the control sequences and the frame are
+/// @details gathered and written with one system call, so the terminal never shows half of a frame that it could have
+/// @details had whole, and partial writes and non-blocking descriptors are carried on until everything is out
+class TerminalDisplay : public IDisplay {
+public:
+    // the file descriptors of the standard outputs
+    static constexpr int STDOUT_FD = 1;
+    static constexpr int STDERR_FD = 2;
+    // how long a write waits for a full output to make room, before the rest of the frame is dropped
+    static constexpr int DEFAULT_WRITE_TIMEOUT_MS = 1000;
+
+    /// @brief Constructor
+    /// @param width The width of the terminal
+    /// @param height The height of the terminal
+    /// @param output The file descriptor that the frames are written to
+    TerminalDisplay(int width, int height, int output) : _width(width), _height(height), _output(output) {}
+
     /// @brief Prepares the Display for rendering
-    /// @details This function is called before rendering
+    /// @details This function is called before rendering -- clearing the terminal and hiding the cursor go out with the
+    /// @details first frame
     void prepare() {
-        if (startedStream)
-        {
-            // move the cursor to the top left
-            fwrite(rewindStr, sizeof(char), sizeof(rewindStr), stderr);
-        }
-        else
+        this->_stats = DisplayStats();
+        if (!startedStream && this->_controlBytes.empty())
         {
             // clear the terminal
-            fwrite(cleanupStr, sizeof(char), sizeof(cleanupStr), stderr);
+            this->stage(cleanupStr);
             // hide the cursor
             this->hideCursor(true);
         }
     }
 
-    /// @brief Renders the given texture to the terminal
-    /// @details This is the main function of the Display
-    /// @param tex The texture to render
-    void draw(const Texture& tex) {
-        // get the width and height of the texture
-        startedStream = true;
-        int texWidth = tex.getWidth();
-        int texHeight = tex.getHeight();
-
-        // calculate the width and height of the render
-        // the minimum of the terminal size and the texture size
-        int renderWidth = std::min(_width, texWidth);
-        int renderHeight = std::min(_height, texHeight);
-
-        // loop through each pixel in the render
-        for (int y = 0; y < renderHeight; y++) {
-            for (int x = 0; x < renderWidth; x++) {
-                float luminance = tex.get(x, y).getLuminance();
-                // std::cout << "luminance: " << luminance << std::endl;
-                char c = this->luminanceToAscii(luminance);
-                int index = y * _width + x + y;
-                this->_outputBuffer[index] = c;
-            }
-            // add a newline
-            this->_outputBuffer[y * _width + y + renderWidth] = '\n';
-        }
-
-        // write the buffer to the output
-        fwrite(this->_outputBuffer, sizeof(char), this->getBufferSize(), stderr);
-    }
-
     /// @brief Cleanup output
     /// @details This function is called after rendering
     void cleanup() {
         // print cleanup string
         if (startedStream)
         {
-            fwrite(cleanupStr, sizeof(char), sizeof(cleanupStr), stderr);
+            this->stage(cleanupStr);
         }
         this->hideCursor(false);
+        this->_frameBytes.clear();
+        this->writeFrame();
+        // the terminal no longer shows the frame
+        startedStream = false;
     }
 
-    inline int getBufferSize() const {
-        return this->_width * this->_height + this->_height + 1;
+    /// @brief Sets how long a write waits for a full output to make room
+    /// @details Past it, the rest of the frame is dropped and the next frame is repainted in full, so that a reader
+    /// @details which stopped reading can't hold up the caller forever
+    /// @param milliseconds The time to wait, or -1 to wait for as long as it takes
+    void setWriteTimeout(int milliseconds) {
+        this->_writeTimeout = milliseconds;
     }
 
-    ~AsciiDisplay() {
-        free((void*)this->_outputBuffer);
+    /// @brief Gets the statistics of the last frame
+    const DisplayStats& getStats() const {
+        return this->_stats;
     }
 
-private:
+    /// @brief Encodes a code point as UTF-8
+    /// @details Only used to build the tables of glyphs -- the Displays copy the bytes out of those
+    /// @param codePoint The code point to encode
+    /// @param out Where the bytes are written to, 4 at most
+    /// @return The number of bytes written
+    static int encodeUtf8(uint32_t codePoint, char* out) {
+        if (codePoint < 0x80) {
+            out[0] = (char)codePoint;
+            return 1;
+        }
+        if (codePoint < 0x800) {
+            out[0] = (char)(0xC0 | (codePoint >> 6));
+            out[1] = (char)(0x80 | (codePoint & 0x3F));
+            return 2;
+        }
+        if (codePoint < 0x10000) {
+            out[0] = (char)(0xE0 | (codePoint >> 12));
+            out[1] = (char)(0x80 | ((codePoint >> 6) & 0x3F));
+            out[2] = (char)(0x80 | (codePoint & 0x3F));
+            return 3;
+        }
+        out[0] = (char)(0xF0 | (codePoint >> 18));
+        out[1] = (char)(0x80 | ((codePoint >> 12) & 0x3F));
+        out[2] = (char)(0x80 | ((codePoint >> 6) & 0x3F));
+        out[3] = (char)(0x80 | (codePoint & 0x3F));
+        return 4;
+    }
+
+protected:
     // the width and height of the terminal
     int _width;
     int _height;
+    int _output;
+    int _writeTimeout = DEFAULT_WRITE_TIMEOUT_MS;
 
-    char* _outputBuffer;
-    char rewindStr[20];
-    char cleanupStr[20];
+    std::vector<char> _controlBytes; // the control sequences that go out ahead of the frame
+    std::vector<char> _frameBytes;   // what is written for the frame -- reused between frames
+    // brings the cursor to the top left
+    static constexpr const char* rewindStr = "\x1b[H";
+    // clears the terminal
+    static constexpr const char* cleanupStr = "\x1b[H\x1b[J";
+    DisplayStats _stats;
 
     bool startedStream = false;
+    // the size of the texture that was last drawn
+    int _drawnWidth = 0;
+    int _drawnHeight = 0;
 
-    // used to convert luminance to ascii characters
-    const char* _luminanceTable = " .:-=+*#%@";
-    int _luminanceTableSize = 10;
+    /// @brief Returns the number of bytes of the sequence that moves the cursor to the given cell
+    static int cursorMoveCost(int y, int x) {
+        return 4 + TerminalDisplay::digits(y + 1) + TerminalDisplay::digits(x + 1);
+    }
 
-    /// @brief Converts the given luminance to an ascii character
-    /// @details This function converts the given luminance to an ascii character
-    /// @param luminance The luminance to convert
-    /// @return The ascii character
-    char luminanceToAscii(float luminance) const {
-        // convert luminance to index
-        int index = (int)(luminance * (_luminanceTableSize - 1));
+    /// @brief Returns the number of decimal digits of a positive number
+    static int digits(int value) {
+        int count = 1;
+        while (value >= 10) {
+            value /= 10;
+            count++;
+        }
+        return count;
+    }
 
-        // return the character at the index
-        return _luminanceTable[index];
+    /// @brief Appends the sequence that moves the cursor to the given cell -- rows and columns count from 1
+    void appendCursorMove(int y, int x) {
+        char sequence[32];
+        int length = snprintf(sequence, sizeof(sequence), "\x1b[%d;%dH", y + 1, x + 1);
+        this->_frameBytes.insert(this->_frameBytes.end(), sequence, sequence + length);
+    }
+
+    /// @brief Returns the cells that show the pixels inside of the given rectangles
+    /// @param rects The rectangles, in pixels
+    /// @param pixelsPerColumn The number of pixels that one cell shows, across
+    /// @param pixelsPerRow The number of pixels that one cell shows, down
+    /// @param cellRects Where the cells are written to, one rectangle for each of the given ones
+    static void toCellRects(const std::vector<Rect>& rects, int pixelsPerColumn, int pixelsPerRow,
+                            std::vector<Rect>& cellRects) {
+        cellRects.clear();
+        for (const Rect& rect : rects) {
+            cellRects.push_back(Rect(rect.minX / pixelsPerColumn, rect.minY / pixelsPerRow,
+                                     (rect.maxX + pixelsPerColumn - 1) / pixelsPerColumn,
+                                     (rect.maxY + pixelsPerRow - 1) / pixelsPerRow));
+        }
+    }
+
+    /// @brief Appends the runs of the cells inside of the given rectangles that changed, each behind a cursor move
+    /// @details Cells are indexed y * width + x; a gap of unchanged cells is written over when that takes no more bytes
+    /// @details than moving the cursor past it -- gives up once the frame takes more than the given number of bytes
+    /// @param rects The rectangles, in cells
+    /// @param limit The number of bytes past which a full repaint is cheaper
+    /// @param isShown Whether the cell at an index looks the same as what the terminal shows
+    /// @param gapBytes The bytes that writing an unchanged cell over takes, -1 if it takes a sequence
+    /// @param appendCell Appends the cell at an index
+    /// @return Whether every run fit in the limit
+    template <typename IsShown, typename GapBytes, typename AppendCell>
+    bool appendRuns(const std::vector<Rect>& rects, size_t limit, IsShown isShown, GapBytes gapBytes,
+                    AppendCell appendCell) {
+        Rect screen(0, 0, _width, _height);
+        for (const Rect& dirtyRect : rects) {
+            Rect rect = dirtyRect.intersect(screen);
+            for (int y = rect.minY; y < rect.maxY; y++) {
+                const int row = y * _width;
+                int x = rect.minX;
+                while (x < rect.maxX) {
+                    if (isShown(row + x)) {
+                        x++;
+                        continue;
+                    }
+
+                    this->appendCursorMove(y, x);
+                    this->_stats.runs++;
+                    while (x < rect.maxX) {
+                        this->_stats.cellsChanged += isShown(row + x) ? 0 : 1;
+                        appendCell(row + x);
+                        x++;
+                        if (x == rect.maxX || !isShown(row + x)) {
+                            continue;
+                        }
+                        int gapEnd = x, bytes = 0;
+                        while (gapEnd < rect.maxX && isShown(row + gapEnd)) {
+                            int cellBytes = bytes < 0 ? -1 : gapBytes(row + gapEnd);
+                            bytes = cellBytes < 0 ? -1 : bytes + cellBytes;
+                            gapEnd++;
+                        }
+                        if (gapEnd == rect.maxX || bytes < 0 || bytes > TerminalDisplay::cursorMoveCost(y, gapEnd)) {
+                            x = gapEnd;
+                            break;
+                        }
+                    }
+                }
+                if (this->_frameBytes.size() > limit) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    /// @brief Replaces the frame with a full repaint -- every cell, row after row, each row ending in a newline
+    /// @param isShown Whether the cell at an index looks the same as what the terminal shows
+    /// @param appendCell Appends the cell at an index
+    template <typename IsShown, typename AppendCell>
+    void appendRepaint(IsShown isShown, AppendCell appendCell) {
+        // the runs were given up on part way, so the changes are counted again over the whole frame
+        this->_stats.cellsChanged = 0;
+        this->_stats.colorChanges = 0;
+        this->_stats.runs = 0;
+        this->_stats.fullRepaint = true;
+        this->_frameBytes.assign(rewindStr, rewindStr + strlen(rewindStr));
+        for (int y = 0; y < _height; y++) {
+            for (int x = 0; x < _width; x++) {
+                this->_stats.cellsChanged += isShown(y * _width + x) ? 0 : 1;
+                appendCell(y * _width + x);
+            }
+            this->_frameBytes.push_back('\n');
+        }
+    }
+
+    /// @brief Appends the sequence that selects the given colors -- one sequence for both layers
+    /// @param quantizer The quantizer that the colors come from
+    /// @param foreground The foreground color, ColorQuantizer::noColor to leave it
+    /// @param background The background color, ColorQuantizer::noColor to leave it
+    void appendColors(const ColorQuantizer& quantizer, uint32_t foreground, uint32_t background) {
+        char sequence[48] = "\x1b[";
+        int length = 2;
+        if (foreground != ColorQuantizer::noColor) {
+            length += quantizer.writeParameters(sequence + length, foreground, 38);
+        }
+        if (background != ColorQuantizer::noColor) {
+            if (foreground != ColorQuantizer::noColor) {
+                sequence[length++] = ';';
+            }
+            length += quantizer.writeParameters(sequence + length, background, 48);
+        }
+        sequence[length++] = 'm';
+        this->_frameBytes.insert(this->_frameBytes.end(), sequence, sequence + length);
+        this->_stats.colorChanges++;
+    }
+
+    /// @brief Adds a control sequence to go out ahead of the next frame
+    void stage(const char* sequence) {
+        this->_controlBytes.insert(this->_controlBytes.end(), sequence, sequence + strlen(sequence));
+    }
+
+    /// @brief Writes the staged control sequences and the frame to the output, and counts the bytes
+    /// @details Both go out in one call to writev -- a partial write carries on from where it stopped, and a descriptor
+    /// @details that would block is waited on, up to the write timeout; when the output fails or the frame is dropped,
+    /// @details the terminal shows who knows what, so the next frame is a full repaint
+    void writeFrame() {
+#if defined(_WIN32)
+        // no writev -- the control sequences are short, so they go in front of the frame
+        this->_controlBytes.insert(this->_controlBytes.end(), this->_frameBytes.begin(), this->_frameBytes.end());
+        const char* bytes = this->_controlBytes.data();
+        size_t remaining = this->_controlBytes.size();
+        while (remaining > 0) {
+            int written = _write(this->_output, bytes, (unsigned int)std::min(remaining, (size_t)1 << 30));
+            this->_stats.writeCalls++;
+            if (written < 0) {
+                this->_stats.writeErrors++;
+                startedStream = false;
+                break;
+            }
+            this->_stats.bytesWritten += written;
+            bytes += written;
+            remaining -= written;
+        }
+#else
+        struct iovec parts[2];
+        int count = 0;
+        if (!this->_controlBytes.empty()) {
+            parts[count].iov_base = this->_controlBytes.data();
+            parts[count++].iov_len = this->_controlBytes.size();
+        }
+        if (!this->_frameBytes.empty()) {
+            parts[count].iov_base = this->_frameBytes.data();
+            parts[count++].iov_len = this->_frameBytes.size();
+        }
+        struct iovec* part = parts;
+        while (count > 0) {
+            ssize_t written = ::writev(this->_output, part, count);
+            this->_stats.writeCalls++;
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    // a non-blocking descriptor that is full -- wait until the reader makes room
+                    struct pollfd writable = {this->_output, POLLOUT, 0};
+                    int ready = ::poll(&writable, 1, this->_writeTimeout);
+                    if (ready < 0 && errno == EINTR) {
+                        continue;
+                    }
+                    if (ready == 0) {
+                        this->_stats.framesDropped++;
+                        startedStream = false;
+                        break;
+                    }
+                    if (ready > 0 && (writable.revents & (POLLERR | POLLHUP | POLLNVAL)) == 0) {
+                        continue;
+                    }
+                    // poll failed, or the reader is gone (POLLERR, POLLHUP, POLLNVAL)
+                }
+                this->_stats.writeErrors++;
+                startedStream = false;
+                break;
+            }
+            this->_stats.bytesWritten += (size_t)written;
+            // skip what went out -- a partial write can stop in the middle of a part
+            while (count > 0 && (size_t)written >= part->iov_len) {
+                written -= (ssize_t)part->iov_len;
+                part++;
+                count--;
+            }
+            if (count > 0) {
+                part->iov_base = (char*)part->iov_base + written;
+                part->iov_len -= (size_t)written;
+            }
+        }
+#endif
+        this->_controlBytes.clear();
     }
 
     /// @brief Hides/Shows the cursor
@@ -187,13 +496,614 @@ private:
     void hideCursor(bool hide) {
         if (hide) {
             // hide the cursor
-            fwrite("\x1b[?25l", sizeof(char), 6, stderr);
+            this->stage("\x1b[?25l");
         }
         else {
             // show the cursor
-            fwrite("\x1b[?25h", sizeof(char), 6, stderr);
+            this->stage("\x1b[?25h");
         }
     }
 };
 
+/// @brief A Display that renders to the terminal
+/// @details This Display renders the texture to the terminal
+/// @details The terminal must be large enough to fit the texture
+/// @details The frame sits at the top left of the terminal -- the characters that the terminal shows are kept, and each
+/// @details frame only sends the runs of cells that changed, each behind a cursor position sequence, unless repainting
+/// @details everything costs fewer bytes
+class AsciiDisplay : public TerminalDisplay {
+public:
+
+    /// @brief Default constructor
+    /// @details Initializes the Display to the default values
+    AsciiDisplay() : AsciiDisplay(1, 1) {}
+
+    /// @brief Constructor
+    /// @details Initializes the Display to the given values
+    /// @param width The width of the terminal
+    /// @param height The height of the terminal
+    /// @param output The file descriptor that the frames are written to
+    AsciiDisplay(int width, int height, int output = TerminalDisplay::STDERR_FD) : TerminalDisplay(width, height, output) {
+        this->_outputBuffer.assign(width * height, ' ');
+        this->_shownBuffer = this->_outputBuffer;
+    }
+
+    /// @brief Copy constructor
+    /// @details Initializes the Display to the values of the given Display
+    /// @param other The Display to copy
+    AsciiDisplay(const AsciiDisplay& other) = default;
+
+    AsciiDisplay& operator=(const AsciiDisplay& other) = default;
+
+    /// @brief Renders the given texture to the terminal
+    /// @details This is the main function of the Display
+    /// @param tex The texture to render
+    void draw(const Texture& tex) {
+        // calculate the width and height of the render
+        // the minimum of the terminal size and the texture size
+        int renderWidth = std::min(_width, tex.getWidth());
+        int renderHeight = std::min(_height, tex.getHeight());
+        this->_screenRects.assign(1, Rect(0, 0, renderWidth, renderHeight));
+        this->convert(tex, this->_screenRects);
+        this->present(this->_screenRects);
+    }
+
+    /// @brief Renders the parts of the texture that changed since the last draw to the terminal
+    /// @details Only the pixels inside of the dirty rectangles are converted and compared against what the terminal
+    /// @details shows -- the first draw, and any draw of a texture of another size, looks at everything
+    /// @param tex The texture to render
+    /// @param dirtyRects The parts of the texture that changed, in pixels
+    void draw(const Texture& tex, const std::vector<Rect>& dirtyRects) {
+        if (!startedStream || tex.getWidth() != this->_drawnWidth || tex.getHeight() != this->_drawnHeight) {
+            this->draw(tex);
+            return;
+        }
+        this->convert(tex, dirtyRects);
+        this->present(dirtyRects);
+    }
+
+    inline int getBufferSize() const {
+        return this->_width * this->_height + this->_height;
+    }
+
+    /// @brief Converts a row of pixels into characters
+    /// @details The luma of the pixels is computed by the pixel kernels, straight into the output, and then looked up in
+    /// @details a table of the 256 lumas -- the same characters as luminanceToAscii(), up to the rounding of the luma
+    /// @param pixels The pixels to convert
+    /// @param count The number of pixels
+    /// @param out Where the characters are written to, count of them
+    static void convertRow(const Color* pixels, int count, char* out) {
+        static_assert(sizeof(Color) == 4, "the pixel kernels read colors as 4 bytes");
+        const char* lut = AsciiDisplay::luminanceLut();
+        VecKernels::lumaRow(reinterpret_cast<const unsigned char*>(pixels), reinterpret_cast<unsigned char*>(out), count);
+        for (int i = 0; i < count; i++) {
+            out[i] = lut[(unsigned char)out[i]];
+        }
+    }
+
+    /// @brief Converts the given luminance to an ascii character
+    /// @details This function converts the given luminance to an ascii character
+    /// @param luminance The luminance to convert
+    /// @return The ascii character
+    static char luminanceToAscii(float luminance) {
+        // convert luminance to index
+        int index = (int)(luminance * (luminanceTableSize - 1));
+
+        // return the character at the index
+        return luminanceTable[index];
+    }
+
+private:
+    std::vector<char> _outputBuffer; // the characters of the current frame, row after row
+    std::vector<char> _shownBuffer;  // the characters that the terminal shows
+    std::vector<Rect> _screenRects;  // the whole render, for draws without dirty rectangles
+
+    // used to convert luminance to ascii characters
+    static constexpr const char* luminanceTable = " .:-=+*#%@";
+    static constexpr int luminanceTableSize = 10;
+
+    /// @brief Returns the characters of the 256 lumas that the pixel kernels produce -- built on first use
+    static const char* luminanceLut() {
+        struct Lut {
+            char chars[256];
+            Lut() {
+                for (int luma = 0; luma < 256; luma++) {
+                    this->chars[luma] = AsciiDisplay::luminanceToAscii(luma / 255.0f);
+                }
+            }
+        };
+        static const Lut lut;
+        return lut.chars;
+    }
+
+    /// @brief Converts the pixels inside of the given rectangles into the characters of the output buffer
+    void convert(const Texture& tex, const std::vector<Rect>& rects) {
+        Rect screen(0, 0, std::min(_width, tex.getWidth()), std::min(_height, tex.getHeight()));
+        for (const Rect& dirtyRect : rects) {
+            Rect rect = dirtyRect.intersect(screen);
+            for (int y = rect.minY; y < rect.maxY && rect.minX < rect.maxX; y++) {
+                AsciiDisplay::convertRow(tex.getPixels() + y * tex.getWidth() + rect.minX, rect.getWidth(),
+                                         this->_outputBuffer.data() + y * _width + rect.minX);
+            }
+        }
+        this->_drawnWidth = tex.getWidth();
+        this->_drawnHeight = tex.getHeight();
+    }
+
+    /// @brief Brings the terminal up to date with the output buffer, looking for changes inside of the given rectangles
+    /// @details The frame is repainted in full instead when the runs would take more bytes
+    void present(const std::vector<Rect>& rects) {
+        auto isShown = [this](int index) {
+            return this->_outputBuffer[index] == this->_shownBuffer[index];
+        };
+        auto gapBytes = [](int) {
+            return 1;
+        };
+        auto appendCell = [this](int index) {
+            this->_frameBytes.push_back(this->_outputBuffer[index]);
+        };
+
+        this->_frameBytes.clear();
+        const size_t fullCost = strlen(rewindStr) + this->getBufferSize();
+        if (!startedStream || !this->appendRuns(rects, fullCost, isShown, gapBytes, appendCell)) {
+            this->appendRepaint(isShown, appendCell);
+        }
+        startedStream = true;
+
+        // everything that was written is what the terminal shows now
+        this->_shownBuffer = this->_outputBuffer;
+        this->writeFrame();
+    }
+};
+
+/// @brief A Display that renders to the terminal in color
+/// @details Every cell is the character of AsciiDisplay, written in the quantized color of its pixel
+/// @details Like AsciiDisplay, each frame only sends the runs of cells that changed, unless repainting costs fewer
+/// @details bytes -- a color sequence is only written when the color differs from the last one that was written, which
+/// @details the terminal keeps across cursor moves and frames; blank cells show no color, so they never need one
+class ColorDisplay : public TerminalDisplay {
+public:
+    /// @brief Constructor
+    /// @param width The width of the terminal
+    /// @param height The height of the terminal
+    /// @param mode The colors to write
+    /// @param levels The number of levels per channel that truecolor is quantized to (2-256), the palette otherwise
+    /// @param output The file descriptor that the frames are written to
+    ColorDisplay(int width, int height, ColorMode mode = COLOR_TRUECOLOR, int levels = 32, int output = TerminalDisplay::STDERR_FD)
+        : TerminalDisplay(width, height, output), _quantizer(mode, levels) {
+        this->_chars.assign(width * height, ' ');
+        this->_colors.assign(width * height, ColorQuantizer::noColor);
+        this->_shownChars = this->_chars;
+        this->_shownColors = this->_colors;
+    }
+
+    /// @brief Renders the given texture to the terminal
+    /// @param tex The texture to render
+    void draw(const Texture& tex) {
+        int renderWidth = std::min(_width, tex.getWidth());
+        int renderHeight = std::min(_height, tex.getHeight());
+        this->_screenRects.assign(1, Rect(0, 0, renderWidth, renderHeight));
+        this->convert(tex, this->_screenRects);
+        this->present(this->_screenRects);
+    }
+
+    /// @brief Renders the parts of the texture that changed since the last draw to the terminal
+    /// @details The first draw, and any draw of a texture of another size, looks at everything
+    /// @param tex The texture to render
+    /// @param dirtyRects The parts of the texture that changed, in pixels
+    void draw(const Texture& tex, const std::vector<Rect>& dirtyRects) {
+        if (!startedStream || tex.getWidth() != this->_drawnWidth || tex.getHeight() != this->_drawnHeight) {
+            this->draw(tex);
+            return;
+        }
+        this->convert(tex, dirtyRects);
+        this->present(dirtyRects);
+    }
+
+    /// @brief Cleanup output
+    /// @details Resets the color of the terminal, then clears it
+    void cleanup() {
+        if (startedStream) {
+            this->stage("\x1b[0m");
+        }
+        this->_pen = ColorQuantizer::noColor;
+        TerminalDisplay::cleanup();
+    }
+
+private:
+    ColorQuantizer _quantizer;
+
+    std::vector<char> _chars;         // the characters of the current frame, row after row
+    std::vector<uint32_t> _colors;    // the quantized colors of the current frame
+    std::vector<char> _shownChars;    // the characters that the terminal shows
+    std::vector<uint32_t> _shownColors;
+    std::vector<Rect> _screenRects;   // the whole render, for draws without dirty rectangles
+    uint32_t _pen = ColorQuantizer::noColor; // the color that the terminal writes with
+    size_t _repaintBytes = 0;         // the size of the last full repaint
+
+    /// @brief Converts the pixels inside of the given rectangles into characters and quantized colors
+    void convert(const Texture& tex, const std::vector<Rect>& rects) {
+        Rect screen(0, 0, std::min(_width, tex.getWidth()), std::min(_height, tex.getHeight()));
+        for (const Rect& dirtyRect : rects) {
+            Rect rect = dirtyRect.intersect(screen);
+            for (int y = rect.minY; y < rect.maxY && rect.minX < rect.maxX; y++) {
+                const Color* pixels = tex.getPixels() + y * tex.getWidth() + rect.minX;
+                char* chars = this->_chars.data() + y * _width + rect.minX;
+                uint32_t* colors = this->_colors.data() + y * _width + rect.minX;
+                AsciiDisplay::convertRow(pixels, rect.getWidth(), chars);
+                for (int i = 0; i < rect.getWidth(); i++) {
+                    colors[i] = chars[i] == ' ' ? ColorQuantizer::noColor : this->_quantizer.quantize(pixels[i]);
+                }
+            }
+        }
+        this->_drawnWidth = tex.getWidth();
+        this->_drawnHeight = tex.getHeight();
+    }
+
+    /// @brief Brings the terminal up to date, looking for changes inside of the given rectangles
+    /// @details A gap of unchanged cells is only written over when it takes no color sequence; the frame is repainted in
+    /// @details full instead when the runs take more bytes than the last repaint did
+    void present(const std::vector<Rect>& rects) {
+        if (!startedStream) {
+            // the stream was cut off part way, so the terminal may write with any color
+            this->_pen = ColorQuantizer::noColor;
+        }
+        const uint32_t framePen = this->_pen;
+        auto isShown = [this](int index) {
+            return this->_chars[index] == this->_shownChars[index] && this->_colors[index] == this->_shownColors[index];
+        };
+        auto gapBytes = [this](int index) {
+            uint32_t color = this->_colors[index];
+            return color == ColorQuantizer::noColor || color == this->_pen ? 1 : -1;
+        };
+        auto appendCell = [this](int index) {
+            uint32_t color = this->_colors[index];
+            if (color != ColorQuantizer::noColor && color != this->_pen) {
+                this->appendColors(this->_quantizer, color, ColorQuantizer::noColor);
+                this->_pen = color;
+            }
+            this->_frameBytes.push_back(this->_chars[index]);
+        };
+
+        this->_frameBytes.clear();
+        if (!startedStream || !this->appendRuns(rects, this->_repaintBytes, isShown, gapBytes, appendCell)) {
+            this->_pen = framePen;
+            this->appendRepaint(isShown, appendCell);
+            this->_repaintBytes = this->_frameBytes.size();
+        }
+        startedStream = true;
+
+        // everything that was written is what the terminal shows now
+        this->_shownChars = this->_chars;
+        this->_shownColors = this->_colors;
+        this->writeFrame();
+    }
+};
+
+/// @brief A Display that renders two pixels per cell, with half block characters in color
+/// @details The upper pixel of a cell is one of the colors of a half block, the lower pixel the other -- cells are about
+/// @details twice as tall as they are wide, so the pixels come out square
+/// @details Each cell is written with whichever of the upper half block, the lower half block, a full block or a space
+/// @details needs the fewest colors changed, since the terminal keeps its foreground and background colors; otherwise
+/// @details the frames are sent like in ColorDisplay
+class HalfBlockDisplay : public TerminalDisplay {
+public:
+    /// @brief Constructor
+    /// @param width The width of the terminal, in cells -- the texture is as wide
+    /// @param height The height of the terminal, in cells -- the texture is twice as tall
+    /// @param mode The colors to write
+    /// @param levels The number of levels per channel that truecolor is quantized to (2-256), the palette otherwise
+    /// @param output The file descriptor that the frames are written to
+    HalfBlockDisplay(int width, int height, ColorMode mode = COLOR_TRUECOLOR, int levels = 32, int output = TerminalDisplay::STDERR_FD)
+        : TerminalDisplay(width, height, output), _quantizer(mode, levels) {
+        uint32_t black = this->_quantizer.quantize(Color(0, 0, 0));
+        this->_upper.assign(width * height, black);
+        this->_lower.assign(width * height, black);
+        this->_shownUpper = this->_upper;
+        this->_shownLower = this->_lower;
+    }
+
+    /// @brief Renders the given texture to the terminal
+    /// @param tex The texture to render
+    void draw(const Texture& tex) {
+        this->_cellRects.assign(1, Rect(0, 0, tex.getWidth(), (tex.getHeight() + 1) / 2));
+        this->convert(tex, this->_cellRects);
+        this->present(this->_cellRects);
+    }
+
+    /// @brief Renders the parts of the texture that changed since the last draw to the terminal
+    /// @details The first draw, and any draw of a texture of another size, looks at everything
+    /// @param tex The texture to render
+    /// @param dirtyRects The parts of the texture that changed, in pixels
+    void draw(const Texture& tex, const std::vector<Rect>& dirtyRects) {
+        if (!startedStream || tex.getWidth() != this->_drawnWidth || tex.getHeight() != this->_drawnHeight) {
+            this->draw(tex);
+            return;
+        }
+        TerminalDisplay::toCellRects(dirtyRects, 1, 2, this->_cellRects);
+        this->convert(tex, this->_cellRects);
+        this->present(this->_cellRects);
+    }
+
+    int getPixelsPerRow() const {
+        return 2;
+    }
+
+    /// @brief Cleanup output
+    /// @details Resets the colors of the terminal, then clears it
+    void cleanup() {
+        if (startedStream) {
+            this->stage("\x1b[0m");
+        }
+        this->_foreground = ColorQuantizer::noColor;
+        this->_background = ColorQuantizer::noColor;
+        TerminalDisplay::cleanup();
+    }
+
+private:
+    enum Glyph {
+        GLYPH_SPACE,
+        GLYPH_UPPER, // U+2580, the upper half is the foreground
+        GLYPH_LOWER, // U+2584, the lower half is the foreground
+        GLYPH_FULL   // U+2588
+    };
+
+    ColorQuantizer _quantizer;
+
+    std::vector<uint32_t> _upper;      // the quantized colors of the upper pixels of the current frame, row after row
+    std::vector<uint32_t> _lower;      // the quantized colors of the lower pixels
+    std::vector<uint32_t> _shownUpper; // the colors that the terminal shows
+    std::vector<uint32_t> _shownLower;
+    std::vector<Rect> _cellRects;      // the cells to look at, for the frame
+    uint32_t _foreground = ColorQuantizer::noColor; // the colors that the terminal writes with
+    uint32_t _background = ColorQuantizer::noColor;
+    size_t _repaintBytes = 0;          // the size of the last full repaint
+
+    /// @brief Returns the UTF-8 of the glyphs, 3 bytes each, indexed by Glyph -- built on first use
+    static const char* glyphs() {
+        struct Glyphs {
+            char bytes[4][3] = {};
+            Glyphs() {
+                // spaces are written as they are, in 1 byte
+                const uint32_t codePoints[4] = {0x20, 0x2580, 0x2584, 0x2588};
+                for (int glyph = 0; glyph < 4; glyph++) {
+                    TerminalDisplay::encodeUtf8(codePoints[glyph], this->bytes[glyph]);
+                }
+            }
+        };
+        static const Glyphs table;
+        return table.bytes[0];
+    }
+
+    /// @brief Converts the pixels of the given cells into quantized colors -- a missing lower row is black
+    void convert(const Texture& tex, const std::vector<Rect>& cellRects) {
+        Rect screen(0, 0, _width, _height);
+        const uint32_t black = this->_quantizer.quantize(Color(0, 0, 0));
+        for (const Rect& cellRect : cellRects) {
+            Rect rect = cellRect.intersect(screen).intersect(Rect(0, 0, tex.getWidth(), (tex.getHeight() + 1) / 2));
+            for (int y = rect.minY; y < rect.maxY; y++) {
+                const Color* upper = tex.getPixels() + (2 * y) * tex.getWidth();
+                const Color* lower = 2 * y + 1 < tex.getHeight() ? upper + tex.getWidth() : nullptr;
+                for (int x = rect.minX; x < rect.maxX; x++) {
+                    this->_upper[y * _width + x] = this->_quantizer.quantize(upper[x]);
+                    this->_lower[y * _width + x] = lower != nullptr ? this->_quantizer.quantize(lower[x]) : black;
+                }
+            }
+        }
+        this->_drawnWidth = tex.getWidth();
+        this->_drawnHeight = tex.getHeight();
+    }
+
+    /// @brief Chooses the glyph of a cell, and the colors that it needs the terminal to have
+    /// @details Picks the glyph that changes the fewest of the colors that the terminal has -- the upper half block on a
+    /// @details tie, and a space for a cell of one color unless the foreground is that color already
+    Glyph chooseGlyph(uint32_t upper, uint32_t lower, uint32_t& foreground, uint32_t& background) const {
+        foreground = this->_foreground;
+        background = this->_background;
+        if (upper == lower) {
+            if (upper == this->_foreground && upper != this->_background) {
+                return GLYPH_FULL;
+            }
+            background = upper;
+            return GLYPH_SPACE;
+        }
+        int upperChanges = (upper != this->_foreground ? 1 : 0) + (lower != this->_background ? 1 : 0);
+        int lowerChanges = (lower != this->_foreground ? 1 : 0) + (upper != this->_background ? 1 : 0);
+        if (lowerChanges < upperChanges) {
+            foreground = lower;
+            background = upper;
+            return GLYPH_LOWER;
+        }
+        foreground = upper;
+        background = lower;
+        return GLYPH_UPPER;
+    }
+
+    /// @brief Brings the terminal up to date, looking for changes inside of the given cells
+    void present(const std::vector<Rect>& cellRects) {
+        if (!startedStream) {
+            // the stream was cut off part way, so the terminal may write with any colors
+            this->_foreground = ColorQuantizer::noColor;
+            this->_background = ColorQuantizer::noColor;
+        }
+        const uint32_t frameForeground = this->_foreground, frameBackground = this->_background;
+        auto isShown = [this](int index) {
+            return this->_upper[index] == this->_shownUpper[index] && this->_lower[index] == this->_shownLower[index];
+        };
+        auto gapBytes = [this](int index) {
+            uint32_t foreground, background;
+            Glyph glyph = this->chooseGlyph(this->_upper[index], this->_lower[index], foreground, background);
+            if (foreground != this->_foreground || background != this->_background) {
+                return -1;
+            }
+            return glyph == GLYPH_SPACE ? 1 : 3;
+        };
+        auto appendCell = [this](int index) {
+            uint32_t foreground, background;
+            Glyph glyph = this->chooseGlyph(this->_upper[index], this->_lower[index], foreground, background);
+            if (foreground != this->_foreground || background != this->_background) {
+                this->appendColors(this->_quantizer,
+                                   foreground != this->_foreground ? foreground : ColorQuantizer::noColor,
+                                   background != this->_background ? background : ColorQuantizer::noColor);
+                this->_foreground = foreground;
+                this->_background = background;
+            }
+            if (glyph == GLYPH_SPACE) {
+                this->_frameBytes.push_back(' ');
+            }
+            else {
+                const char* bytes = HalfBlockDisplay::glyphs() + glyph * 3;
+                this->_frameBytes.insert(this->_frameBytes.end(), bytes, bytes + 3);
+            }
+        };
+
+        this->_frameBytes.clear();
+        if (!startedStream || !this->appendRuns(cellRects, this->_repaintBytes, isShown, gapBytes, appendCell)) {
+            this->_foreground = frameForeground;
+            this->_background = frameBackground;
+            this->appendRepaint(isShown, appendCell);
+            this->_repaintBytes = this->_frameBytes.size();
+        }
+        startedStream = true;
+
+        // everything that was written is what the terminal shows now
+        this->_shownUpper = this->_upper;
+        this->_shownLower = this->_lower;
+        this->writeFrame();
+    }
+};
+
+/// @brief A Display that renders 2x4 pixels per cell, with braille patterns
+/// @details Every pixel is a dot, raised when its luma reaches the threshold -- meant for wireframes, where the lines are
+/// @details bright and the rest is black; the pixels come out square, like the ones of HalfBlockDisplay
+/// @details The frames are sent like in AsciiDisplay -- empty cells are written as spaces, which take 1 byte instead of 3
+class BrailleDisplay : public TerminalDisplay {
+public:
+    /// @brief Constructor
+    /// @param width The width of the terminal, in cells -- the texture is twice as wide
+    /// @param height The height of the terminal, in cells -- the texture is four times as tall
+    /// @param threshold The luma (0-255) from which a pixel is a raised dot
+    /// @param output The file descriptor that the frames are written to
+    BrailleDisplay(int width, int height, int threshold = 64, int output = TerminalDisplay::STDERR_FD)
+        : TerminalDisplay(width, height, output), _threshold(threshold) {
+        this->_cells.assign(width * height, 0);
+        this->_shownCells = this->_cells;
+    }
+
+    /// @brief Renders the given texture to the terminal
+    /// @param tex The texture to render
+    void draw(const Texture& tex) {
+        this->_cellRects.assign(1, Rect(0, 0, (tex.getWidth() + 1) / 2, (tex.getHeight() + 3) / 4));
+        this->convert(tex, this->_cellRects);
+        this->present(this->_cellRects);
+    }
+
+    /// @brief Renders the parts of the texture that changed since the last draw to the terminal
+    /// @details The first draw, and any draw of a texture of another size, looks at everything
+    /// @param tex The texture to render
+    /// @param dirtyRects The parts of the texture that changed, in pixels
+    void draw(const Texture& tex, const std::vector<Rect>& dirtyRects) {
+        if (!startedStream || tex.getWidth() != this->_drawnWidth || tex.getHeight() != this->_drawnHeight) {
+            this->draw(tex);
+            return;
+        }
+        TerminalDisplay::toCellRects(dirtyRects, 2, 4, this->_cellRects);
+        this->convert(tex, this->_cellRects);
+        this->present(this->_cellRects);
+    }
+
+    int getPixelsPerColumn() const {
+        return 2;
+    }
+
+    int getPixelsPerRow() const {
+        return 4;
+    }
+
+    /// @brief Returns the UTF-8 of the 256 braille patterns, 3 bytes each, indexed by their dots -- built on first use
+    /// @details Bit 0-2 are the left column from the top, bit 3-5 the right one, bit 6 and 7 the bottom row
+    static const char* patterns() {
+        struct Patterns {
+            char bytes[256][3];
+            Patterns() {
+                for (int dots = 0; dots < 256; dots++) {
+                    TerminalDisplay::encodeUtf8(0x2800 + dots, this->bytes[dots]);
+                }
+            }
+        };
+        static const Patterns table;
+        return table.bytes[0];
+    }
+
+private:
+    int _threshold;
+
+    std::vector<unsigned char> _cells;      // the dots of the current frame, row after row
+    std::vector<unsigned char> _shownCells; // the dots that the terminal shows
+    std::vector<unsigned char> _lumas;      // the lumas of a row of pixels -- reused between rows
+    std::vector<Rect> _cellRects;           // the cells to look at, for the frame
+    size_t _repaintBytes = 0;               // the size of the last full repaint
+
+    /// @brief Converts the pixels of the given cells into dots
+    void convert(const Texture& tex, const std::vector<Rect>& cellRects) {
+        static const unsigned char dotBits[4][2] = {{0x01, 0x08}, {0x02, 0x10}, {0x04, 0x20}, {0x40, 0x80}};
+        Rect screen(0, 0, _width, _height);
+        Rect cells(0, 0, (tex.getWidth() + 1) / 2, (tex.getHeight() + 3) / 4);
+        for (const Rect& cellRect : cellRects) {
+            Rect rect = cellRect.intersect(screen).intersect(cells);
+            if (rect.minX >= rect.maxX) {
+                continue;
+            }
+            const int minX = rect.minX * 2, maxX = std::min(rect.maxX * 2, tex.getWidth());
+            this->_lumas.resize(maxX - minX);
+            for (int y = rect.minY; y < rect.maxY; y++) {
+                unsigned char* row = this->_cells.data() + y * _width;
+                std::fill(row + rect.minX, row + rect.maxX, 0);
+                for (int dotY = 0; dotY < 4 && y * 4 + dotY < tex.getHeight(); dotY++) {
+                    const unsigned char* pixels =
+                        reinterpret_cast<const unsigned char*>(tex.getPixels() + (y * 4 + dotY) * tex.getWidth() + minX);
+                    VecKernels::lumaRow(pixels, this->_lumas.data(), maxX - minX);
+                    for (int x = minX; x < maxX; x++) {
+                        if (this->_lumas[x - minX] >= this->_threshold) {
+                            row[x / 2] |= dotBits[dotY][x & 1];
+                        }
+                    }
+                }
+            }
+        }
+        this->_drawnWidth = tex.getWidth();
+        this->_drawnHeight = tex.getHeight();
+    }
+
+    /// @brief Brings the terminal up to date, looking for changes inside of the given cells
+    void present(const std::vector<Rect>& cellRects) {
+        auto isShown = [this](int index) {
+            return this->_cells[index] == this->_shownCells[index];
+        };
+        auto gapBytes = [this](int index) {
+            return this->_cells[index] == 0 ? 1 : 3;
+        };
+        auto appendCell = [this](int index) {
+            unsigned char dots = this->_cells[index];
+            if (dots == 0) {
+                this->_frameBytes.push_back(' ');
+                return;
+            }
+            const char* bytes = BrailleDisplay::patterns() + dots * 3;
+            this->_frameBytes.insert(this->_frameBytes.end(), bytes, bytes + 3);
+        };
+
+        this->_frameBytes.clear();
+        if (!startedStream || !this->appendRuns(cellRects, this->_repaintBytes, isShown, gapBytes, appendCell)) {
+            this->appendRepaint(isShown, appendCell);
+            this->_repaintBytes = this->_frameBytes.size();
+        }
+        startedStream = true;
+
+        // everything that was written is what the terminal shows now
+        this->_shownCells = this->_cells;
+        this->writeFrame();
+    }
+};
+
 #endif // __DISPLAY_H__
\ No newline at end of file
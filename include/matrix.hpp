@@ -10,10 +10,11 @@
 #include <cstring>
 
 #include "vec.hpp"
+#include "simd.hpp"
 
 /// @brief A compact representation of a 4x4 matrix
-/// @details A matrix is represented by 16 floats, one for each element
-struct Matrix
+/// @details A matrix is represented by 16 floats, one for each element (row-major)
+struct alignas(16) Matrix
 {
     float elements[16];
 #pragma region Constructors
@@ -37,10 +38,7 @@ struct Matrix
 
     /// @brief Copy constructor
     /// @details Initializes the matrix to the given matrix
-    Matrix(const Matrix &m)
-    {
-        memcpy(this->elements, m.elements, sizeof(float) * 16);
-    }
+    Matrix(const Matrix &m) = default;
 
     /// @brief Constructor
     /// @details Constructs a translation matrix from the given vector
@@ -113,11 +111,7 @@ struct Matrix
 #pragma region Matrix Operations
     /// @brief Assignment operator
     /// @details Assigns the matrix to the given matrix
-    Matrix &operator=(const Matrix &m)
-    {
-        memcpy(this->elements, m.elements, sizeof(float) * 16);
-        return *this;
-    }
+    Matrix &operator=(const Matrix &m) = default;
 
     /// @brief Addition operator
     /// @details Returns the sum of this matrix and the given matrix
@@ -148,19 +142,7 @@ struct Matrix
     Matrix operator*(const Matrix &m) const
     {
         Matrix result;
-        for (int row = 0; row < 4; row++)
-        {
-            for (int col = 0; col < 4; col++)
-            {
-
-                float sum = 0;
-                for (int i = 0; i < 4; i++)
-                {
-                    sum += this->at(row, i) * m.at(i, col);
-                }
-                result.set(row, col, sum);
-            }
-        }
+        VecKernels::matMat(this->elements, m.elements, result.elements);
         return result;
     }
 
@@ -170,18 +152,53 @@ struct Matrix
     Vec operator*(const Vec &v) const
     {
         Vec result;
-        for (int row = 0; row < 4; row++)
-        {
-            float sum = 0;
-            for (int i = 0; i < 4; i++)
-            {
-                sum += this->at(row, i) * v[i];
-            }
-            result[row] = sum;
-        }
+        VecKernels::matVec(this->elements, &v.x, &result.x);
         return result;
     }
 
+    /// @brief Transforms an array of points by this matrix
+    /// @details Equivalent to out[i] = *this * in[i] -- with SSE every point is one register, with AVX two points share
+    /// @details a register and the loop is unrolled to 8 points
+    /// @param in The points to transform
+    /// @param out The transformed points -- may alias in
+    /// @param count The number of points
+    /// @param inStride The distance between two input points, in Vecs (for interleaved vertex data)
+    /// @param outStride The distance between two output points, in Vecs
+    void transformPoints(const Vec *in, Vec *out, size_t count, size_t inStride = 1, size_t outStride = 1) const
+    {
+        const size_t floatsPerVec = sizeof(Vec) / sizeof(float);
+        VecKernels::transformPoints(this->elements, &in->x, inStride * floatsPerVec, &out->x, outStride * floatsPerVec, count);
+    }
+
+    /// @brief Transforms an array of normals by the upper 3x3 of this matrix
+    /// @details The translation is ignored, and the w component of every output is zero
+    /// @param in The normals to transform
+    /// @param out The transformed normals -- may alias in
+    /// @param count The number of normals
+    /// @param inStride The distance between two input normals, in Vecs (for interleaved vertex data)
+    /// @param outStride The distance between two output normals, in Vecs
+    void transformNormals(const Vec *in, Vec *out, size_t count, size_t inStride = 1, size_t outStride = 1) const
+    {
+        const size_t floatsPerVec = sizeof(Vec) / sizeof(float);
+        VecKernels::transformNormals(this->elements, &in->x, inStride * floatsPerVec, &out->x, outStride * floatsPerVec, count);
+    }
+
+    /// @brief Transforms an array of (position, normal) vertices in a single pass
+    /// @details Positions are transformed like transformPoints, normals like transformNormals -- one pass over memory instead of two
+    /// @param inPositions The positions to transform
+    /// @param inNormals The normals to transform
+    /// @param outPositions The transformed positions -- may alias inPositions
+    /// @param outNormals The transformed normals -- may alias inNormals
+    /// @param count The number of vertices
+    /// @param inStride The distance between two input vertices, in Vecs
+    /// @param outStride The distance between two output vertices, in Vecs
+    void transformVertices(const Vec *inPositions, const Vec *inNormals, Vec *outPositions, Vec *outNormals, size_t count, size_t inStride = 1, size_t outStride = 1) const
+    {
+        const size_t floatsPerVec = sizeof(Vec) / sizeof(float);
+        VecKernels::transformPointsAndNormals(this->elements, &inPositions->x, &inNormals->x, inStride * floatsPerVec,
+                                              &outPositions->x, &outNormals->x, outStride * floatsPerVec, count);
+    }
+
     /// @brief Multiplication operator
     /// @details Returns the product of this matrix and the given scalar
     Matrix operator*(float scalar) const
@@ -251,8 +268,7 @@ struct Matrix
     /// @details Multiplies this matrix by the given matrix
     Matrix &operator*=(const Matrix &m)
     {
-        Matrix result = *this * m;
-        *this = result;
+        VecKernels::matMat(this->elements, m.elements, this->elements);
         return *this;
     }
 
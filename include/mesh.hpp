@@ -17,9 +17,17 @@
 #include <vector>
 #include <memory>
 #include <map>
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 
 #include "vec.hpp"
 #include "matrix.hpp"
+#include "simd.hpp"
+#include "bounds.hpp"
 
 struct MeshVertex {
     Vec position; // 16 bytes
@@ -38,8 +46,9 @@ struct MeshVertex {
     /// @brief Copy constructor
     /// @details Initializes the vertex to the given vertex
     /// @param vertex The vertex to copy
-    MeshVertex(const MeshVertex& vertex) : position(vertex.position), normal(vertex.normal) {}
+    MeshVertex(const MeshVertex& vertex) = default;
 
+    MeshVertex& operator=(const MeshVertex& vertex) = default;
 };
 
 /// @brief A triangle is a collection of 3 vertices
@@ -73,7 +82,9 @@ struct Triangle {
     /// @brief Copy constructor
     /// @details Initializes the triangle to the given triangle
     /// @param triangle The triangle to copy
-    Triangle(const Triangle& triangle) : v1(triangle.v1), v2(triangle.v2), v3(triangle.v3) {}
+    Triangle(const Triangle& triangle) = default;
+
+    Triangle& operator=(const Triangle& triangle) = default;
 
     /// @brief Returns a triangle centered at the origin
     /// @details Returns a triangle centered at the origin (if -x is to the left, +x is to the right, -y is down, +y is up, the triangle visible)
@@ -120,30 +131,86 @@ struct Triangle {
     }
 };
 
+// Mesh::transform treats the triangles as one interleaved array of (position, normal) pairs
+static_assert(sizeof(MeshVertex) == 2 * sizeof(Vec), "MeshVertex must be a tightly packed (position, normal) pair");
+static_assert(sizeof(Triangle) == 3 * sizeof(MeshVertex), "Triangle must be 3 tightly packed vertices");
+
 /// @brief A mesh is a collection of triangles
+/// @details The mesh carries precomputed bounds -- call computeBounds() after editing the triangles directly
+/// @details computeBounds() also gives the mesh a new version, which is how caches built from the triangles notice the edit
 class Mesh {
 public:
     std::vector<Triangle> triangles;
 
     /// @brief Default constructor
     /// @details Initializes the mesh to the default values
-    Mesh() : triangles(std::vector<Triangle>()) {}
+    Mesh() : triangles(std::vector<Triangle>()), _version(0) {}
 
     /// @brief Constructor
     /// @details Initializes the mesh to the given values
     /// @param triangles The triangles of the mesh
-    Mesh(std::vector<Triangle> triangles) : triangles(triangles) {
+    Mesh(std::vector<Triangle> triangles) : triangles(std::move(triangles)) {
         // shrink the vector to fit
         this->triangles.shrink_to_fit();
+        this->computeBounds();
     }
 
     /// @brief Copy constructor
     /// @details Initializes the mesh to the given mesh
     /// @param mesh The mesh to copy
-    Mesh(const Mesh& mesh) : triangles() {
+    Mesh(const Mesh& mesh) : triangles(), _boundingBox(mesh._boundingBox), _boundingSphere(mesh._boundingSphere), _version(mesh._version) {
         this->triangles = std::vector<Triangle>(mesh.triangles);
     }
 
+    Mesh& operator=(const Mesh& mesh) = default;
+
+    /// @brief Recomputes the bounding box and bounding sphere from the triangles
+    /// @details The sphere is centered on the box, with the smallest radius that contains every vertex
+    void computeBounds() {
+        this->_version = Mesh::nextVersion();
+        this->_boundingBox = AABB();
+        for (const Triangle& triangle : this->triangles) {
+            this->_boundingBox.expand(triangle.v1.position);
+            this->_boundingBox.expand(triangle.v2.position);
+            this->_boundingBox.expand(triangle.v3.position);
+        }
+
+        if (this->_boundingBox.isEmpty()) {
+            this->_boundingSphere = BoundingSphere();
+            return;
+        }
+
+        Vec center = this->_boundingBox.getCenter();
+        float radiusSquared = 0.0f;
+        for (const Triangle& triangle : this->triangles) {
+            const MeshVertex* vertices[3] = {&triangle.v1, &triangle.v2, &triangle.v3};
+            for (const MeshVertex* vertex : vertices) {
+                float dx = vertex->position.x - center.x;
+                float dy = vertex->position.y - center.y;
+                float dz = vertex->position.z - center.z;
+                radiusSquared = std::max(radiusSquared, dx * dx + dy * dy + dz * dz);
+            }
+        }
+        this->_boundingSphere = BoundingSphere(center, std::sqrt(radiusSquared));
+    }
+
+    /// @brief Returns the axis aligned bounding box of the mesh, in model space
+    const AABB& getBoundingBox() const {
+        return this->_boundingBox;
+    }
+
+    /// @brief Returns the bounding sphere of the mesh, in model space
+    const BoundingSphere& getBoundingSphere() const {
+        return this->_boundingSphere;
+    }
+
+    /// @brief Returns the version of the triangles -- changes whenever the bounds are recomputed
+    /// @details Versions are unique across every mesh, so a copy shares the version of its source only while their
+    /// @details triangles are the same
+    uint64_t getVersion() const {
+        return this->_version;
+    }
+
     /// @brief Returns a quad centered at the origin
     /// @details Returns a quad centered at the origin (if -x is to the left, +x is to the right, -y is down, +y is up, the quad visible)
     static Mesh centeredQuad() {
@@ -163,35 +230,61 @@ public:
         return this->getTriangleCount() * 3;
     }
 
+    /// @brief Returns a transformed copy of the mesh
+    /// @details Allocates a new mesh -- prefer transform(matrix, out) when transforming every frame
     Mesh transform(const Matrix& transformationMatrix) const {
-        if (this->getTriangleCount() == 0) {
-            return Mesh();
-        }
+        Mesh transformedMesh = Mesh();
+        this->transform(transformationMatrix, transformedMesh);
+        return transformedMesh;
+    }
+
+    /// @brief Transforms the mesh into the given output mesh
+    /// @details The output keeps its capacity, so reusing it across frames only allocates when the mesh grows
+    /// @param transformationMatrix The matrix to transform by
+    /// @param out The mesh to write to -- resized to the triangle count of this mesh
+    void transform(const Matrix& transformationMatrix, Mesh& out) const {
+        out.triangles.resize(this->triangles.size());
+        this->transform(transformationMatrix, out.triangles.data());
+        // the transformed bounds contain the transformed mesh, without another pass over the vertices
+        out._boundingBox = this->_boundingBox.transform(transformationMatrix);
+        out._boundingSphere = this->_boundingSphere.transform(transformationMatrix);
+        out._version = Mesh::nextVersion();
+    }
 
-        // std::cout << "Transforming mesh with " << this->getTriangleCount() << " triangles" << std::endl;
-        if (this->getTriangleCount() > 10000 || this->getTriangleCount() < 0)
-        {
-            // std::cout << "WARNING: Transforming a mesh with " << this->getTriangleCount() << " triangles" << std::endl;
-            return Mesh();
+    /// @brief Transforms the mesh into the given triangle buffer
+    /// @param transformationMatrix The matrix to transform by
+    /// @param out The buffer to write to -- must have room for getTriangleCount() triangles
+    void transform(const Matrix& transformationMatrix, Triangle* out) const {
+        if (this->triangles.empty()) {
+            return;
         }
 
+        // transform every vertex in one batch -- positions and normals are interleaved, so the stride is 2 Vecs
+        const MeshVertex* in = &this->triangles[0].v1;
+        MeshVertex* outVertices = &out[0].v1;
+        size_t vertexCount = this->triangles.size() * 3;
+        transformationMatrix.transformVertices(&in->position, &in->normal, &outVertices->position, &outVertices->normal, vertexCount, 2, 2);
+    }
 
-        Mesh transformedMesh = Mesh();
-        int triCount = this->getTriangleCount();
-        if (triCount == 0) {
-            return transformedMesh;
+    /// @brief Transforms a range of the triangles into the given triangle buffer
+    /// @details Ranges that do not overlap can be transformed from different threads
+    /// @param transformationMatrix The matrix to transform by
+    /// @param out The buffer to write to -- must have room for count triangles, the first of which is triangle first
+    /// @param first The index of the first triangle to transform
+    /// @param count The number of triangles to transform
+    void transform(const Matrix& transformationMatrix, Triangle* out, size_t first, size_t count) const {
+        if (count == 0) {
+            return;
         }
-        transformedMesh.triangles = std::vector<Triangle>(triCount);
-        for (int i = 0; i < triCount; i++) {
-            Triangle triangle = this->triangles[i];
-            Triangle newTri = Triangle(
-                MeshVertex(transformationMatrix * triangle.v1.position, transformationMatrix * triangle.v1.normal),
-                MeshVertex(transformationMatrix * triangle.v2.position, transformationMatrix * triangle.v2.normal),
-                MeshVertex(transformationMatrix * triangle.v3.position, transformationMatrix * triangle.v3.normal)
-            );
-            transformedMesh.triangles[i] = newTri;
-        }
-        return transformedMesh;
+
+        const MeshVertex* in = &this->triangles[first].v1;
+        MeshVertex* outVertices = &out[0].v1;
+        transformationMatrix.transformVertices(&in->position, &in->normal, &outVertices->position, &outVertices->normal, count * 3, 2, 2);
+    }
+
+    /// @brief Returns the number of bytes used by the triangles of the mesh
+    size_t getMemoryUsage() const {
+        return this->triangles.size() * sizeof(Triangle);
     }
 
     Mesh move(const Vec& translation) const {
@@ -224,6 +317,221 @@ public:
         return this->triangles.end();
     }
 
+private:
+    AABB _boundingBox;
+    BoundingSphere _boundingSphere;
+    uint64_t _version; // 0 for a mesh that never had its bounds computed
+
+    // indexed meshes draw their versions from the same counter
+    friend class IndexedMesh;
+
+    /// @brief Returns a version that no mesh has had yet
+    static uint64_t nextVersion() {
+        static std::atomic<uint64_t> counter(0);
+        return ++counter;
+    }
+};
+
+/// @brief An indexed mesh, with its vertices stored as a structure of arrays
+/// @details Every unique vertex is stored once, in separate x/y/z streams for positions and normals
+/// @details Triangles are 3 indices into the vertex streams, with the same winding as Triangle
+/// @details Positions are points, their w component is implicitly 1
+class IndexedMesh {
+public:
+    std::vector<float> px, py, pz; // positions
+    std::vector<float> nx, ny, nz; // normals
+    std::vector<uint32_t> indices; // 3 per triangle
+
+    /// @brief Default constructor
+    /// @details Initializes the mesh to an empty mesh
+    IndexedMesh() {}
+
+    /// @brief Builds an indexed mesh from a triangle mesh
+    /// @details Vertices with identical positions and normals are merged into one
+    /// @param mesh The mesh to convert
+    /// @param positionsOnly Merge vertices by their positions alone, keeping the first normal -- for users of the mesh
+    /// that do not read the normals, since the faces of a flat shaded mesh rarely share one
+    static IndexedMesh fromMesh(const Mesh& mesh, bool positionsOnly = false) {
+        IndexedMesh indexed;
+        indexed.indices.reserve(mesh.triangles.size() * 3);
+
+        std::map<std::array<float, 6>, uint32_t> vertexIndices;
+        for (const Triangle& triangle : mesh.triangles) {
+            const MeshVertex* vertices[3] = {&triangle.v1, &triangle.v2, &triangle.v3};
+            for (const MeshVertex* vertex : vertices) {
+                std::array<float, 6> key = {
+                    vertex->position.x, vertex->position.y, vertex->position.z,
+                    positionsOnly ? 0.0f : vertex->normal.x, positionsOnly ? 0.0f : vertex->normal.y,
+                    positionsOnly ? 0.0f : vertex->normal.z};
+                auto it = vertexIndices.find(key);
+                if (it == vertexIndices.end()) {
+                    it = vertexIndices.emplace(key, indexed.addVertex(vertex->position, vertex->normal)).first;
+                }
+                indexed.indices.push_back(it->second);
+            }
+        }
+
+        indexed.shrinkToFit();
+        indexed.computeBounds();
+        return indexed;
+    }
+
+    /// @brief Converts the indexed mesh back into a triangle mesh
+    Mesh toMesh() const {
+        std::vector<Triangle> triangles(this->getTriangleCount());
+        for (int i = 0; i < this->getTriangleCount(); i++) {
+            triangles[i] = Triangle(
+                this->getVertex(this->indices[i * 3]),
+                this->getVertex(this->indices[i * 3 + 1]),
+                this->getVertex(this->indices[i * 3 + 2]));
+        }
+        return Mesh(triangles);
+    }
+
+    /// @brief Appends a vertex to the vertex streams
+    /// @return The index of the new vertex
+    uint32_t addVertex(const Vec& position, const Vec& normal) {
+        this->px.push_back(position.x);
+        this->py.push_back(position.y);
+        this->pz.push_back(position.z);
+        this->nx.push_back(normal.x);
+        this->ny.push_back(normal.y);
+        this->nz.push_back(normal.z);
+        // keep the bounds conservative -- the sphere is rebuilt around the box when it is asked for, and computeBounds()
+        // tightens it
+        this->_boundingBox.expand(position);
+        this->_sphereStale = true;
+        this->_version = Mesh::nextVersion();
+        return (uint32_t)(this->px.size() - 1);
+    }
+
+    /// @brief Appends a triangle made of the given vertex indices
+    void addTriangle(uint32_t i1, uint32_t i2, uint32_t i3) {
+        this->indices.push_back(i1);
+        this->indices.push_back(i2);
+        this->indices.push_back(i3);
+        this->_version = Mesh::nextVersion();
+    }
+
+    /// @brief Returns the vertex at the given index
+    MeshVertex getVertex(uint32_t index) const {
+        return MeshVertex(
+            Vec(this->px[index], this->py[index], this->pz[index], 1.0f),
+            Vec(this->nx[index], this->ny[index], this->nz[index], 0.0f));
+    }
+
+    /// @brief Returns the number of triangles in the mesh
+    int getTriangleCount() const {
+        return (int)(this->indices.size() / 3);
+    }
+
+    /// @brief Returns the number of unique vertices in the mesh
+    int getVertexCount() const {
+        return (int)this->px.size();
+    }
+
+    /// @brief Returns the number of bytes used by the vertex streams and the index buffer
+    size_t getMemoryUsage() const {
+        return this->px.size() * sizeof(float) * 6 + this->indices.size() * sizeof(uint32_t);
+    }
+
+    /// @brief Transforms every position, writing the results to separate x/y/z/w streams
+    /// @details Each output stream must have room for getVertexCount() floats
+    void transformPositions(const Matrix& transformationMatrix, float* outX, float* outY, float* outZ, float* outW) const {
+        VecKernels::transformPointsSoA(transformationMatrix.elements, this->px.data(), this->py.data(), this->pz.data(),
+                                       outX, outY, outZ, outW, this->px.size());
+    }
+
+    /// @brief Transforms a range of the positions, writing the results to separate x/y/z/w streams
+    /// @details Each output stream must have room for count floats, the first of which is vertex first -- ranges that
+    /// @details do not overlap can be transformed from different threads
+    void transformPositions(const Matrix& transformationMatrix, float* outX, float* outY, float* outZ, float* outW,
+                            size_t first, size_t count) const {
+        VecKernels::transformPointsSoA(transformationMatrix.elements, this->px.data() + first, this->py.data() + first,
+                                       this->pz.data() + first, outX, outY, outZ, outW, count);
+    }
+
+    /// @brief Transforms every normal by the upper 3x3 of the matrix, writing the results to separate x/y/z streams
+    /// @details Each output stream must have room for getVertexCount() floats
+    void transformNormals(const Matrix& transformationMatrix, float* outX, float* outY, float* outZ) const {
+        VecKernels::transformNormalsSoA(transformationMatrix.elements, this->nx.data(), this->ny.data(), this->nz.data(),
+                                        outX, outY, outZ, this->nx.size());
+    }
+
+    /// @brief Recomputes the bounding box and bounding sphere from the positions
+    /// @details The sphere is centered on the box, with the smallest radius that contains every vertex
+    void computeBounds() {
+        this->_version = Mesh::nextVersion();
+        this->_boundingBox = AABB();
+        this->_sphereStale = false;
+        for (size_t i = 0; i < this->px.size(); i++) {
+            this->_boundingBox.expand(this->px[i], this->py[i], this->pz[i]);
+        }
+
+        if (this->_boundingBox.isEmpty()) {
+            this->_boundingSphere = BoundingSphere();
+            return;
+        }
+
+        Vec center = this->_boundingBox.getCenter();
+        float radiusSquared = 0.0f;
+        for (size_t i = 0; i < this->px.size(); i++) {
+            float dx = this->px[i] - center.x;
+            float dy = this->py[i] - center.y;
+            float dz = this->pz[i] - center.z;
+            radiusSquared = std::max(radiusSquared, dx * dx + dy * dy + dz * dz);
+        }
+        this->_boundingSphere = BoundingSphere(center, std::sqrt(radiusSquared));
+    }
+
+    /// @brief Returns the axis aligned bounding box of the mesh, in model space
+    const AABB& getBoundingBox() const {
+        return this->_boundingBox;
+    }
+
+    /// @brief Returns the bounding sphere of the mesh, in model space
+    const BoundingSphere& getBoundingSphere() const {
+        if (this->_sphereStale) {
+            this->_boundingSphere = BoundingSphere::fromAABB(this->_boundingBox);
+            this->_sphereStale = false;
+        }
+        return this->_boundingSphere;
+    }
+
+    /// @brief Returns the version of the streams -- changes whenever a vertex or triangle is added, or the bounds are
+    /// @brief recomputed
+    /// @details Shares its counter with Mesh, so versions are unique across every mesh of either kind; after editing
+    /// @details the streams in place, call computeBounds()
+    uint64_t getVersion() const {
+        return this->_version;
+    }
+
+    /// @brief Releases any unused capacity in the streams
+    void shrinkToFit() {
+        this->px.shrink_to_fit();
+        this->py.shrink_to_fit();
+        this->pz.shrink_to_fit();
+        this->nx.shrink_to_fit();
+        this->ny.shrink_to_fit();
+        this->nz.shrink_to_fit();
+        this->indices.shrink_to_fit();
+    }
+
+    std::string toString() const {
+        std::stringstream ss;
+        ss << "IndexedMesh(" << std::endl;
+        ss << "  " << "Triangle Count: " << this->getTriangleCount() << std::endl;
+        ss << "  " << "Vertex Count: " << this->getVertexCount() << std::endl;
+        ss << ")";
+        return ss.str();
+    }
+
+private:
+    AABB _boundingBox;
+    // a cache -- addVertex() only grows the box, and the sphere is rebuilt around it on the next read
+    mutable BoundingSphere _boundingSphere;
+    mutable bool _sphereStale = false;
+    uint64_t _version = 0; // 0 for an empty mesh that was never edited
 };
 
 /// @brief An interface that all mesh importers must implement
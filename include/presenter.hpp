@@ -0,0 +1,226 @@
+#ifndef __PRESENTER_H__
+#define __PRESENTER_H__
+
+// Header file for the presenter
+// A thread that owns a Display and draws the frames that the renderer hands it, so that rendering never waits on output
+
+// notes for development:
+// - the frames go through a triple buffer -- the renderer owns one slot, the presenter another, and the third is the
+//   latest finished frame; handing a frame over is a single atomic exchange on either side, with no lock
+// - a frame that is replaced before the presenter took it is dropped -- every frame carries the dirty rectangles of the
+//   frames before it that the presenter may not have taken, so that the display still looks at everything that changed
+// - the mutex and condition variable only wake the presenter up -- neither is held while a frame is copied or drawn
+
+// Dependencies
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "tex.hpp"
+#include "display.hpp"
+
+/// @brief Counters of the frames that went through a presenter
+struct PresenterStats
+{
+public:
+    uint64_t framesSubmitted = 0; // frames handed over by the renderer
+    uint64_t framesPresented = 0; // frames that the display drew
+    uint64_t framesDropped = 0;   // frames replaced by a newer one before the display got to them
+
+    std::string toString() const
+    {
+        std::stringstream ss;
+        ss << "PresenterStats(framesSubmitted: " << this->framesSubmitted << ", framesPresented: " << this->framesPresented
+           << ", framesDropped: " << this->framesDropped << ")";
+        return ss.str();
+    }
+};
+
+/// @brief Draws frames to a Display on a thread of its own
+/// @details submit() copies the frame into a free slot and publishes it without blocking -- when the display is slower
+/// @details than the renderer, the oldest frame that was not drawn yet is dropped, so the display always draws the
+/// @details latest frame
+/// @details The presenter owns the display from construction on: it prepares it before every frame, and cleans it up
+/// @details when the presenter is destroyed
+class DisplayPresenter
+{
+public:
+    /// @brief Constructor
+    /// @details Starts the presenter thread
+    /// @param display The display to draw to -- only the presenter thread uses it from now on
+    explicit DisplayPresenter(std::shared_ptr<IDisplay> display)
+        : _display(display), _back(0), _middle(1), _front(2), _stopping(false), _drawing(false), _submitted(0),
+          _presented(0), _dropped(0)
+    {
+        this->_thread = std::thread(&DisplayPresenter::presentLoop, this);
+    }
+
+    DisplayPresenter(const DisplayPresenter &presenter) = delete;
+    DisplayPresenter &operator=(const DisplayPresenter &presenter) = delete;
+
+    /// @brief Destructor
+    /// @details Draws the last frame if it is still waiting, cleans up the display and joins the thread
+    ~DisplayPresenter()
+    {
+        {
+            std::lock_guard<std::mutex> lock(this->_mutex);
+            this->_stopping = true;
+        }
+        this->_wake.notify_one();
+        this->_thread.join();
+    }
+
+    /// @brief Hands a frame over to the presenter
+    /// @details Copies the texture, so it can be rendered to again right away -- never waits for the display
+    /// @param tex The frame
+    /// @param dirtyRects The parts of the frame that changed since the last submitted frame, in pixels
+    void submit(const Texture &tex, const std::vector<Rect> &dirtyRects)
+    {
+        Slot &slot = this->_slots[this->_back];
+        if (slot.texture == nullptr || slot.texture->getWidth() != tex.getWidth() ||
+            slot.texture->getHeight() != tex.getHeight())
+        {
+            slot.texture.reset(new Texture(tex.getWidth(), tex.getHeight()));
+        }
+        std::copy(tex.getPixels(), tex.getPixels() + tex.getWidth() * tex.getHeight(), slot.texture->getPixels());
+
+        // once the last frame was taken, the presenter has seen every change before this frame -- until then, the
+        // last frame may still be dropped, and this frame has to cover what it changed
+        if ((this->_middle.load(std::memory_order_acquire) & FRESH) == 0)
+        {
+            this->_untakenRects.clear();
+        }
+        this->_untakenRects.insert(this->_untakenRects.end(), dirtyRects.begin(), dirtyRects.end());
+        if (this->_untakenRects.size() > MAX_UNTAKEN_RECTS)
+        {
+            // the display is far behind -- one rectangle around everything will do
+            Rect bounds = this->_untakenRects[0];
+            for (const Rect &rect : this->_untakenRects)
+            {
+                bounds = Rect(std::min(bounds.minX, rect.minX), std::min(bounds.minY, rect.minY),
+                              std::max(bounds.maxX, rect.maxX), std::max(bounds.maxY, rect.maxY));
+            }
+            this->_untakenRects.assign(1, bounds);
+        }
+        slot.dirtyRects.assign(this->_untakenRects.begin(), this->_untakenRects.end());
+        this->_submitted++;
+
+        // publish the slot, and take the one that was waiting in its place
+        int previous = this->_middle.exchange(this->_back | FRESH, std::memory_order_acq_rel);
+        this->_back = previous & INDEX;
+        if ((previous & FRESH) != 0)
+        {
+            this->_dropped++;
+        }
+
+        // the lock orders the wake up against the presenter checking for a frame, it is held for no work at all
+        {
+            std::lock_guard<std::mutex> lock(this->_mutex);
+        }
+        this->_wake.notify_one();
+    }
+
+    /// @brief Hands a whole frame over to the presenter
+    /// @param tex The frame
+    void submit(const Texture &tex)
+    {
+        this->submit(tex, std::vector<Rect>(1, Rect(0, 0, tex.getWidth(), tex.getHeight())));
+    }
+
+    /// @brief Waits until the presenter has drawn, or dropped, every frame that was submitted
+    void flush()
+    {
+        std::unique_lock<std::mutex> lock(this->_mutex);
+        this->_idle.wait(lock, [this]()
+                         { return !this->_drawing && (this->_middle.load(std::memory_order_acquire) & FRESH) == 0; });
+    }
+
+    /// @brief Returns the counters of the frames so far
+    PresenterStats getStats() const
+    {
+        PresenterStats stats;
+        stats.framesSubmitted = this->_submitted.load();
+        stats.framesPresented = this->_presented.load();
+        stats.framesDropped = this->_dropped.load();
+        return stats;
+    }
+
+    std::string toString() const
+    {
+        std::stringstream ss;
+        ss << "DisplayPresenter(" << this->getStats().toString() << ")";
+        return ss.str();
+    }
+
+private:
+    // the middle slot is an index, with a bit that tells whether the frame in it was not taken by the presenter yet
+    static constexpr int INDEX = 3;
+    static constexpr int FRESH = 4;
+    static constexpr size_t MAX_UNTAKEN_RECTS = 64;
+
+    /// @brief A frame, with the parts of it that changed
+    struct Slot
+    {
+        std::unique_ptr<Texture> texture;
+        std::vector<Rect> dirtyRects;
+    };
+
+    std::shared_ptr<IDisplay> _display;
+    Slot _slots[3];
+    int _back;               // the slot that the renderer fills -- only touched by submit()
+    std::atomic<int> _middle; // the latest finished frame
+    int _front;              // the slot that the presenter draws -- only touched by the presenter thread
+    std::vector<Rect> _untakenRects; // the dirty rectangles since the last frame that the presenter is known to have taken
+
+    std::thread _thread;
+    std::mutex _mutex;
+    std::condition_variable _wake; // a frame was submitted, or the presenter is stopping
+    std::condition_variable _idle; // the presenter finished a frame
+    bool _stopping;
+    bool _drawing; // the presenter took a frame and has not finished drawing it
+
+    std::atomic<uint64_t> _submitted;
+    std::atomic<uint64_t> _presented;
+    std::atomic<uint64_t> _dropped;
+
+    void presentLoop()
+    {
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(this->_mutex);
+                this->_wake.wait(lock, [this]()
+                                 { return this->_stopping || (this->_middle.load(std::memory_order_acquire) & FRESH) != 0; });
+                if ((this->_middle.load(std::memory_order_acquire) & FRESH) == 0)
+                {
+                    // stopping, and every frame was drawn
+                    break;
+                }
+                this->_drawing = true;
+            }
+
+            // take the latest frame, and give the slot that was drawn last back
+            this->_front = this->_middle.exchange(this->_front, std::memory_order_acq_rel) & INDEX;
+            const Slot &slot = this->_slots[this->_front];
+            this->_display->prepare();
+            this->_display->draw(*slot.texture, slot.dirtyRects);
+            this->_presented++;
+
+            {
+                std::lock_guard<std::mutex> lock(this->_mutex);
+                this->_drawing = false;
+            }
+            this->_idle.notify_all();
+        }
+        this->_display->cleanup();
+    }
+};
+
+#endif // __PRESENTER_H__
@@ -0,0 +1,358 @@
+#ifndef __RASTER_H__
+#define __RASTER_H__
+
+// Header file for all things related to triangle rasterization
+// Half-space (edge function) rasterization, straight into the rows of a texture and its depth buffer
+
+// notes for development:
+// - coverage is exact -- corners are snapped to 1/16 of a pixel, and the edge functions are evaluated in integers
+// - the top-left fill rule makes triangles that share an edge cover each pixel along it exactly once
+// - ScalarRasterKernels is the reference implementation -- the SIMD kernels must write exactly the same pixels and depths
+// - NEON builds use the scalar kernel for now
+
+// Dependencies
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+
+#include "simd.hpp"
+#include "vec.hpp"
+
+/// @brief The rows that triangles are rasterized into
+/// @details Pixels are 32 bit colors, stored row after row; the depth buffer has the same layout, and is optional
+struct RasterTarget
+{
+    uint32_t *pixels;
+    float *depths; // 1/w, larger is closer -- nullptr to skip the depth test
+    int width;
+    int height;
+
+    RasterTarget(uint32_t *pixels, float *depths, int width, int height) : pixels(pixels), depths(depths), width(width), height(height) {}
+};
+
+/// @brief A triangle, set up for rasterization
+/// @details Each edge is an edge function e(x, y) = stepX * x + stepY * y + offset of the pixel coordinates, which is
+/// @details >= 0 on the pixel centers that the edge lets through -- the fill rule is folded into the offset
+/// @details Depth is the plane of 1/w through the corners, which is perspective correct
+struct RasterTriangle
+{
+    static const int SUBPIXEL_BITS = 4;
+    static const int SUBPIXEL_ONE = 1 << SUBPIXEL_BITS;
+    /// @brief Corners further than this from the origin, in pixels, are not rasterized -- clip them first
+    static constexpr float MAX_COORDINATE = (float)(1 << 20);
+
+    int64_t stepX[3], stepY[3], offset[3];
+    float depthOrigin;            // at the center of pixel (0, 0)
+    float depthStepX, depthStepY; // per pixel
+    int minX, minY, maxX, maxY;   // every covered pixel is in here, inclusive, and on the target
+
+    /// @brief Sets the triangle up -- both windings are filled
+    /// @param p1 The first corner, in pixels -- w holds 1/w
+    /// @param p2 The second corner, in pixels -- w holds 1/w
+    /// @param p3 The third corner, in pixels -- w holds 1/w
+    /// @param width The width of the target
+    /// @param height The height of the target
+    /// @return False if the triangle covers no pixel of the target
+    bool setup(const Vec &p1, const Vec &p2, const Vec &p3, int width, int height)
+    {
+        const Vec *corners[3] = {&p1, &p2, &p3};
+        int64_t x[3], y[3];
+        for (int i = 0; i < 3; i++)
+        {
+            // written so that NaN fails too
+            if (!(std::fabs(corners[i]->x) <= MAX_COORDINATE && std::fabs(corners[i]->y) <= MAX_COORDINATE))
+            {
+                return false;
+            }
+            x[i] = (int64_t)std::floor(corners[i]->x * SUBPIXEL_ONE + 0.5f);
+            y[i] = (int64_t)std::floor(corners[i]->y * SUBPIXEL_ONE + 0.5f);
+        }
+
+        int64_t area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+        if (area == 0)
+        {
+            return false;
+        }
+        if (area < 0)
+        {
+            // flip to the winding whose inside is positive
+            std::swap(x[1], x[2]);
+            std::swap(y[1], y[2]);
+        }
+
+        // the pixels whose centers are inside the snapped bounds
+        const int64_t half = SUBPIXEL_ONE / 2;
+        int64_t left = std::min(x[0], std::min(x[1], x[2])), right = std::max(x[0], std::max(x[1], x[2]));
+        int64_t top = std::min(y[0], std::min(y[1], y[2])), bottom = std::max(y[0], std::max(y[1], y[2]));
+        this->minX = (int)std::max<int64_t>(0, RasterTriangle::floorDiv(left - half + SUBPIXEL_ONE - 1, SUBPIXEL_ONE));
+        this->minY = (int)std::max<int64_t>(0, RasterTriangle::floorDiv(top - half + SUBPIXEL_ONE - 1, SUBPIXEL_ONE));
+        this->maxX = (int)std::min<int64_t>(width - 1, RasterTriangle::floorDiv(right - half, SUBPIXEL_ONE));
+        this->maxY = (int)std::min<int64_t>(height - 1, RasterTriangle::floorDiv(bottom - half, SUBPIXEL_ONE));
+        if (this->minX > this->maxX || this->minY > this->maxY)
+        {
+            return false;
+        }
+
+        for (int i = 0; i < 3; i++)
+        {
+            int a = i, b = (i + 1) % 3;
+            int64_t edgeA = y[a] - y[b], edgeB = x[b] - x[a], edgeC = x[a] * y[b] - y[a] * x[b];
+            // y points down: a left edge has the inside to its right, a top edge has it below -- pixel centers exactly on
+            // any other edge belong to the neighbouring triangle
+            bool topLeft = edgeA > 0 || (edgeA == 0 && edgeB > 0);
+            this->stepX[i] = edgeA * SUBPIXEL_ONE;
+            this->stepY[i] = edgeB * SUBPIXEL_ONE;
+            this->offset[i] = (edgeA + edgeB) * half + edgeC - (topLeft ? 0 : 1);
+        }
+
+        float depthArea = (p2.x - p1.x) * (p3.y - p1.y) - (p3.x - p1.x) * (p2.y - p1.y);
+        this->depthStepX = 0.0f;
+        this->depthStepY = 0.0f;
+        if (depthArea != 0.0f)
+        {
+            this->depthStepX = ((p2.w - p1.w) * (p3.y - p1.y) - (p3.w - p1.w) * (p2.y - p1.y)) / depthArea;
+            this->depthStepY = ((p3.w - p1.w) * (p2.x - p1.x) - (p2.w - p1.w) * (p3.x - p1.x)) / depthArea;
+        }
+        this->depthOrigin = p1.w + (0.5f - p1.x) * this->depthStepX + (0.5f - p1.y) * this->depthStepY;
+        return true;
+    }
+
+    /// @brief Narrows the bounds to the given pixels, inclusive -- the coverage of the pixels inside does not change
+    /// @return False if no pixel is left
+    bool clip(int clipMinX, int clipMinY, int clipMaxX, int clipMaxY)
+    {
+        this->minX = std::max(this->minX, clipMinX);
+        this->minY = std::max(this->minY, clipMinY);
+        this->maxX = std::min(this->maxX, clipMaxX);
+        this->maxY = std::min(this->maxY, clipMaxY);
+        return this->minX <= this->maxX && this->minY <= this->maxY;
+    }
+
+    /// @brief Returns the depth at the center of the given pixel -- every kernel computes it exactly like this
+    float depthAt(float rowDepth, int x) const
+    {
+        return rowDepth + this->depthStepX * (float)x;
+    }
+
+    /// @brief Returns the depth at the start of the given row
+    float rowDepth(int y) const
+    {
+        return this->depthOrigin + this->depthStepY * (float)y;
+    }
+
+private:
+    static int64_t floorDiv(int64_t a, int64_t b)
+    {
+        int64_t q = a / b;
+        return (a % b != 0 && a < 0) ? q - 1 : q;
+    }
+};
+
+/// @brief The scalar reference implementation of the raster kernels
+struct ScalarRasterKernels
+{
+    static const char *name()
+    {
+        return "scalar";
+    }
+
+    /// @brief Writes the color into every covered pixel of the triangle that passes the depth test
+    /// @return The number of pixels written
+    static inline int fill(const RasterTriangle &t, const RasterTarget &target, uint32_t color)
+    {
+        int written = 0;
+        for (int y = t.minY; y <= t.maxY; y++)
+        {
+            int64_t e0 = t.stepX[0] * t.minX + t.stepY[0] * y + t.offset[0];
+            int64_t e1 = t.stepX[1] * t.minX + t.stepY[1] * y + t.offset[1];
+            int64_t e2 = t.stepX[2] * t.minX + t.stepY[2] * y + t.offset[2];
+            uint32_t *pixels = target.pixels + (size_t)y * target.width;
+            float *depths = target.depths != nullptr ? target.depths + (size_t)y * target.width : nullptr;
+            float rowDepth = t.rowDepth(y);
+
+            for (int x = t.minX; x <= t.maxX; x++, e0 += t.stepX[0], e1 += t.stepX[1], e2 += t.stepX[2])
+            {
+                if ((e0 | e1 | e2) < 0)
+                {
+                    continue;
+                }
+                if (depths != nullptr)
+                {
+                    float depth = t.depthAt(rowDepth, x);
+                    if (!(depth > depths[x]))
+                    {
+                        continue;
+                    }
+                    depths[x] = depth;
+                }
+                pixels[x] = color;
+                written++;
+            }
+        }
+        return written;
+    }
+};
+
+#if defined(RASCII_SIMD_SSE)
+/// @brief SSE2 implementation of the raster kernels
+/// @details Walks the bounds in 4x4 blocks -- blocks outside of an edge are skipped, blocks inside of every edge skip the
+/// @details coverage test, and everything else is tested a row of 4 pixels at a time
+struct SimdRasterKernels
+{
+    static const char *name()
+    {
+        return "sse";
+    }
+
+    static inline int fill(const RasterTriangle &t, const RasterTarget &target, uint32_t color)
+    {
+        // a triangle this small is mostly block setup -- the scalar loop is quicker
+        if ((t.maxX - t.minX + 1) * (t.maxY - t.minY + 1) <= SMALL_TRIANGLE_PIXELS)
+        {
+            return ScalarRasterKernels::fill(t, target, color);
+        }
+        return SimdRasterKernels::fillBlocks(t, target, color);
+    }
+
+private:
+    static const int SMALL_TRIANGLE_PIXELS = 32; // in bounds area
+
+    /// @brief Rasterizes the triangle in 4x4 blocks
+    static int fillBlocks(const RasterTriangle &t, const RasterTarget &target, uint32_t color)
+    {
+        // blocks are aligned to 4 pixels, and the edge functions are rebased onto the first one -- they have to fit into
+        // 32 bits over every block, which only very large triangles on very large targets do not
+        const int originX = t.minX & ~3, originY = t.minY & ~3;
+        const int64_t spanX = t.maxX - originX + 4, spanY = t.maxY - originY + 4;
+        int32_t origin[3], stepX[3], stepY[3];
+        for (int i = 0; i < 3; i++)
+        {
+            int64_t e = t.stepX[i] * originX + t.stepY[i] * originY + t.offset[i];
+            int64_t bound = std::abs(e) + std::abs(t.stepX[i]) * spanX + std::abs(t.stepY[i]) * spanY;
+            if (bound > INT32_MAX)
+            {
+                return ScalarRasterKernels::fill(t, target, color);
+            }
+            origin[i] = (int32_t)e;
+            stepX[i] = (int32_t)t.stepX[i];
+            stepY[i] = (int32_t)t.stepY[i];
+        }
+
+        const __m128i laneIndex = _mm_set_epi32(3, 2, 1, 0);
+        const __m128i minusOne = _mm_set1_epi32(-1);
+        __m128i laneSteps[3];
+        for (int i = 0; i < 3; i++)
+        {
+            laneSteps[i] = _mm_set_epi32(stepX[i] * 3, stepX[i] * 2, stepX[i], 0);
+        }
+
+        int written = 0;
+        for (int blockY = originY; blockY <= t.maxY; blockY += 4)
+        {
+            // blocks are aligned, the bounds are not -- rows and lanes outside of them may be off the target, or belong
+            // to another thread
+            const int firstRow = std::max(0, t.minY - blockY), rows = std::min(4, t.maxY - blockY + 1);
+            for (int blockX = originX; blockX <= t.maxX; blockX += 4)
+            {
+                // the edge functions are linear, so their extremes over the block are at its corners
+                int32_t corner[3];
+                bool outside = false, inside = true;
+                for (int i = 0; i < 3; i++)
+                {
+                    corner[i] = origin[i] + stepX[i] * (blockX - originX) + stepY[i] * (blockY - originY);
+                    int32_t largest = corner[i] + std::max(stepX[i], 0) * 3 + std::max(stepY[i], 0) * 3;
+                    int32_t smallest = corner[i] + std::min(stepX[i], 0) * 3 + std::min(stepY[i], 0) * 3;
+                    outside = outside || largest < 0;
+                    inside = inside && smallest >= 0;
+                }
+                if (outside)
+                {
+                    continue;
+                }
+
+                const __m128i lanes = _mm_andnot_si128(_mm_cmpgt_epi32(_mm_set1_epi32(t.minX - blockX), laneIndex),
+                                                       _mm_cmpgt_epi32(_mm_set1_epi32(t.maxX - blockX + 1), laneIndex));
+                for (int row = firstRow; row < rows; row++)
+                {
+                    __m128i mask = lanes;
+                    if (!inside)
+                    {
+                        for (int i = 0; i < 3; i++)
+                        {
+                            __m128i e = _mm_add_epi32(_mm_set1_epi32(corner[i] + stepY[i] * row), laneSteps[i]);
+                            mask = _mm_and_si128(mask, _mm_cmpgt_epi32(e, minusOne));
+                        }
+                    }
+                    if (_mm_movemask_ps(_mm_castsi128_ps(mask)) != 0)
+                    {
+                        written += SimdRasterKernels::writeRow(t, target, blockX, blockY + row, mask, color);
+                    }
+                }
+            }
+        }
+        return written;
+    }
+
+    /// @brief Depth tests and writes the covered pixels of 4 adjacent pixels in a row
+    static inline int writeRow(const RasterTriangle &t, const RasterTarget &target, int x, int y, __m128i mask, uint32_t color)
+    {
+        uint32_t *pixels = target.pixels + (size_t)y * target.width + x;
+        float *depths = target.depths != nullptr ? target.depths + (size_t)y * target.width + x : nullptr;
+        float rowDepth = t.rowDepth(y);
+
+        if (x + 4 > target.width)
+        {
+            // the last block of a row that is not a multiple of 4 wide -- a full load would run off the row
+            int written = 0;
+            int bits = _mm_movemask_ps(_mm_castsi128_ps(mask));
+            for (int lane = 0; lane < 4; lane++)
+            {
+                if ((bits & (1 << lane)) == 0)
+                {
+                    continue;
+                }
+                if (depths != nullptr)
+                {
+                    float depth = t.depthAt(rowDepth, x + lane);
+                    if (!(depth > depths[lane]))
+                    {
+                        continue;
+                    }
+                    depths[lane] = depth;
+                }
+                pixels[lane] = color;
+                written++;
+            }
+            return written;
+        }
+
+        if (depths != nullptr)
+        {
+            __m128 xs = _mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(x), _mm_set_epi32(3, 2, 1, 0)));
+            __m128 depth = _mm_add_ps(_mm_set1_ps(rowDepth), _mm_mul_ps(_mm_set1_ps(t.depthStepX), xs));
+            __m128 old = _mm_loadu_ps(depths);
+            mask = _mm_and_si128(mask, _mm_castps_si128(_mm_cmpgt_ps(depth, old)));
+            __m128 maskPs = _mm_castsi128_ps(mask);
+            _mm_storeu_ps(depths, _mm_or_ps(_mm_and_ps(maskPs, depth), _mm_andnot_ps(maskPs, old)));
+        }
+
+        __m128i old = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pixels));
+        __m128i colors = _mm_set1_epi32((int)color);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(pixels), _mm_or_si128(_mm_and_si128(mask, colors), _mm_andnot_si128(mask, old)));
+
+        int bits = _mm_movemask_ps(_mm_castsi128_ps(mask));
+        return (bits & 1) + ((bits >> 1) & 1) + ((bits >> 2) & 1) + ((bits >> 3) & 1);
+    }
+};
+#endif
+
+/// @brief The raster kernels used by TextureDrawer -- chosen at compile time
+#if defined(RASCII_SIMD_SSE)
+typedef SimdRasterKernels RasterKernels;
+#else
+typedef ScalarRasterKernels RasterKernels;
+#endif
+
+#endif // __RASTER_H__
@@ -11,13 +11,22 @@
 #include <iostream>
 #include <string>
 #include <algorithm>
+#include <cmath>
+#include <limits>
 #include <memory>
+#include <unordered_map>
+#include <vector>
 
 #include "tex.hpp"
 #include "vec.hpp"
 #include "matrix.hpp"
 #include "mesh.hpp"
 #include "scene_graph.hpp"
+#include "arena.hpp"
+#include "bounds.hpp"
+#include "clip.hpp"
+#include "thread_pool.hpp"
+#include "camera.hpp"
 
 /// @brief The interface that all renderers must implement
 /// @details A renderer is responsible for taking a scene graph and rendering it into a texture representation
@@ -49,6 +58,14 @@ public:
     virtual std::shared_ptr<Texture> getOutput() const = 0;
 };
 
+/// @brief How the renderer draws triangles
+enum RenderMode
+{
+    RENDER_WIREFRAME,       // triangle outlines, without a depth test
+    RENDER_SOLID,           // flat shaded, depth tested triangles
+    RENDER_SOLID_WIREFRAME, // solid, with the outlines of the visible edges on top
+};
+
 struct RenderSettings
 {
 public:
@@ -57,10 +74,32 @@ public:
     float fov;
     float nearPlane;
     float farPlane;
+    RenderMode renderMode;
+    int threadCount;       // threads that rasterize the screen tiles, including the rendering thread -- 0 for one per core
+    int vertexThreadCount; // threads of the vertex stage, at most threadCount -- 0 for all of them, 1 for a serial stage
+    bool vertexCache;      // draw meshes that share vertices through an indexed copy, so each vertex is transformed once
+    float pixelAspect;     // the height of a pixel over its width, as the output shows it -- 1 for square pixels
 
     // RenderSettings() : width(0), height(0), fov(0.0f), near(0.0f), far(0.0f) {}
-    RenderSettings(int width, int height, float fov, float nearPlane, float farPlane) : width(width), height(height), fov(fov), nearPlane(nearPlane), farPlane(farPlane) {}
-    RenderSettings(const RenderSettings &settings) : width(settings.width), height(settings.height), fov(settings.fov), nearPlane(settings.nearPlane), farPlane(settings.farPlane) {}
+    RenderSettings(int width, int height, float fov, float nearPlane, float farPlane, RenderMode renderMode = RENDER_WIREFRAME, int threadCount = 0, int vertexThreadCount = 0, bool vertexCache = true, float pixelAspect = 1.0f)
+        : width(width), height(height), fov(fov), nearPlane(nearPlane), farPlane(farPlane), renderMode(renderMode), threadCount(threadCount), vertexThreadCount(vertexThreadCount), vertexCache(vertexCache), pixelAspect(pixelAspect) {}
+    RenderSettings(const RenderSettings &settings) : width(settings.width), height(settings.height), fov(settings.fov), nearPlane(settings.nearPlane), farPlane(settings.farPlane), renderMode(settings.renderMode), threadCount(settings.threadCount), vertexThreadCount(settings.vertexThreadCount), vertexCache(settings.vertexCache), pixelAspect(settings.pixelAspect) {}
+
+    /// @brief Sets the size of the output to the pixel grid of a terminal, whose cells each show several pixels
+    /// @details The half block displays show 1x2 pixels per cell, braille 2x4 -- terminal cells are about twice as tall
+    /// @details as they are wide, so the pixels of both come out square, and the ones of a plain ascii display tall
+    /// @param columns The width of the terminal, in cells
+    /// @param rows The height of the terminal, in cells
+    /// @param pixelsPerColumn The number of pixels that one cell shows, across
+    /// @param pixelsPerRow The number of pixels that one cell shows, down
+    /// @param cellAspect The height of a cell of the terminal over its width
+    RenderSettings &setPixelGrid(int columns, int rows, int pixelsPerColumn, int pixelsPerRow, float cellAspect = 2.0f)
+    {
+        this->width = columns * pixelsPerColumn;
+        this->height = rows * pixelsPerRow;
+        this->pixelAspect = cellAspect * (float)pixelsPerColumn / (float)pixelsPerRow;
+        return *this;
+    }
 
     std::string toString() const
     {
@@ -73,14 +112,105 @@ public:
         ss << "  nearPlane: " << this->nearPlane << "\n";
         ss << "  farPlane: " << this->farPlane << "\n";
         ss << "  range: " << this->farPlane - this->nearPlane << "\n";
+        ss << "  renderMode: " << this->renderMode << "\n";
+        ss << "  threadCount: " << this->threadCount << "\n";
+        ss << "  vertexThreadCount: " << this->vertexThreadCount << "\n";
+        ss << "  vertexCache: " << this->vertexCache << "\n";
+        ss << "  pixelAspect: " << this->pixelAspect << "\n";
         ss << ")";
         return ss.str();
     }
 };
 
+/// @brief Statistics about the last rendered frame
+/// @details Reset in prepare(), filled in by render()
+struct RenderStats
+{
+public:
+    int nodesVisited = 0;
+    int nodesDrawn = 0;
+    int nodesCulled = 0;    // nodes with geometry that were entirely outside of the view frustum
+    int subtreesCulled = 0; // branches that were rejected with a single test of their merged bounds
+    int trianglesDrawn = 0;
+    int trianglesCulled = 0; // triangles discarded by the cull mode of their node
+    int trianglesClipped = 0; // triangles that crossed the near or far plane, or the guard band
+    int trianglesOutside = 0; // triangles that were entirely outside of the view
+    int drawCommands = 0;     // fills and lines handed to the tiles
+    int binnedCommands = 0;   // commands summed over every tile they touch -- the overlap of the binning
+    int vertexJobs = 0;       // ranges of vertices and triangles that the vertex stage was split into
+    int projectionRebuilds = 0; // times the projection was rebuilt -- 0 unless the projection parameters changed
+    int viewRebuilds = 0;       // times the view was rebuilt -- 0 unless the camera moved or the projection changed
+    int verticesTransformed = 0; // vertices that went through a clip matrix
+    int vertexCacheHits = 0;     // triangle corners that reused a vertex that was already transformed
+    int vertexCacheBuilds = 0;   // meshes that were indexed for the vertex cache -- 0 unless a mesh is new or was edited
+    int nodesChanged = 0; // nodes that moved, or changed their geometry, since the last frame -- 0 after a full redraw
+    int tilesRedrawn = 0; // screen tiles that were cleared and drawn again -- 0 when nothing on screen changed
+    size_t arenaBytesUsed = 0;       // bytes of transient data the frame needed
+    size_t arenaCapacity = 0;        // bytes the frame arena owns
+    size_t arenaHeapAllocations = 0; // times the frame arena had to grow during the frame -- 0 in a steady state
+
+    /// @brief Returns the share of the triangle corners that did not need a transform of their own
+    /// @details 0 when every corner is transformed, approaching 5/6 for a closed mesh where 6 triangles meet at a vertex
+    float getVertexCacheHitRate() const
+    {
+        int corners = this->verticesTransformed + this->vertexCacheHits;
+        return corners > 0 ? (float)this->vertexCacheHits / (float)corners : 0.0f;
+    }
+
+    std::string toString() const
+    {
+        std::stringstream ss;
+        ss << "RenderStats(\n";
+        ss << "  nodesVisited: " << this->nodesVisited << "\n";
+        ss << "  nodesDrawn: " << this->nodesDrawn << "\n";
+        ss << "  nodesCulled: " << this->nodesCulled << "\n";
+        ss << "  subtreesCulled: " << this->subtreesCulled << "\n";
+        ss << "  trianglesDrawn: " << this->trianglesDrawn << "\n";
+        ss << "  trianglesCulled: " << this->trianglesCulled << "\n";
+        ss << "  trianglesClipped: " << this->trianglesClipped << "\n";
+        ss << "  trianglesOutside: " << this->trianglesOutside << "\n";
+        ss << "  drawCommands: " << this->drawCommands << "\n";
+        ss << "  binnedCommands: " << this->binnedCommands << "\n";
+        ss << "  vertexJobs: " << this->vertexJobs << "\n";
+        ss << "  projectionRebuilds: " << this->projectionRebuilds << "\n";
+        ss << "  viewRebuilds: " << this->viewRebuilds << "\n";
+        ss << "  verticesTransformed: " << this->verticesTransformed << "\n";
+        ss << "  vertexCacheHits: " << this->vertexCacheHits << "\n";
+        ss << "  vertexCacheHitRate: " << this->getVertexCacheHitRate() << "\n";
+        ss << "  vertexCacheBuilds: " << this->vertexCacheBuilds << "\n";
+        ss << "  nodesChanged: " << this->nodesChanged << "\n";
+        ss << "  tilesRedrawn: " << this->tilesRedrawn << "\n";
+        ss << "  arenaBytesUsed: " << this->arenaBytesUsed << "\n";
+        ss << "  arenaCapacity: " << this->arenaCapacity << "\n";
+        ss << "  arenaHeapAllocations: " << this->arenaHeapAllocations << "\n";
+        ss << ")";
+        return ss.str();
+    }
+};
+
+/// @brief The kinds of draws that are binned into screen tiles
+enum DrawCommandType
+{
+    DRAW_FILL,       // a depth tested, filled triangle
+    DRAW_LINE,       // a line, without a depth test
+    DRAW_LINE_DEPTH, // a depth tested line
+};
+
+/// @brief A fill or a line in texture space, recorded while the scene is traversed and drawn once it is binned
+struct DrawCommand
+{
+    Vec points[3]; // w holds 1/w -- lines only use the first 2
+    Color color;
+    DrawCommandType type;
+    int tileMinX, tileMinY, tileMaxX, tileMaxY; // the tiles that the command touches, inclusive
+};
+
 /// @brief The RASCII renderer
 /// @details This renderer renders the scene graph to a texture
 /// @details The texture is then rendered to the screen via a displayer
+/// @details Frames are incremental -- the output keeps the last frame, and only the screen tiles under the nodes that
+/// @details changed are drawn again, so that a static frame costs next to nothing; getDirtyRects() tells a display
+/// @details which parts of the output changed
 class RasciiRenderer : public IRenderer
 {
 public:
@@ -90,52 +220,166 @@ public:
 
     /// @brief Constructor
     /// @details Initializes the renderer to the given values
-    RasciiRenderer(RenderSettings settings) : _settings(settings)
+    RasciiRenderer(RenderSettings settings) : _settings(settings), _threadPool(settings.threadCount)
     {
         this->_outputPtr = std::make_shared<Texture>(settings.width, settings.height);
-        this->_textureDrawer = TextureDrawer(this->_outputPtr);
+        this->_depthPtr = std::make_shared<DepthBuffer>(settings.width, settings.height);
+        this->_textureDrawer = TextureDrawer(this->_outputPtr, this->_depthPtr);
+        this->_vertexOutputs.resize(this->_threadPool.getThreadCount());
+        this->_tilesX = (settings.width + TILE_WIDTH - 1) / TILE_WIDTH;
+        this->_tilesY = (settings.height + TILE_HEIGHT - 1) / TILE_HEIGHT;
+        this->_dirtyTiles.resize(this->_tilesX * this->_tilesY);
     }
 
     /// @brief Renders the given scene graph to the output
+    /// @details All of the transient data of the frame comes from the frame arena, which is reset in prepare()
+    /// @details The scene graph is traversed through a flattened copy, which is only rebuilt when its structure changes
+    /// @details Everything is drawn again when the structure or the view changed; otherwise only the tiles that the
+    /// @details changed nodes covered in the last frame, or cover now, are cleared and drawn again
     void render(const SceneGraph &sceneGraph)
     {
-        // fill the texture with black
-        this->_textureDrawer.fill(Color::greyscale(0.0f));
-        for (auto node : sceneGraph)
+        this->_vertexNodes.clear();
+        this->_transformJobs.clear();
+        this->_triangleJobs.clear();
+
+        // follow the authoring tree -- rebuilds the flattened arrays only when the structure changed, and updates
+        // the world matrices and bounds of the nodes that moved in two linear sweeps
+        bool rebuilt = this->_flatGraph.update(sceneGraph);
+        // the camera may have moved since prepare()
+        this->updateMatrices();
+
+        const FlatSceneGraph &flat = this->_flatGraph;
+        const size_t nodeCount = flat.size();
+        const bool redrawAll = this->_redrawAll || rebuilt || this->_footprints.size() != nodeCount;
+        this->_redrawAll = false;
+        if (redrawAll)
         {
-            if (node == nullptr || node->renderInfo.mesh == nullptr)
+            // fill the texture with black
+            this->_textureDrawer.fill(Color::greyscale(0.0f));
+            if (this->_settings.renderMode != RENDER_WIREFRAME)
             {
-                // std::cout << "Skipping node" << std::endl;
-                continue;
+                this->_depthPtr->clear();
             }
+            std::fill(this->_dirtyTiles.begin(), this->_dirtyTiles.end(), 1);
+            // every footprint is rebuilt by the traversal -- the nodes that it culls cover nothing
+            this->_footprints.resize(nodeCount);
+            for (size_t i = 0; i < nodeCount; i++)
+            {
+                this->_footprints[i] = NodeFootprint(*flat.renderInfos[i]);
+            }
+        }
+        else if (!this->markChangedNodes())
+        {
+            // nothing on screen changed, so the last frame stands
+            this->buildDirtyRects();
+            this->recordArenaStats();
+            return;
+        }
 
-            // std::cout << "Rendering node" << std::endl;
-            // std::cout << node->toString() << std::endl;
+        // walk the nodes in depth first order, culling whole subtrees against their merged bounds -- once a subtree is
+        // known to be entirely inside the frustum, nothing below it is tested again
+        size_t insideEnd = 0; // the nodes before this index are inside the frustum
+        size_t i = 0;
+        while (i < nodeCount)
+        {
+            this->_stats.nodesVisited++;
+            size_t subtreeEnd = (size_t)flat.subtreeEnds[i];
+
+            if (i >= insideEnd)
+            {
+                // the sphere of a leaf's mesh goes first -- it takes half the work of classifying the box, and a tightly
+                // fitted sphere rejects some meshes whose world box still pokes into a corner of the frustum
+                if (subtreeEnd == i + 1 && flat.renderInfos[i]->hasGeometry() && !this->_frustum.intersects(flat.spheres[i]))
+                {
+                    this->_stats.nodesCulled++;
+                    i++;
+                    continue;
+                }
 
-            Transform transform = node->transform;
-            Matrix transformationMatrix = node->toTransformationMatrix();
+                FrustumTest test = this->_frustum.classify(flat.subtreeBounds[i]);
+                if (test == FRUSTUM_OUTSIDE)
+                {
+                    this->_stats.nodesCulled += flat.subtreeGeometryCounts[i];
+                    if (subtreeEnd > i + 1)
+                    {
+                        this->_stats.subtreesCulled++;
+                    }
+                    i = subtreeEnd;
+                    continue;
+                }
+                if (test == FRUSTUM_INSIDE)
+                {
+                    insideEnd = subtreeEnd;
+                }
+            }
 
-            // transform the mesh
-            Mesh transformedMesh = node->renderInfo.mesh->transform(transformationMatrix);
+            const RenderInfo &renderInfo = *flat.renderInfos[i];
+            if (!renderInfo.hasGeometry())
+            {
+                i++;
+                continue;
+            }
 
-            for (auto &triangle : transformedMesh)
+            // the subtree test only covers the node's own mesh on its own when the node is a leaf
+            if (i >= insideEnd && subtreeEnd > i + 1 &&
+                (!this->_frustum.intersects(flat.spheres[i]) || !this->_frustum.intersects(flat.bounds[i])))
             {
-                // convert the triangle from world space to screen space
-                Vec v1 = this->worldToTexture(triangle.v1.position);
-                Vec v2 = this->worldToTexture(triangle.v2.position);
-                Vec v3 = this->worldToTexture(triangle.v3.position);
+                this->_stats.nodesCulled++;
+                i++;
+                continue;
+            }
 
-                // draw the triangle
-                this->_textureDrawer.drawTriangle(v1, v2, v3, Color::greyscale(1.0f));
+            // a node that covers no dirty tile has nothing to add to the tiles that are drawn again
+            NodeFootprint &footprint = this->_footprints[i];
+            if (redrawAll)
+            {
+                footprint.tiles = this->projectToTiles(flat.bounds[i]);
+            }
+            else if (!this->isDirty(footprint.tiles))
+            {
+                i++;
+                continue;
             }
+
+            this->queueNode(renderInfo, flat.worldMatrices[i]);
+            this->_stats.nodesDrawn++;
+            i++;
         }
+
+        // transform, project and clip the visible nodes, and record their draws -- spread over the threads
+        this->runVertexStage();
+
+        // everything that was recorded is drawn tile by tile, in parallel
+        this->rasterizeTiles(redrawAll);
+
+        this->buildDirtyRects();
+        this->recordArenaStats();
     }
 
     /// @brief Prepares the renderer for rendering
     /// @details This function is called before rendering
     void prepare()
     {
-        this->generateMatrices();
+        this->_frameStartHeapAllocations = this->_frameArena.getHeapAllocations();
+        this->_frameArena.reset();
+        this->_stats = RenderStats();
+        this->pruneVertexCache();
+        this->updateMatrices();
+    }
+
+    /// @brief Makes the next frame draw everything again
+    /// @details For when something else drew over the output, or to time full frames
+    void invalidate()
+    {
+        this->_redrawAll = true;
+    }
+
+    /// @brief Gets the parts of the output that changed in the last frame, in pixels
+    /// @details The whole output after a full redraw, and nothing at all when nothing on screen changed -- the
+    /// @details rectangles are whole tiles, and do not overlap
+    const std::vector<Rect> &getDirtyRects() const
+    {
+        return this->_dirtyRects;
     }
 
     /// @brief Cleanup output
@@ -152,57 +396,948 @@ public:
         return this->_outputPtr;
     }
 
+    /// @brief Gets the depth buffer -- only written in the solid render modes
+    std::shared_ptr<DepthBuffer> getDepthBuffer() const
+    {
+        return this->_depthPtr;
+    }
+
+    /// @brief Gets the statistics of the last frame
+    const RenderStats &getStats() const
+    {
+        return this->_stats;
+    }
+
+    /// @brief Sets the camera that the scene is seen from
+    /// @details The camera's projection parameters take the place of the fov and planes of the settings; it does not
+    /// @details have to be part of the rendered scene graph, but its children only move with it if it is
+    /// @param camera The camera, or nullptr for an eye at the origin, looking down -z
+    void setCamera(std::shared_ptr<Camera> camera)
+    {
+        this->_camera = camera;
+        this->_projectionDirty = true;
+    }
+
+    /// @brief Gets the camera that the scene is seen from -- nullptr for an eye at the origin
+    std::shared_ptr<Camera> getCamera() const
+    {
+        return this->_camera;
+    }
+
+    /// @brief Gets the view frustum that nodes are culled against
+    const Frustum &getFrustum() const
+    {
+        return this->_frustum;
+    }
+
+    /// @brief Gets the projection matrix, taking view space to clip space
+    const Matrix &getProjectionMatrix() const
+    {
+        return this->_projectionMatrix;
+    }
+
+    /// @brief Gets the viewport matrix, taking normalized screen positions to texture positions
+    const Matrix &getViewportMatrix() const
+    {
+        return this->_viewportMatrix;
+    }
+
+    /// @brief Gets the clipper that triangles are sent through before the perspective divide
+    const Clipper &getClipper() const
+    {
+        return this->_clipper;
+    }
+
+    /// @brief Gets the arena that the per-frame data is allocated from
+    const FrameArena &getFrameArena() const
+    {
+        return this->_frameArena;
+    }
+
 private:
+    // the size of the screen tiles, in characters -- a multiple of the 4 pixel rows that the raster kernels write at
+    // once, so that no write ever spans two tiles
+    static const int TILE_WIDTH = 32;
+    static const int TILE_HEIGHT = 16;
+    static_assert(TILE_WIDTH % 4 == 0, "raster kernels write 4 pixel groups that must not span two tiles");
+
+    // the range of flat shades in the solid render modes -- kept below the white of the wireframe
+    static constexpr float SHADE_MIN = 0.2f;
+    static constexpr float SHADE_MAX = 0.8f;
+
+    /// @brief A visible node, along with its buffers in the frame arena -- shared by every job of the node
+    struct VertexNode
+    {
+        Matrix clipMatrix;              // projection * view * world -- the only matrix each vertex goes through
+        const Mesh *mesh;               // either this,
+        const IndexedMesh *indexedMesh; // or this
+        CullMode cullMode;
+        // mesh buffers, one slot per triangle -- each job compacts the triangles it keeps into its own range
+        float *shades; // nullptr in the wireframe mode
+        // indexed mesh buffers, one slot per vertex
+        float *x, *y, *z, *w;
+        Vec *screen;
+        uint8_t *codes;
+        Vec *clip; // 3 slots per triangle for a mesh, 1 slot per vertex for an indexed mesh
+    };
+
+    /// @brief What a node covered on screen in the last frame, and the geometry that it was drawn with
+    struct NodeFootprint
+    {
+        Rect tiles;           // in tiles -- empty when the node was not drawn
+        const void *geometry; // the mesh or the indexed mesh
+        uint64_t meshVersion; // the version of the mesh or the indexed mesh
+        CullMode cullMode;
+
+        NodeFootprint() : geometry(nullptr), meshVersion(0), cullMode(CULL_BACK) {}
+        NodeFootprint(const RenderInfo &renderInfo)
+            : geometry(renderInfo.indexedMesh != nullptr ? (const void *)renderInfo.indexedMesh.get() : (const void *)renderInfo.mesh.get()),
+              meshVersion(renderInfo.indexedMesh != nullptr ? renderInfo.indexedMesh->getVersion()
+                          : renderInfo.mesh != nullptr      ? renderInfo.mesh->getVersion()
+                                                            : 0),
+              cullMode(renderInfo.cullMode) {}
+
+        /// @brief Returns true if the node would be drawn the same way, given the same world matrix
+        bool sameGeometry(const NodeFootprint &footprint) const
+        {
+            return this->geometry == footprint.geometry && this->meshVersion == footprint.meshVersion &&
+                   this->cullMode == footprint.cullMode;
+        }
+    };
+
+    /// @brief The indexed copy of a mesh that the vertex cache draws in its place
+    struct CachedMesh
+    {
+        std::weak_ptr<Mesh> mesh;             // expires with the mesh, so that a new mesh at the same address is not mistaken for it
+        uint64_t version;                     // the version of the mesh that the copy was built from
+        std::shared_ptr<IndexedMesh> indexed; // nullptr when the mesh shares too few vertices to be worth indexing
+    };
+
+    /// @brief A range of the work of one node -- large meshes are split into several, so that they spread over threads
+    struct VertexJob
+    {
+        int node;
+        size_t first, count; // the vertices of a transform job, or the triangles of a triangle job
+        // where a triangle job recorded its commands -- filled in by the thread that ran it
+        int thread;
+        size_t commandBegin, commandEnd;
+    };
+
+    /// @brief What one thread of the vertex stage produced -- padded to a cache line, so that threads do not share one
+    struct alignas(64) VertexOutput
+    {
+        std::vector<DrawCommand> commands; // reused between frames
+        RenderStats stats;                 // only the triangle counts
+    };
+
+    // the largest ranges that the vertex stage splits meshes into -- multiples of 8, so that a range only ever ends
+    // in the tail of the transform kernels where the mesh does
+    static constexpr size_t VERTEX_JOB_SIZE = 4096;
+    static constexpr size_t TRIANGLE_JOB_SIZE = 1024;
+
     std::shared_ptr<Texture> _outputPtr;
+    std::shared_ptr<DepthBuffer> _depthPtr; // alongside the output, cleared in prepare()
     TextureDrawer _textureDrawer;
     RenderSettings _settings;
 
+    // rebuilt in prepare(), only when they are dirty
     Matrix _projectionMatrix;
-    Matrix _viewMatrix;
-    Matrix _pvMatrix; // projection * view
+    Matrix _viewportMatrix; // normalized screen positions to texture positions -- only scales and offsets x and y
+    Matrix _pvMatrix;       // projection * view -- fused with the world matrix of each node
+    Vec _viewScale;         // undoes the projection of x, y and w -- see clipToView()
+    Frustum _viewFrustum;   // in view space -- the camera sits at the origin, looking down -z
+    Frustum _frustum;       // in world space
+    bool _projectionDirty = true;
+    bool _viewDirty = true;
+    // the camera that the scene is seen from, or nullptr for an eye at the origin -- and the versions of it that the
+    // cached matrices were built from
+    std::shared_ptr<Camera> _camera;
+    uint64_t _cameraProjectionVersion = 0;
+    Matrix _cameraWorld;
+    Clipper _clipper; // in clip space
+
+    // every transient, per-frame buffer comes from here -- reset in prepare()
+    FrameArena _frameArena;
+    size_t _frameStartHeapAllocations = 0;
+    // flattened copy of the last rendered scene graph -- reused between frames, so that the traversal does not allocate
+    FlatSceneGraph _flatGraph;
+    RenderStats _stats;
+    ThreadPool _threadPool;
+    // the vertex stage of the frame -- reused between frames
+    std::vector<VertexNode> _vertexNodes;
+    std::vector<VertexJob> _transformJobs; // vertex ranges of the indexed meshes, run before any triangle job
+    std::vector<VertexJob> _triangleJobs;  // in the order of the traversal, which is the order that the tiles draw in
+    std::vector<VertexOutput> _vertexOutputs; // one per thread of the pool
+    // indexed copies of the meshes that were drawn, by mesh -- kept between frames, and rebuilt when a mesh is edited
+    std::unordered_map<const Mesh *, CachedMesh> _vertexCache;
+    // the incremental frames -- what each node of the flat graph covered, and the tiles that have to be drawn again
+    bool _redrawAll = true;
+    std::vector<NodeFootprint> _footprints;
+    int _tilesX = 0, _tilesY = 0;
+    std::vector<uint8_t> _dirtyTiles;
+    std::vector<Rect> _dirtyRects;
+
+    /// @brief Compares every node against its footprint, and marks the tiles under the nodes that changed as dirty
+    /// @details Both the tiles that a node covered and the tiles that it covers now are dirty -- the first are uncovered,
+    /// @details the second are drawn over
+    /// @return True if any tile is dirty
+    bool markChangedNodes()
+    {
+        std::fill(this->_dirtyTiles.begin(), this->_dirtyTiles.end(), 0);
+        const FlatSceneGraph &flat = this->_flatGraph;
+        bool dirty = false;
+        for (size_t i = 0; i < flat.size(); i++)
+        {
+            const RenderInfo &renderInfo = *flat.renderInfos[i];
+            NodeFootprint &footprint = this->_footprints[i];
+            NodeFootprint current(renderInfo);
+            if (!flat.hasChanged(i) && current.sameGeometry(footprint))
+            {
+                continue;
+            }
+            if (!renderInfo.hasGeometry() && footprint.geometry == nullptr)
+            {
+                continue;
+            }
 
-    /// @brief Converts the given world position to a normalized screen position (-1,-1) to (1,1)
-    /// @param worldPos
-    /// @return The normalized screen position
-    Vec worldToScreen(const Vec &worldPos)
+            current.tiles = renderInfo.hasGeometry() ? this->projectToTiles(flat.bounds[i]) : Rect();
+            dirty = this->markTiles(footprint.tiles) || dirty;
+            dirty = this->markTiles(current.tiles) || dirty;
+            footprint = current;
+            this->_stats.nodesChanged++;
+        }
+        return dirty;
+    }
+
+    /// @brief Marks the given tiles as dirty
+    /// @return True if there was any tile to mark
+    bool markTiles(const Rect &tiles)
     {
-        return this->_projectionMatrix * worldPos;
+        for (int ty = tiles.minY; ty < tiles.maxY; ty++)
+        {
+            uint8_t *row = this->_dirtyTiles.data() + ty * this->_tilesX;
+            std::fill(row + tiles.minX, row + tiles.maxX, 1);
+        }
+        return !tiles.isEmpty();
     }
 
-    /// @brief Converts the given screen position to a texture position
-    /// @param screenPos The screen position
-    /// @return The texture position
-    Vec screenToTexture(Vec screenPos)
+    /// @brief Returns true if any of the given tiles is dirty
+    bool isDirty(const Rect &tiles) const
+    {
+        for (int ty = tiles.minY; ty < tiles.maxY; ty++)
+        {
+            for (int tx = tiles.minX; tx < tiles.maxX; tx++)
+            {
+                if (this->_dirtyTiles[ty * this->_tilesX + tx] != 0)
+                {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    /// @brief Returns the tiles that anything inside the given world space bounds can be drawn to
+    /// @details The corners of the box are projected, with a pixel of margin for the rounding of the rasterizers; a box
+    /// @details with a corner at or behind the eye can be drawn anywhere
+    Rect projectToTiles(const AABB &bounds) const
+    {
+        if (bounds.isEmpty())
+        {
+            return Rect();
+        }
+
+        const Rect allTiles(0, 0, this->_tilesX, this->_tilesY);
+        float minX = std::numeric_limits<float>::max(), minY = std::numeric_limits<float>::max();
+        float maxX = -std::numeric_limits<float>::max(), maxY = -std::numeric_limits<float>::max();
+        for (int corner = 0; corner < 8; corner++)
+        {
+            Vec point((corner & 1) != 0 ? bounds.max.x : bounds.min.x, (corner & 2) != 0 ? bounds.max.y : bounds.min.y,
+                      (corner & 4) != 0 ? bounds.max.z : bounds.min.z, 1.0f);
+            Vec clip = this->_pvMatrix * point;
+            if (!(clip.w > 0.0f))
+            {
+                return allTiles;
+            }
+            Vec texture = this->clipToTexture(clip);
+            if (std::isnan(texture.x) || std::isnan(texture.y))
+            {
+                return allTiles;
+            }
+            minX = std::min(minX, texture.x);
+            maxX = std::max(maxX, texture.x);
+            minY = std::min(minY, texture.y);
+            maxY = std::max(maxY, texture.y);
+        }
+
+        // clamped before the conversion, so that boxes far off screen do not overflow
+        const int width = this->_settings.width, height = this->_settings.height;
+        auto toPixel = [](float value, int size)
+        {
+            return (int)std::floor(std::min(std::max(value, -2.0f), (float)size + 2.0f));
+        };
+        int pixelMinX = std::max(toPixel(minX, width) - 1, 0), pixelMaxX = std::min(toPixel(maxX, width) + 2, width);
+        int pixelMinY = std::max(toPixel(minY, height) - 1, 0), pixelMaxY = std::min(toPixel(maxY, height) + 2, height);
+        if (pixelMaxX <= pixelMinX || pixelMaxY <= pixelMinY)
+        {
+            return Rect();
+        }
+        return Rect(pixelMinX / TILE_WIDTH, pixelMinY / TILE_HEIGHT, (pixelMaxX - 1) / TILE_WIDTH + 1,
+                    (pixelMaxY - 1) / TILE_HEIGHT + 1);
+    }
+
+    /// @brief Turns the dirty tiles into rectangles of pixels
+    /// @details Runs of dirty tiles along a row become one rectangle, which grows down while the rows below have the
+    /// @details same run
+    void buildDirtyRects()
+    {
+        this->_dirtyRects.clear();
+        const int width = this->_settings.width, height = this->_settings.height;
+        for (int ty = 0; ty < this->_tilesY; ty++)
+        {
+            const int minY = ty * TILE_HEIGHT, maxY = std::min(height, (ty + 1) * TILE_HEIGHT);
+            int tx = 0;
+            while (tx < this->_tilesX)
+            {
+                if (this->_dirtyTiles[ty * this->_tilesX + tx] == 0)
+                {
+                    tx++;
+                    continue;
+                }
+                int runEnd = tx;
+                while (runEnd < this->_tilesX && this->_dirtyTiles[ty * this->_tilesX + runEnd] != 0)
+                {
+                    runEnd++;
+                }
+                const int minX = tx * TILE_WIDTH, maxX = std::min(width, runEnd * TILE_WIDTH);
+                tx = runEnd;
+
+                // there are only ever a few rectangles, so the one right above is found by a search
+                bool grown = false;
+                for (Rect &rect : this->_dirtyRects)
+                {
+                    if (rect.maxY == minY && rect.minX == minX && rect.maxX == maxX)
+                    {
+                        rect.maxY = maxY;
+                        grown = true;
+                        break;
+                    }
+                }
+                if (!grown)
+                {
+                    this->_dirtyRects.push_back(Rect(minX, minY, maxX, maxY));
+                }
+            }
+        }
+    }
+
+    /// @brief Copies the usage of the frame arena into the statistics
+    void recordArenaStats()
+    {
+        this->_stats.arenaBytesUsed = this->_frameArena.getBytesUsed();
+        this->_stats.arenaCapacity = this->_frameArena.getCapacity();
+        this->_stats.arenaHeapAllocations = this->_frameArena.getHeapAllocations() - this->_frameStartHeapAllocations;
+    }
+
+    /// @brief Allocates the buffers of a visible node, and splits its work into jobs of the vertex stage
+    /// @param renderInfo The geometry of the node
+    /// @param worldMatrix The world matrix of the node
+    void queueNode(const RenderInfo &renderInfo, const Matrix &worldMatrix)
+    {
+        VertexNode node = {};
+        node.clipMatrix = this->_pvMatrix * worldMatrix;
+        node.cullMode = renderInfo.cullMode;
+        const int nodeIndex = (int)this->_vertexNodes.size();
+
+        // meshes that share vertices are drawn through their indexed copy, where each vertex is transformed once
+        const IndexedMesh *indexedMesh = renderInfo.indexedMesh.get();
+        if (indexedMesh == nullptr && this->_settings.vertexCache)
+        {
+            indexedMesh = this->getCachedMesh(renderInfo.mesh);
+        }
+
+        size_t triangleCount;
+        if (indexedMesh != nullptr)
+        {
+            const IndexedMesh &mesh = *indexedMesh;
+            size_t vertexCount = mesh.getVertexCount();
+            if (vertexCount == 0)
+            {
+                return;
+            }
+            node.indexedMesh = &mesh;
+            node.x = this->_frameArena.allocate<float>(vertexCount);
+            node.y = this->_frameArena.allocate<float>(vertexCount);
+            node.z = this->_frameArena.allocate<float>(vertexCount);
+            node.w = this->_frameArena.allocate<float>(vertexCount);
+            node.clip = this->_frameArena.allocate<Vec>(vertexCount);
+            node.screen = this->_frameArena.allocate<Vec>(vertexCount);
+            node.codes = this->_frameArena.allocate<uint8_t>(vertexCount);
+            for (size_t first = 0; first < vertexCount; first += VERTEX_JOB_SIZE)
+            {
+                this->_transformJobs.push_back({nodeIndex, first, std::min(VERTEX_JOB_SIZE, vertexCount - first), 0, 0, 0});
+            }
+            triangleCount = (size_t)mesh.getTriangleCount();
+            this->_stats.verticesTransformed += (int)vertexCount;
+            this->_stats.vertexCacheHits += (int)(triangleCount * 3 - std::min(triangleCount * 3, vertexCount));
+        }
+        else
+        {
+            const Mesh &mesh = *renderInfo.mesh;
+            triangleCount = mesh.triangles.size();
+            if (triangleCount == 0)
+            {
+                return;
+            }
+            node.mesh = &mesh;
+            node.clip = this->_frameArena.allocate<Vec>(triangleCount * 3);
+            this->_stats.verticesTransformed += (int)(triangleCount * 3);
+            if (this->_settings.renderMode != RENDER_WIREFRAME)
+            {
+                node.shades = this->_frameArena.allocate<float>(triangleCount);
+            }
+        }
+
+        for (size_t first = 0; first < triangleCount; first += TRIANGLE_JOB_SIZE)
+        {
+            this->_triangleJobs.push_back({nodeIndex, first, std::min(TRIANGLE_JOB_SIZE, triangleCount - first), 0, 0, 0});
+        }
+        this->_vertexNodes.push_back(node);
+    }
+
+    /// @brief Returns the indexed copy of a mesh that the vertex cache draws in its place, building it when needed
+    /// @details The copy merges corners by position alone -- the renderer shades from the positions, not the normals
+    /// @param mesh The mesh
+    /// @return The copy, or nullptr to draw the mesh as it is
+    const IndexedMesh *getCachedMesh(const std::shared_ptr<Mesh> &mesh)
+    {
+        CachedMesh &cached = this->_vertexCache[mesh.get()];
+        if (!cached.mesh.expired() && cached.version == mesh->getVersion())
+        {
+            return cached.indexed.get();
+        }
+
+        cached.mesh = mesh;
+        cached.version = mesh->getVersion();
+        auto indexed = std::make_shared<IndexedMesh>(IndexedMesh::fromMesh(*mesh, true));
+        // a mesh that barely shares its vertices costs more to index than it saves -- 3/4 keeps a quad indexed, and
+        // leaves a triangle soup as it is
+        size_t cornerCount = mesh->triangles.size() * 3;
+        cached.indexed = (size_t)indexed->getVertexCount() * 4 <= cornerCount * 3 ? indexed : nullptr;
+        this->_stats.vertexCacheBuilds++;
+        return cached.indexed.get();
+    }
+
+    /// @brief Forgets the indexed copies of the meshes that no longer exist
+    void pruneVertexCache()
+    {
+        for (auto it = this->_vertexCache.begin(); it != this->_vertexCache.end();)
+        {
+            it = it->second.mesh.expired() ? this->_vertexCache.erase(it) : std::next(it);
+        }
+    }
+
+    /// @brief Runs the queued jobs of the vertex stage -- the transforms of the indexed meshes, then every triangle
+    /// @details Each thread records into its own output, and each job remembers where its commands went, so the tiles
+    /// @details see the commands in the order of the jobs -- the frame does not depend on which thread ran which job
+    void runVertexStage()
+    {
+        for (VertexOutput &output : this->_vertexOutputs)
+        {
+            output.commands.clear();
+            output.stats = RenderStats();
+        }
+        const int threadLimit = this->_settings.vertexThreadCount;
+
+        auto transformJob = [&](int index, int)
+        {
+            const VertexJob &job = this->_transformJobs[index];
+            this->transformIndexedVertices(this->_vertexNodes[job.node], job.first, job.count);
+        };
+        this->_threadPool.parallelFor((int)this->_transformJobs.size(), transformJob, threadLimit);
+
+        auto triangleJob = [&](int index, int threadIndex)
+        {
+            VertexJob &job = this->_triangleJobs[index];
+            VertexOutput &output = this->_vertexOutputs[threadIndex];
+            const VertexNode &node = this->_vertexNodes[job.node];
+            job.thread = threadIndex;
+            job.commandBegin = output.commands.size();
+            if (node.indexedMesh != nullptr)
+            {
+                this->drawIndexedTriangles(node, job.first, job.count, output);
+            }
+            else
+            {
+                this->drawMeshTriangles(node, job.first, job.count, output);
+            }
+            job.commandEnd = output.commands.size();
+        };
+        this->_threadPool.parallelFor((int)this->_triangleJobs.size(), triangleJob, threadLimit);
+
+        for (const VertexOutput &output : this->_vertexOutputs)
+        {
+            this->_stats.trianglesDrawn += output.stats.trianglesDrawn;
+            this->_stats.trianglesCulled += output.stats.trianglesCulled;
+            this->_stats.trianglesClipped += output.stats.trianglesClipped;
+            this->_stats.trianglesOutside += output.stats.trianglesOutside;
+        }
+        this->_stats.vertexJobs = (int)(this->_transformJobs.size() + this->_triangleJobs.size());
+    }
+
+    /// @brief Projects, culls and draws a range of the triangles of a mesh
+    /// @details The corners go straight from model space to clip space, through the fused matrix of the node -- culling
+    /// @details and shading work on view space corners, which the projection only scales
+    /// @param node The node of the mesh
+    /// @param first The first triangle of the range
+    /// @param count The number of triangles in the range
+    /// @param output Where the commands and the counts go
+    void drawMeshTriangles(const VertexNode &node, size_t first, size_t count, VertexOutput &output) const
+    {
+        // positions and normals are interleaved, so the positions have a stride of 2 Vecs
+        Vec *clip = node.clip + first * 3;
+        node.clipMatrix.transformPoints(&node.mesh->triangles[first].v1.position, clip, count * 3, 2, 1);
+
+        // compact the triangles that survive culling in place, and shade them
+        const bool shaded = node.shades != nullptr;
+        float *shades = shaded ? node.shades + first : nullptr;
+        size_t keptCount = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            const Vec *corners = &clip[i * 3];
+            if (node.cullMode != CULL_NONE || shaded)
+            {
+                Vec p1 = this->clipToView(corners[0]), p2 = this->clipToView(corners[1]), p3 = this->clipToView(corners[2]);
+                if (RasciiRenderer::isCulled(p1.x, p1.y, p1.z, p2.x, p2.y, p2.z, p3.x, p3.y, p3.z, node.cullMode))
+                {
+                    continue;
+                }
+                if (shaded)
+                {
+                    shades[keptCount] = RasciiRenderer::shade(p1.x, p1.y, p1.z, p2.x, p2.y, p2.z, p3.x, p3.y, p3.z);
+                }
+            }
+            if (keptCount != i)
+            {
+                std::copy(corners, corners + 3, &clip[keptCount * 3]);
+            }
+            keptCount++;
+        }
+        output.stats.trianglesCulled += (int)(count - keptCount);
+
+        for (size_t i = 0; i < keptCount; i++)
+        {
+            const Vec *corners = &clip[i * 3];
+            uint8_t codes[3] = {this->_clipper.outcode(corners[0]), this->_clipper.outcode(corners[1]), this->_clipper.outcode(corners[2])};
+            this->drawClipTriangle(corners, codes, nullptr, shaded ? shades[i] : 1.0f, output);
+        }
+    }
+
+    /// @brief Projects a range of the vertices of an indexed mesh, in one batch, through the fused matrix of the node
+    /// @details Only the vertices that can be rasterized without clipping are divided; the x/y/z streams are left with
+    /// @details the view space positions when the triangles are culled or shaded
+    /// @param node The node of the mesh
+    /// @param first The first vertex of the range
+    /// @param count The number of vertices in the range
+    void transformIndexedVertices(const VertexNode &node, size_t first, size_t count) const
+    {
+        float *x = node.x + first, *y = node.y + first, *z = node.z + first, *w = node.w + first;
+        node.indexedMesh->transformPositions(node.clipMatrix, x, y, z, w, first, count);
+
+        Vec *clip = node.clip + first;
+        Vec *screen = node.screen + first;
+        uint8_t *codes = node.codes + first;
+        for (size_t i = 0; i < count; i++)
+        {
+            clip[i] = Vec(x[i], y[i], z[i], w[i]);
+            codes[i] = this->_clipper.outcode(clip[i]);
+            if ((codes[i] & CLIP_MUST_CLIP) == 0)
+            {
+                screen[i] = this->clipToTexture(clip[i]);
+            }
+        }
+
+        if (node.cullMode != CULL_NONE || this->_settings.renderMode != RENDER_WIREFRAME)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                Vec view = this->clipToView(clip[i]);
+                x[i] = view.x;
+                y[i] = view.y;
+                z[i] = view.z;
+            }
+        }
+    }
+
+    /// @brief Culls and draws a range of the triangles of an indexed mesh, once all of its vertices are transformed
+    /// @details The vertices are shared between triangles, so they are all projected -- culled triangles skip the raster
+    /// @details The x/y/z streams of the node hold view space positions here, for culling and shading
+    /// @param node The node of the mesh
+    /// @param first The first triangle of the range
+    /// @param count The number of triangles in the range
+    /// @param output Where the commands and the counts go
+    void drawIndexedTriangles(const VertexNode &node, size_t first, size_t count, VertexOutput &output) const
+    {
+        const float *x = node.x, *y = node.y, *z = node.z;
+        const bool shaded = this->_settings.renderMode != RENDER_WIREFRAME;
+        const uint32_t *indices = node.indexedMesh->indices.data();
+        for (size_t i = first; i < first + count; i++)
+        {
+            uint32_t i1 = indices[i * 3], i2 = indices[i * 3 + 1], i3 = indices[i * 3 + 2];
+            if (RasciiRenderer::isCulled(x[i1], y[i1], z[i1], x[i2], y[i2], z[i2], x[i3], y[i3], z[i3], node.cullMode))
+            {
+                output.stats.trianglesCulled++;
+                continue;
+            }
+            const Vec corners[3] = {node.clip[i1], node.clip[i2], node.clip[i3]};
+            const uint8_t cornerCodes[3] = {node.codes[i1], node.codes[i2], node.codes[i3]};
+            const Vec cornerScreen[3] = {node.screen[i1], node.screen[i2], node.screen[i3]};
+            float shade = shaded ? RasciiRenderer::shade(x[i1], y[i1], z[i1], x[i2], y[i2], z[i2], x[i3], y[i3], z[i3]) : 1.0f;
+            this->drawClipTriangle(corners, cornerCodes, cornerScreen, shade, output);
+        }
+    }
+
+    /// @brief The clip stage -- rejects, clips, divides and draws one projected triangle
+    /// @details Triangles entirely outside of one side of the view are rejected by their outcodes; triangles that cross
+    /// @details the near or far plane, or leave the guard band, are clipped in clip space before the divide; everything
+    /// @details else is drawn as is, with the parts between the screen and the guard band skipped by the raster
+    /// @param corners The 3 clip space corners
+    /// @param codes The outcodes of the corners
+    /// @param screen The 3 corners in texture space, or nullptr to divide them here -- unused if the triangle is clipped
+    /// @param shade The brightness of the triangle, in the solid render modes
+    /// @param output Where the commands and the counts go
+    void drawClipTriangle(const Vec *corners, const uint8_t *codes, const Vec *screen, float shade, VertexOutput &output) const
     {
-        // ensure that the w component is 1
-        screenPos.w = 1.0f;
-        return this->_viewMatrix * screenPos;
+        if ((codes[0] & codes[1] & codes[2]) != 0)
+        {
+            output.stats.trianglesOutside++;
+            return;
+        }
+
+        if (((codes[0] | codes[1] | codes[2]) & CLIP_MUST_CLIP) == 0)
+        {
+            Vec points[3];
+            for (int i = 0; i < 3; i++)
+            {
+                points[i] = screen != nullptr ? screen[i] : this->clipToTexture(corners[i]);
+            }
+            this->rasterizePolygon(points, 3, nullptr, shade, output);
+            output.stats.trianglesDrawn++;
+            return;
+        }
+
+        Vec polygon[CLIP_MAX_VERTICES];
+        bool edgeFlags[CLIP_MAX_VERTICES];
+        int count = this->_clipper.clipTriangle(corners, codes, polygon, edgeFlags);
+        output.stats.trianglesClipped++;
+        if (count < 3)
+        {
+            output.stats.trianglesOutside++;
+            return;
+        }
+
+        for (int i = 0; i < count; i++)
+        {
+            polygon[i] = this->clipToTexture(polygon[i]);
+        }
+        this->rasterizePolygon(polygon, count, edgeFlags, shade, output);
+        output.stats.trianglesDrawn++;
+    }
+
+    /// @brief Draws a convex polygon in texture space, the way the render mode asks for
+    /// @details Solid polygons are filled as a fan; only the edges whose flag is set are part of the wireframe -- the
+    /// @details others run along a clip plane
+    /// @param points The corners, in order -- w holds 1/w
+    /// @param count The number of corners
+    /// @param edgeFlags Whether the edge from each corner to the next is drawn, or nullptr to draw every edge
+    /// @param shade The brightness of the polygon, in the solid render modes
+    /// @param output Where the commands go
+    void rasterizePolygon(const Vec *points, int count, const bool *edgeFlags, float shade, VertexOutput &output) const
+    {
+        const RenderMode mode = this->_settings.renderMode;
+        const Color lineColor = Color::greyscale(1.0f);
+        if (mode != RENDER_WIREFRAME)
+        {
+            const Color fillColor = Color::greyscale(shade);
+            for (int i = 1; i + 1 < count; i++)
+            {
+                this->recordCommand(DRAW_FILL, points[0], points[i], &points[i + 1], fillColor, output);
+            }
+        }
+        if (mode == RENDER_SOLID)
+        {
+            return;
+        }
+
+        for (int i = 0; i < count; i++)
+        {
+            if (edgeFlags != nullptr && !edgeFlags[i])
+            {
+                continue;
+            }
+            const Vec &next = points[(i + 1) % count];
+            this->recordCommand(mode == RENDER_WIREFRAME ? DRAW_LINE : DRAW_LINE_DEPTH, points[i], next, nullptr, lineColor, output);
+        }
+    }
+
+    /// @brief Records a fill or a line, along with the tiles that its bounds touch
+    /// @details Commands that are entirely off the texture are dropped
+    /// @param p3 The third corner of a fill, or nullptr for a line
+    /// @param output Where the command goes
+    void recordCommand(DrawCommandType type, const Vec &p1, const Vec &p2, const Vec *p3, const Color &color, VertexOutput &output) const
+    {
+        float minX = std::min(p1.x, p2.x), maxX = std::max(p1.x, p2.x);
+        float minY = std::min(p1.y, p2.y), maxY = std::max(p1.y, p2.y);
+        if (p3 != nullptr)
+        {
+            minX = std::min(minX, p3->x);
+            maxX = std::max(maxX, p3->x);
+            minY = std::min(minY, p3->y);
+            maxY = std::max(maxY, p3->y);
+        }
+        const float width = (float)this->_settings.width, height = (float)this->_settings.height;
+        // written so that NaN fails too
+        if (!(maxX >= 0.0f && maxY >= 0.0f && minX < width && minY < height))
+        {
+            return;
+        }
+
+        DrawCommand command;
+        command.points[0] = p1;
+        command.points[1] = p2;
+        command.points[2] = p3 != nullptr ? *p3 : p2;
+        command.color = color;
+        command.type = type;
+        command.tileMinX = (int)std::max(minX, 0.0f) / TILE_WIDTH;
+        command.tileMinY = (int)std::max(minY, 0.0f) / TILE_HEIGHT;
+        command.tileMaxX = (int)std::min(maxX, width - 1.0f) / TILE_WIDTH;
+        command.tileMaxY = (int)std::min(maxY, height - 1.0f) / TILE_HEIGHT;
+        output.commands.push_back(command);
+    }
+
+    /// @brief Bins the recorded commands into the dirty screen tiles, and draws those tiles in parallel
+    /// @details Each tile is drawn by one thread, through a scissor, so no two threads ever touch the same pixel; the
+    /// @details commands of a tile are drawn in the order of the jobs that recorded them, so the frame does not depend on
+    /// @details the number of threads
+    /// @param cleared True if the whole output was cleared already -- otherwise each dirty tile is cleared before it is
+    /// drawn, even if no command touches it
+    void rasterizeTiles(bool cleared)
+    {
+        size_t commandCount = 0;
+        for (const VertexJob &job : this->_triangleJobs)
+        {
+            commandCount += job.commandEnd - job.commandBegin;
+        }
+        this->_stats.drawCommands = (int)commandCount;
+
+        const int width = this->_settings.width, height = this->_settings.height;
+        const int tilesX = this->_tilesX;
+        const int tileCount = this->_tilesX * this->_tilesY;
+        const uint8_t *dirtyTiles = this->_dirtyTiles.data();
+
+        // the tiles that are drawn again
+        int *tiles = this->_frameArena.allocate<int>(tileCount);
+        int dirtyCount = 0;
+        for (int tile = 0; tile < tileCount; tile++)
+        {
+            if (dirtyTiles[tile] != 0)
+            {
+                tiles[dirtyCount++] = tile;
+            }
+        }
+        this->_stats.tilesRedrawn = dirtyCount;
+        if (dirtyCount == 0 || (commandCount == 0 && cleared))
+        {
+            return;
+        }
+
+        // counting sort into the bins of the dirty tiles -- count, prefix sum, scatter
+        int *binStarts = this->_frameArena.allocate<int>(tileCount + 1);
+        int *binEnds = this->_frameArena.allocate<int>(tileCount);
+        std::fill(binStarts, binStarts + tileCount + 1, 0);
+        for (const VertexJob &job : this->_triangleJobs)
+        {
+            const std::vector<DrawCommand> &commands = this->_vertexOutputs[job.thread].commands;
+            for (size_t i = job.commandBegin; i < job.commandEnd; i++)
+            {
+                const DrawCommand &command = commands[i];
+                for (int ty = command.tileMinY; ty <= command.tileMaxY; ty++)
+                {
+                    for (int tx = command.tileMinX; tx <= command.tileMaxX; tx++)
+                    {
+                        binStarts[ty * tilesX + tx + 1] += dirtyTiles[ty * tilesX + tx];
+                    }
+                }
+            }
+        }
+        for (int tile = 0; tile < tileCount; tile++)
+        {
+            binStarts[tile + 1] += binStarts[tile];
+            binEnds[tile] = binStarts[tile];
+        }
+        this->_stats.binnedCommands = binStarts[tileCount];
+
+        const DrawCommand **binEntries = this->_frameArena.allocate<const DrawCommand *>(binStarts[tileCount]);
+        for (const VertexJob &job : this->_triangleJobs)
+        {
+            const std::vector<DrawCommand> &commands = this->_vertexOutputs[job.thread].commands;
+            for (size_t i = job.commandBegin; i < job.commandEnd; i++)
+            {
+                const DrawCommand &command = commands[i];
+                for (int ty = command.tileMinY; ty <= command.tileMaxY; ty++)
+                {
+                    for (int tx = command.tileMinX; tx <= command.tileMaxX; tx++)
+                    {
+                        if (dirtyTiles[ty * tilesX + tx] != 0)
+                        {
+                            binEntries[binEnds[ty * tilesX + tx]++] = &command;
+                        }
+                    }
+                }
+            }
+        }
+
+        const bool depthTested = this->_settings.renderMode != RENDER_WIREFRAME;
+        auto rasterizeTile = [&](int index, int)
+        {
+            int tile = tiles[index];
+            int tx = tile % tilesX, ty = tile / tilesX;
+            Rect rect(tx * TILE_WIDTH, ty * TILE_HEIGHT, std::min(width, (tx + 1) * TILE_WIDTH), std::min(height, (ty + 1) * TILE_HEIGHT));
+            if (!cleared)
+            {
+                this->_outputPtr->blank(Color::greyscale(0.0f), rect);
+                if (depthTested)
+                {
+                    this->_depthPtr->clear(rect);
+                }
+            }
+
+            TextureDrawer drawer(this->_outputPtr, this->_depthPtr);
+            drawer.setScissor(rect);
+            for (int k = binStarts[tile]; k < binStarts[tile + 1]; k++)
+            {
+                const DrawCommand &command = *binEntries[k];
+                switch (command.type)
+                {
+                case DRAW_FILL:
+                    drawer.fillTriangleDepth(command.points[0], command.points[1], command.points[2], command.color);
+                    break;
+                case DRAW_LINE:
+                    drawer.drawLine(command.points[0], command.points[1], command.color);
+                    break;
+                case DRAW_LINE_DEPTH:
+                    drawer.drawLineDepth(command.points[0], command.points[1], command.color);
+                    break;
+                }
+            }
+        };
+        this->_threadPool.parallelFor(dirtyCount, rasterizeTile);
+    }
+
+    /// @brief Returns the flat shade of the triangle with the given view space corners
+    /// @details Lit from the camera: from SHADE_MIN for triangles seen edge on, to SHADE_MAX for triangles seen head on
+    static float shade(float x1, float y1, float z1, float x2, float y2, float z2, float x3, float y3, float z3)
+    {
+        float ax = x2 - x1, ay = y2 - y1, az = z2 - z1;
+        float bx = x3 - x1, by = y3 - y1, bz = z3 - z1;
+        float nx = ay * bz - az * by;
+        float ny = az * bx - ax * bz;
+        float nz = ax * by - ay * bx;
+        float lengths = (nx * nx + ny * ny + nz * nz) * (x1 * x1 + y1 * y1 + z1 * z1);
+        if (!(lengths > 0.0f))
+        {
+            return SHADE_MIN;
+        }
+        float facing = std::fabs(nx * x1 + ny * y1 + nz * z1) / std::sqrt(lengths);
+        return SHADE_MIN + (SHADE_MAX - SHADE_MIN) * std::min(facing, 1.0f);
+    }
+
+    /// @brief Returns true if the given cull mode discards the triangle with the given view space corners
+    /// @details The camera sits at the origin of view space, so a triangle is front facing (clockwise on screen) when its
+    /// @details normal points away from the camera -- triangles seen exactly edge on are discarded by both CULL_BACK and
+    /// @details CULL_FRONT
+    static bool isCulled(float x1, float y1, float z1, float x2, float y2, float z2, float x3, float y3, float z3, CullMode cullMode)
+    {
+        if (cullMode == CULL_NONE)
+        {
+            return false;
+        }
+
+        float ax = x2 - x1, ay = y2 - y1, az = z2 - z1;
+        float bx = x3 - x1, by = y3 - y1, bz = z3 - z1;
+        float nx = ay * bz - az * by;
+        float ny = az * bx - ax * bz;
+        float nz = ax * by - ay * bx;
+        float facing = nx * x1 + ny * y1 + nz * z1;
+        return cullMode == CULL_BACK ? !(facing > 0.0f) : !(facing < 0.0f);
     }
 
     /// @brief Converts a given world position to a texture position
-    /// @details More optimized than two separate calls to worldToScreen and screenToTexture
+    /// @details One multiply by the cached projection * view matrix, and one divide
     /// @param worldPos The world position
     /// @return The texture position
-    Vec worldToTexture(Vec worldPos)
+    Vec worldToTexture(const Vec &worldPos) const
     {
-        // convert to screen space
-        Vec screenPos = this->_projectionMatrix * worldPos;
-        screenPos = screenPos / screenPos.w;
+        return this->clipToTexture(this->_pvMatrix * worldPos);
+    }
 
-        // convert to texture space
-        Vec texturePos = this->_viewMatrix * screenPos;
-        texturePos = texturePos/texturePos.w;
+    /// @brief Converts a projected (clip space) position to a texture position
+    /// @details The viewport only scales and offsets x and y, so it is folded into the divide instead of being a second
+    /// @details matrix multiply
+    /// @param clipPos The position, after the projection matrix
+    /// @return The texture position, with 1/w of the clip space position in w
+    Vec clipToTexture(const Vec &clipPos) const
+    {
+        const Matrix &viewport = this->_viewportMatrix;
+        float invW = 1.0f / clipPos.w;
+        // keep 1/w for the depth test -- unlike w, it is linear in screen space
+        return Vec(clipPos.x * invW * viewport.at(0, 0) + viewport.at(0, 3), clipPos.y * invW * viewport.at(1, 1) + viewport.at(1, 3),
+                   clipPos.z * invW, invW);
+    }
+
+    /// @brief Converts a clip space position back to view space, for culling and shading
+    /// @details The projection scales x and y, and takes w from z, without mixing in the other axes -- so undoing it is
+    /// @details three multiplies, rather than a multiply by the inverse matrix
+    Vec clipToView(const Vec &clipPos) const
+    {
+        return Vec(clipPos.x * this->_viewScale.x, clipPos.y * this->_viewScale.y, clipPos.w * this->_viewScale.z);
+    }
+
+    /// @brief Brings the cached matrices up to date with the settings and the camera
+    /// @details The projection is only rebuilt when its parameters change, and the view only when the camera moves --
+    /// @details neither touches the world matrices or bounds of the scene graph, which do not depend on the camera
+    void updateMatrices()
+    {
+        if (this->_camera != nullptr && this->_camera->getProjectionVersion() != this->_cameraProjectionVersion)
+        {
+            this->_projectionDirty = true;
+        }
+        if (this->_projectionDirty)
+        {
+            this->generateProjection();
+        }
 
-        return texturePos;
+        // brings the camera's world matrix up to date, if it moved since the scene graph was last updated -- compared by
+        // value, as a flattened update writes an unchanged matrix back with a new version
+        if (this->_camera != nullptr && this->_camera->getWorldMatrix() != this->_cameraWorld)
+        {
+            this->_viewDirty = true;
+        }
+        if (this->_viewDirty)
+        {
+            this->generateView();
+        }
     }
 
-    void generateMatrices()
+    /// @brief Builds everything that depends on the projection parameters and the size of the output
+    void generateProjection()
     {
         // generate the projection matrix
-        float aspectRatio = (float)this->_settings.height / (float)this->_settings.width;
-        float fov = this->_settings.fov;
-        float nearPlane = this->_settings.nearPlane;
-        float farPlane = this->_settings.farPlane;
+        // the height of the output over its width, as it is shown
+        float aspectRatio = (float)this->_settings.height * this->_settings.pixelAspect / (float)this->_settings.width;
+        float fov = this->_camera != nullptr ? this->_camera->getFov() : this->_settings.fov;
+        float nearPlane = this->_camera != nullptr ? this->_camera->getNearPlane() : this->_settings.nearPlane;
+        float farPlane = this->_camera != nullptr ? this->_camera->getFarPlane() : this->_settings.farPlane;
         float fovRad = 1.0f / tanf(fov * 0.5f / 180.0f * 3.14159f);
         float range = farPlane - nearPlane;
 
@@ -220,26 +1355,41 @@ private:
         this->_projectionMatrix.set(2, 3, 1.0f);
         this->_projectionMatrix.set(3, 3, 0.0f);
 
-        // std::cout << "Projection Matrix: " << std::endl;
-        // std::cout << this->_projectionMatrix.toString() << std::endl;
-
-        // generate the view matrix
-        // the view matrix converts the normalized screen position to a texture position
+        // generate the viewport matrix
+        // the viewport matrix converts the normalized screen position to a texture position
         // ie (-1,-1) to (1,1) to (0,0) to (width, height)
-        this->_viewMatrix = Matrix();
-        this->_viewMatrix.set(0, 0, this->_settings.width / 2.0f);
-        this->_viewMatrix.set(1, 1, this->_settings.height / 2.0f);
-        this->_viewMatrix.set(0, 3, this->_settings.width / 2.0f);
-        this->_viewMatrix.set(1, 3, this->_settings.height / 2.0f);
+        this->_viewportMatrix = Matrix();
+        this->_viewportMatrix.set(0, 0, this->_settings.width / 2.0f);
+        this->_viewportMatrix.set(1, 1, this->_settings.height / 2.0f);
+        this->_viewportMatrix.set(0, 3, this->_settings.width / 2.0f);
+        this->_viewportMatrix.set(1, 3, this->_settings.height / 2.0f);
+
+        this->_viewScale = Vec(1.0f / this->_projectionMatrix.at(0, 0), 1.0f / this->_projectionMatrix.at(1, 1),
+                               1.0f / this->_projectionMatrix.at(3, 2));
 
-        // std::cout << "View Matrix: " << std::endl;
-        // std::cout << this->_viewMatrix.toString() << std::endl;
+        // the frustum of everything that the projection puts on the screen, between the near and far planes
+        this->_viewFrustum = Frustum::fromProjection(this->_projectionMatrix, nearPlane, farPlane);
+        this->_clipper = Clipper(this->_projectionMatrix, nearPlane, farPlane);
 
-        // generate the pv matrix
-        this->_pvMatrix = this->_projectionMatrix * this->_viewMatrix;
+        this->_cameraProjectionVersion = this->_camera != nullptr ? this->_camera->getProjectionVersion() : 0;
+        this->_projectionDirty = false;
+        this->_viewDirty = true;
+        this->_stats.projectionRebuilds++;
+    }
+
+    /// @brief Builds everything that depends on where the camera is -- the pv matrix and the world space frustum
+    void generateView()
+    {
+        // without a camera, the eye sits at the origin, looking down -z, so view space is world space
+        Matrix view = this->_camera != nullptr ? this->_camera->getViewMatrix() : Matrix();
+        this->_pvMatrix = this->_projectionMatrix * view;
+        this->_frustum = this->_camera != nullptr ? this->_viewFrustum.transformed(view) : this->_viewFrustum;
 
-        // std::cout << "PV Matrix: " << std::endl;
-        // std::cout << this->_pvMatrix.toString() << std::endl;
+        this->_cameraWorld = this->_camera != nullptr ? this->_camera->getWorldMatrix() : Matrix();
+        this->_viewDirty = false;
+        // everything moved on screen
+        this->_redrawAll = true;
+        this->_stats.viewRebuilds++;
     }
 };
 
@@ -11,11 +11,15 @@
 #include <vector>
 #include <map>
 #include <stack>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
 
 #include "vec.hpp"
 #include "matrix.hpp"
 #include "quaternion.hpp"
 #include "mesh.hpp"
+#include "bounds.hpp"
 
 /// @brief A component is a piece of data that is attached to an entity
 /// @details Every entity has a transform
@@ -26,9 +30,21 @@ public:
     Quaternion rotation;
     Vec scale;
 
-    Transform() : position(Vec()), rotation(Quaternion()), scale(Vec(1, 1, 1)) {}
-    Transform(Vec position, Quaternion rotation, Vec scale) : position(position), rotation(rotation), scale(scale) {}
-    Transform(const Transform &t) : position(t.position), rotation(t.rotation), scale(t.scale) {}
+    /// @details A new transform is dirty, so that whatever caches its matrix builds it at least once
+    Transform() : position(Vec()), rotation(Quaternion()), scale(Vec(1, 1, 1)), _dirty(true) {}
+    Transform(Vec position, Quaternion rotation, Vec scale) : position(position), rotation(rotation), scale(scale), _dirty(true) {}
+    Transform(const Transform &t) : position(t.position), rotation(t.rotation), scale(t.scale), _dirty(true) {}
+
+    /// @brief Assignment operator
+    /// @details Marks the transform as dirty, as the assigned values are new to whatever caches this transform
+    Transform &operator=(const Transform &t)
+    {
+        this->position = t.position;
+        this->rotation = t.rotation;
+        this->scale = t.scale;
+        this->_dirty = true;
+        return *this;
+    }
 
     /// @brief Gets the transformation matrix of the transform
     /// @details Returns the transformation matrix of the transform
@@ -52,6 +68,40 @@ public:
         return transformationMatrix;
     }
 
+    /// @brief Returns true if the transform has changed since its matrix was last cached
+    bool isDirty() const
+    {
+        return this->_dirty;
+    }
+
+    /// @brief Marks the transform as changed
+    /// @details Every mutator below does this -- call it after writing position, rotation or scale directly
+    void markDirty()
+    {
+        this->_dirty = true;
+    }
+
+    /// @brief Sets the position of the transform
+    void setPosition(const Vec &position)
+    {
+        this->position = position;
+        this->_dirty = true;
+    }
+
+    /// @brief Sets the rotation of the transform
+    void setRotation(const Quaternion &rotation)
+    {
+        this->rotation = rotation;
+        this->_dirty = true;
+    }
+
+    /// @brief Sets the scale of the transform
+    void setScale(const Vec &scale)
+    {
+        this->scale = scale;
+        this->_dirty = true;
+    }
+
     // Movement functions
     /// @brief Moves the transform by the given vector
     /// @details Moves the transform by the given vector
@@ -59,6 +109,7 @@ public:
     void move(const Vec &v)
     {
         this->position = this->position + v;
+        this->_dirty = true;
     }
 
     /// rotates the transform by the given quaternion
@@ -67,6 +118,7 @@ public:
     void rotate(const Quaternion &q)
     {
         this->rotation = this->rotation * q;
+        this->_dirty = true;
     }
 
     /// @brief Scales the transform by the given vector
@@ -75,6 +127,7 @@ public:
     void scaleBy(const Vec &v)
     {
         this->scale = this->scale * v;
+        this->_dirty = true;
     }
 
     /// @brief Scales the transform by the given scalar
@@ -83,6 +136,7 @@ public:
     void scaleBy(float s)
     {
         this->scale = this->scale * s;
+        this->_dirty = true;
     }
 
 
@@ -94,6 +148,22 @@ public:
         ss << "Transform(" << this->position.toString() << ", " << this->rotation.toString() << ", " << this->scale.toString() << ")";
         return ss.str();
     }
+
+private:
+    friend class TransformNode;
+    friend class FlatSceneGraph;
+
+    // cleared by the TransformNode that caches this transform's matrix -- a cache flag, so it may change on a const transform
+    mutable bool _dirty;
+};
+
+/// @brief Which triangles of a mesh are discarded by the renderer, based on their winding
+/// @details Triangles are front facing when they are clockwise on screen (see Triangle)
+enum CullMode
+{
+    CULL_BACK,  // draw the front faces -- the default, for closed meshes
+    CULL_FRONT, // draw the back faces, e.g. for the inside of a room
+    CULL_NONE   // draw everything, e.g. for flat, two sided meshes
 };
 
 /// @brief Additonal information that is attached to a TransformNode for rendering
@@ -102,18 +172,30 @@ class RenderInfo
 {
 public:
     std::shared_ptr<Mesh> mesh;
+    std::shared_ptr<IndexedMesh> indexedMesh; // rendered instead of mesh when set
+    CullMode cullMode;
     // TODO: implement material system
 
-    RenderInfo() : mesh(nullptr) {}
-    RenderInfo(std::shared_ptr<Mesh> mesh) : mesh(mesh) {}
-    RenderInfo(const RenderInfo &renderInfo) : mesh(renderInfo.mesh) {}
+    RenderInfo() : mesh(nullptr), indexedMesh(nullptr), cullMode(CULL_BACK) {}
+    RenderInfo(std::shared_ptr<Mesh> mesh, CullMode cullMode = CULL_BACK) : mesh(mesh), indexedMesh(nullptr), cullMode(cullMode) {}
+    RenderInfo(std::shared_ptr<IndexedMesh> indexedMesh, CullMode cullMode = CULL_BACK) : mesh(nullptr), indexedMesh(indexedMesh), cullMode(cullMode) {}
+    RenderInfo(const RenderInfo &renderInfo) : mesh(renderInfo.mesh), indexedMesh(renderInfo.indexedMesh), cullMode(renderInfo.cullMode) {}
+    RenderInfo &operator=(const RenderInfo &renderInfo) = default;
+
+    /// @brief Returns true if there is anything to render
+    bool hasGeometry() const
+    {
+        return this->mesh != nullptr || this->indexedMesh != nullptr;
+    }
 
     /// @brief Returns a string representation of this render info
     /// @details Returns a string representation of this render info
     std::string toString() const
     {
         std::stringstream ss;
-        std::string meshStr = this->mesh == nullptr ? "nullptr" : this->mesh->toString();
+        std::string meshStr = this->indexedMesh != nullptr ? this->indexedMesh->toString()
+                              : this->mesh != nullptr  ? this->mesh->toString()
+                                                       : "nullptr";
         ss << "RenderInfo(" << meshStr << ")";
         return ss.str();
     }
@@ -124,7 +206,7 @@ public:
 class TransformNode : public std::enable_shared_from_this<TransformNode>
 {
 public:
-    std::shared_ptr<TransformNode> parent;
+    TransformNode *parent; // non-owning -- the parent owns its children, not the other way around
     std::vector<std::shared_ptr<TransformNode>> children;
     Transform transform;
     RenderInfo renderInfo;
@@ -139,28 +221,104 @@ public:
     void addChild(std::shared_ptr<TransformNode> node)
     {
         this->children.push_back(node);
-        node->parent = std::shared_ptr<TransformNode>(this);
+        node->parent = this;
+        // the cached world matrix was relative to the old parent
+        node->_worldDirty = true;
+        this->markStructureChanged();
     }
 
-    /// @brief Gets the transformation matrix of the node
-    /// @details Returns the transformation matrix of the node
-    Matrix toTransformationMatrix() const
+    /// @brief Notes that nodes were added to or removed from the hierarchy that this node belongs to
+    /// @details addChild does this -- call it after editing children directly, so that flattened copies of the graph
+    /// @details are rebuilt
+    void markStructureChanged()
     {
-        Matrix transformationMatrix = this->transform.toTransformationMatrix();
-
-        if (this->parent != nullptr)
+        TransformNode *root = this;
+        while (root->parent != nullptr)
         {
-            transformationMatrix = this->parent->toTransformationMatrix() * transformationMatrix;
+            root = root->parent;
         }
+        root->_structureVersion++;
+    }
 
-        return transformationMatrix;
+    /// @brief Returns a counter that changes whenever the hierarchy below this node (as a root) changes
+    uint64_t getStructureVersion() const
+    {
+        return this->_structureVersion;
+    }
+
+    /// @brief Returns a counter that changes whenever the cached world matrix of this node is rebuilt
+    /// @details Only meaningful once the world matrix is up to date -- after getWorldMatrix(), or a flattened update
+    uint64_t getWorldVersion() const
+    {
+        return this->_worldVersion;
+    }
+
+    /// @brief Gets the transformation matrix of the node
+    /// @details Returns the world matrix of the node -- see getWorldMatrix()
+    Matrix toTransformationMatrix() const
+    {
+        return this->getWorldMatrix();
     }
 
     /// @brief Returns the local transformationMatrix of this node -- independent of parents
     /// @details Returns the local transformationMatrix of this node -- independent of parents
     Matrix toLocalTransformationMatrix() const
     {
-        return this->transform.toTransformationMatrix();
+        return this->getLocalMatrix();
+    }
+
+    /// @brief Returns the cached local matrix of this node, rebuilding it if the transform is dirty
+    const Matrix &getLocalMatrix() const
+    {
+        if (this->transform._dirty)
+        {
+            this->_localMatrix = this->transform.toTransformationMatrix();
+            this->transform._dirty = false;
+            this->_localVersion++;
+            this->_worldDirty = true;
+        }
+        return this->_localMatrix;
+    }
+
+    /// @brief Returns the world matrix of this node, bringing every cached matrix on the way to the root up to date
+    /// @details Walks up to the root, but only rebuilds the matrices that are out of date
+    /// @details When updating a whole graph, updateWorldMatrix() in a top-down pass is cheaper
+    const Matrix &getWorldMatrix() const
+    {
+        if (this->parent != nullptr)
+        {
+            this->parent->getWorldMatrix();
+        }
+        return this->updateWorldMatrix();
+    }
+
+    /// @brief Brings the cached world matrix of this node up to date, assuming that the parent's is
+    /// @details Rebuilds the local matrix if the transform is dirty, and the world matrix if either the local matrix
+    /// @details or the parent's world matrix changed -- used by top-down passes, which visit parents first
+    /// @return The world matrix of this node
+    const Matrix &updateWorldMatrix() const
+    {
+        this->getLocalMatrix();
+        if (this->parent != nullptr && this->parent->_worldVersion != this->_parentWorldVersion)
+        {
+            this->_worldDirty = true;
+        }
+
+        if (this->_worldDirty)
+        {
+            if (this->parent != nullptr)
+            {
+                this->_worldMatrix = this->parent->_worldMatrix * this->_localMatrix;
+                this->_parentWorldVersion = this->parent->_worldVersion;
+            }
+            else
+            {
+                this->_worldMatrix = this->_localMatrix;
+            }
+            this->_worldVersion++;
+            this->_worldDirty = false;
+        }
+        return this->_worldMatrix;
     }
 
     /// @brief returns the string representation of this node
@@ -238,6 +396,19 @@ public:
     {
         return TransformNodeIterator();
     }
+
+private:
+    friend class FlatSceneGraph;
+
+    uint64_t _structureVersion = 0; // only meaningful on a root
+
+    // caches -- they follow the transform, so they may be updated on a const node
+    mutable Matrix _localMatrix;
+    mutable uint64_t _localVersion = 0;       // bumped every time the local matrix is rebuilt
+    mutable Matrix _worldMatrix;
+    mutable bool _worldDirty = true;
+    mutable uint64_t _worldVersion = 0;       // bumped every time the world matrix is rebuilt
+    mutable uint64_t _parentWorldVersion = 0; // the parent's version that the world matrix was built from
 };
 
 /// @brief A scene graph is a collection of nodes
@@ -265,6 +436,27 @@ public:
         return this->root->toTransformationMatrix();
     }
 
+    /// @brief Brings the cached world matrix of every node up to date, in a single top-down pass
+    /// @details Only the nodes whose transform, or an ancestor's transform, changed are rebuilt
+    void updateWorldMatrices() const
+    {
+        std::vector<const TransformNode *> stack;
+        stack.push_back(this->root.get());
+        while (!stack.empty())
+        {
+            const TransformNode *node = stack.back();
+            stack.pop_back();
+            node->updateWorldMatrix();
+            for (const auto &child : node->children)
+            {
+                if (child != nullptr)
+                {
+                    stack.push_back(child.get());
+                }
+            }
+        }
+    }
+
     // Iterator
     TransformNode::TransformNodeIterator begin() const
     {
@@ -277,4 +469,284 @@ public:
     }
 };
 
+/// @brief A flattened, read-mostly copy of a scene graph, laid out for linear sweeps
+/// @details Nodes are stored in depth first order in contiguous arrays, so a parent always comes before its children
+/// @details The local and world matrices, parent indices and bounds live in arrays, and the render info of each node in
+/// @details a side table -- the transforms themselves stay on the nodes
+/// @details The TransformNode tree stays the authoring API -- update() reads the dirty flag of every node each frame,
+/// @details writes the world matrices that changed back to the nodes, and rebuilds the arrays when the structure of the
+/// @details tree changes
+/// @details Every node also gets the world space bounds of its whole subtree, so that a branch can be culled at once
+/// @details -- bounds are recomputed when a world matrix moved, or the node's mesh was swapped or changed its version
+class FlatSceneGraph
+{
+public:
+    // one entry per node, in depth first order -- the root is at index 0
+    std::vector<const TransformNode *> nodes; // the authoring node behind every entry
+    std::vector<int32_t> parents;             // index of the parent, -1 for the root
+    std::vector<int32_t> subtreeEnds;         // one past the index of the last descendant -- the subtree of i is [i, end)
+
+    std::vector<Matrix> localMatrices;
+    std::vector<Matrix> worldMatrices;
+
+    // side table, kept away from the transforms -- points at the render info of the node, so it is always current
+    std::vector<const RenderInfo *> renderInfos;
+
+    // world space bounds, of the node's own mesh and of everything in its subtree -- empty when there is no geometry
+    std::vector<AABB> bounds;
+    std::vector<AABB> subtreeBounds;
+    std::vector<BoundingSphere> spheres; // world space sphere of the node's own mesh -- the cheaper test of the two
+    std::vector<int32_t> subtreeGeometryCounts; // number of nodes with geometry in the subtree, including the node
+
+    FlatSceneGraph() : _root(), _structureVersion(0), _rebuilt(false) {}
+
+    /// @brief Brings the flattened graph up to date with the given scene graph
+    /// @details Rebuilds the arrays if the structure changed, then updates the world matrices in one linear sweep
+    /// @return True if the arrays were rebuilt
+    bool update(const SceneGraph &sceneGraph)
+    {
+        bool rebuilt = false;
+        if (this->isStale(sceneGraph))
+        {
+            this->build(sceneGraph);
+            rebuilt = true;
+        }
+        this->updateWorldMatrices();
+        this->updateBounds();
+        return rebuilt;
+    }
+
+    /// @brief Returns true if the given scene graph is not the one that was flattened, or its structure changed since
+    /// @details The root is held weakly, so that a new root at the address of a destroyed one is not mistaken for it
+    bool isStale(const SceneGraph &sceneGraph) const
+    {
+        std::shared_ptr<const TransformNode> root = this->_root.lock();
+        if (root == nullptr)
+        {
+            // either nothing was flattened, or the root that was is gone -- and the nodes with it
+            return !this->nodes.empty() || sceneGraph.root != nullptr;
+        }
+        return root != sceneGraph.root || root->getStructureVersion() != this->_structureVersion;
+    }
+
+    /// @brief Flattens the given scene graph
+    /// @details Only allocates when the graph has grown past the capacity of a previous build
+    void build(const SceneGraph &sceneGraph)
+    {
+        this->clear();
+        const TransformNode *root = sceneGraph.root.get();
+        if (root == nullptr)
+        {
+            return;
+        }
+        this->_root = sceneGraph.root;
+        this->_structureVersion = root->getStructureVersion();
+        // a fresh entry has never seen its node, so the next sweep pulls every transform in
+        this->_rebuilt = true;
+
+        // depth first, children in order -- the same order as the scene graph iterator
+        this->_buildStack.push_back(std::make_pair(root, -1));
+        while (!this->_buildStack.empty())
+        {
+            const TransformNode *node = this->_buildStack.back().first;
+            int32_t parent = this->_buildStack.back().second;
+            this->_buildStack.pop_back();
+
+            int32_t index = (int32_t)this->nodes.size();
+            this->nodes.push_back(node);
+            this->parents.push_back(parent);
+            this->subtreeEnds.push_back(index + 1);
+            this->localMatrices.push_back(Matrix());
+            this->worldMatrices.push_back(Matrix());
+            this->renderInfos.push_back(&node->renderInfo);
+            this->bounds.push_back(AABB());
+            this->spheres.push_back(BoundingSphere());
+            this->subtreeBounds.push_back(AABB());
+            this->subtreeGeometryCounts.push_back(node->renderInfo.hasGeometry() ? 1 : 0);
+            this->_boundsDirty.push_back(0);
+            this->_localVersions.push_back(node->_localVersion - 1);
+            this->_geometries.push_back(nullptr);
+            this->_meshVersions.push_back(0);
+            this->_changed.push_back(0);
+
+            for (auto it = node->children.rbegin(); it != node->children.rend(); ++it)
+            {
+                if (*it != nullptr)
+                {
+                    this->_buildStack.push_back(std::make_pair(it->get(), index));
+                }
+            }
+        }
+
+        // children come after their parents, so a reverse sweep sees every subtree before its root
+        for (size_t i = this->nodes.size() - 1; i > 0; i--)
+        {
+            int32_t parent = this->parents[i];
+            this->subtreeEnds[parent] = std::max(this->subtreeEnds[parent], this->subtreeEnds[i]);
+            this->subtreeGeometryCounts[parent] += this->subtreeGeometryCounts[i];
+        }
+    }
+
+    /// @brief Updates the local and world matrices of every node, in one linear sweep
+    /// @details A node's local matrix is rebuilt from its transform when the transform is dirty, and its world matrix when
+    /// @details its local matrix or any ancestor's changed; changed matrices are written back to the node
+    void updateWorldMatrices()
+    {
+        const size_t count = this->nodes.size();
+        for (size_t i = 0; i < count; i++)
+        {
+            const TransformNode *node = this->nodes[i];
+            bool changed = this->_rebuilt;
+
+            if (node->transform._dirty)
+            {
+                this->localMatrices[i] = node->transform.toTransformationMatrix();
+                node->_localMatrix = this->localMatrices[i];
+                node->transform._dirty = false;
+                node->_localVersion++;
+                this->_localVersions[i] = node->_localVersion;
+                changed = true;
+            }
+            else if (node->_localVersion != this->_localVersions[i])
+            {
+                // the node rebuilt its own cache since the last sweep
+                this->localMatrices[i] = node->_localMatrix;
+                this->_localVersions[i] = node->_localVersion;
+                changed = true;
+            }
+
+            int32_t parent = this->parents[i];
+            if (parent >= 0 && this->_changed[parent] != 0)
+            {
+                changed = true;
+            }
+
+            if (changed)
+            {
+                if (parent >= 0)
+                {
+                    VecKernels::matMat(this->worldMatrices[parent].elements, this->localMatrices[i].elements, this->worldMatrices[i].elements);
+                }
+                else
+                {
+                    this->worldMatrices[i] = this->localMatrices[i];
+                }
+
+                // write back, so that the TransformNode API sees the same matrices
+                node->_worldMatrix = this->worldMatrices[i];
+                node->_worldVersion++;
+                node->_worldDirty = false;
+                if (node->parent != nullptr)
+                {
+                    node->_parentWorldVersion = node->parent->_worldVersion;
+                }
+            }
+            this->_changed[i] = changed ? 1 : 0;
+        }
+        this->_rebuilt = false;
+    }
+
+    /// @brief Updates the world space bounds of every node whose world matrix or mesh changed, and the subtree bounds
+    /// @brief above them
+    /// @details One reverse sweep, so that every subtree is finished before its root -- call after updateWorldMatrices()
+    void updateBounds()
+    {
+        for (size_t i = this->nodes.size(); i-- > 0;)
+        {
+            const RenderInfo &renderInfo = *this->renderInfos[i];
+            const void *geometry = renderInfo.indexedMesh != nullptr ? (const void *)renderInfo.indexedMesh.get()
+                                                                     : (const void *)renderInfo.mesh.get();
+            uint64_t meshVersion = renderInfo.indexedMesh != nullptr ? renderInfo.indexedMesh->getVersion()
+                                   : renderInfo.mesh != nullptr      ? renderInfo.mesh->getVersion()
+                                                                     : 0;
+            if (this->_changed[i] != 0 || geometry != this->_geometries[i] || meshVersion != this->_meshVersions[i])
+            {
+                const AABB &local = renderInfo.indexedMesh != nullptr ? renderInfo.indexedMesh->getBoundingBox()
+                                    : renderInfo.mesh != nullptr      ? renderInfo.mesh->getBoundingBox()
+                                                                      : AABB();
+                const BoundingSphere &sphere = renderInfo.indexedMesh != nullptr ? renderInfo.indexedMesh->getBoundingSphere()
+                                               : renderInfo.mesh != nullptr      ? renderInfo.mesh->getBoundingSphere()
+                                                                                 : BoundingSphere();
+                this->bounds[i] = local.transform(this->worldMatrices[i]);
+                this->spheres[i] = sphere.transform(this->worldMatrices[i]);
+                this->_geometries[i] = geometry;
+                this->_meshVersions[i] = meshVersion;
+                this->_boundsDirty[i] = 1;
+            }
+
+            if (this->_boundsDirty[i] == 0)
+            {
+                continue;
+            }
+
+            // rebuild from scratch, so that the bounds can shrink -- the children are already up to date
+            AABB merged = this->bounds[i];
+            int32_t end = this->subtreeEnds[i];
+            for (int32_t child = (int32_t)i + 1; child < end; child = this->subtreeEnds[child])
+            {
+                merged.merge(this->subtreeBounds[child]);
+            }
+            this->subtreeBounds[i] = merged;
+            this->_boundsDirty[i] = 0;
+
+            if (this->parents[i] >= 0)
+            {
+                this->_boundsDirty[this->parents[i]] = 1;
+            }
+        }
+    }
+
+    /// @brief Returns true if the world matrix of the node at the given index changed in the last update()
+    bool hasChanged(size_t i) const
+    {
+        return this->_changed[i] != 0;
+    }
+
+    /// @brief Returns the number of nodes
+    size_t size() const
+    {
+        return this->nodes.size();
+    }
+
+    /// @brief Empties the arrays, keeping their capacity
+    void clear()
+    {
+        this->nodes.clear();
+        this->parents.clear();
+        this->subtreeEnds.clear();
+        this->localMatrices.clear();
+        this->worldMatrices.clear();
+        this->renderInfos.clear();
+        this->bounds.clear();
+        this->spheres.clear();
+        this->subtreeBounds.clear();
+        this->subtreeGeometryCounts.clear();
+        this->_boundsDirty.clear();
+        this->_localVersions.clear();
+        this->_geometries.clear();
+        this->_meshVersions.clear();
+        this->_changed.clear();
+        this->_buildStack.clear();
+        this->_root.reset();
+    }
+
+    std::string toString() const
+    {
+        std::stringstream ss;
+        ss << "FlatSceneGraph(" << this->nodes.size() << " nodes)";
+        return ss.str();
+    }
+
+private:
+    std::weak_ptr<const TransformNode> _root; // the root that was flattened -- expires with it
+    uint64_t _structureVersion;
+    bool _rebuilt; // every world matrix has to be rebuilt by the next sweep
+    std::vector<uint64_t> _localVersions; // the local version of each node that the arrays hold
+    std::vector<const void *> _geometries; // the mesh or indexed mesh that the bounds were computed from
+    std::vector<uint64_t> _meshVersions;   // the version of that mesh
+    std::vector<uint8_t> _changed;         // per node -- the world matrix changed in the current sweep
+    std::vector<uint8_t> _boundsDirty;     // per node -- a descendant's bounds moved, so the subtree bounds are stale
+    std::vector<std::pair<const TransformNode *, int32_t>> _buildStack;
+};
+
 #endif // __SCENE_GRAPH_H__
\ No newline at end of file
@@ -0,0 +1,839 @@
+#ifndef __SIMD_H__
+#define __SIMD_H__
+
+// Header file for all things related to SIMD
+// Compile-time selection of the vector math kernels used by Vec and Matrix, and of the pixel kernels used by the displays
+
+// notes for development:
+// - every kernel works on raw float pointers, so that vec.hpp and matrix.hpp can both use them
+// - pixel kernels work on raw RGBA8 bytes (4 per pixel) and integer math, so they are bit-exact without any care
+// - ScalarKernels is the reference implementation -- the SIMD kernels must be bit-exact with it
+// - bit-exactness relies on the compiler not contracting a * b + c into an fma (-ffp-contract=off)
+// - define RASCII_NO_SIMD to force the scalar kernels
+
+// Dependencies
+#include <cstddef>
+
+#if !defined(RASCII_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define RASCII_SIMD_SSE 1
+#include <emmintrin.h>
+#if defined(__AVX__)
+#define RASCII_SIMD_AVX 1
+#include <immintrin.h>
+#endif
+#elif !defined(RASCII_NO_SIMD) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#define RASCII_SIMD_NEON 1
+#include <arm_neon.h>
+#else
+#define RASCII_SIMD_SCALAR 1
+#endif
+
+/// @brief The scalar reference implementation of the vector math kernels
+/// @details Vectors are 4 floats, matrices are 16 floats in row-major order
+/// @details The order of operations here is the contract that the SIMD kernels must reproduce
+struct ScalarKernels
+{
+    static const char *name()
+    {
+        return "scalar";
+    }
+
+    /// @brief out = a + b (element-wise)
+    static inline void add(const float *a, const float *b, float *out)
+    {
+        out[0] = a[0] + b[0];
+        out[1] = a[1] + b[1];
+        out[2] = a[2] + b[2];
+        out[3] = a[3] + b[3];
+    }
+
+    /// @brief out = a - b (element-wise)
+    static inline void sub(const float *a, const float *b, float *out)
+    {
+        out[0] = a[0] - b[0];
+        out[1] = a[1] - b[1];
+        out[2] = a[2] - b[2];
+        out[3] = a[3] - b[3];
+    }
+
+    /// @brief out = a * b (element-wise)
+    static inline void mul(const float *a, const float *b, float *out)
+    {
+        out[0] = a[0] * b[0];
+        out[1] = a[1] * b[1];
+        out[2] = a[2] * b[2];
+        out[3] = a[3] * b[3];
+    }
+
+    /// @brief out = a / b (element-wise)
+    static inline void div(const float *a, const float *b, float *out)
+    {
+        out[0] = a[0] / b[0];
+        out[1] = a[1] / b[1];
+        out[2] = a[2] / b[2];
+        out[3] = a[3] / b[3];
+    }
+
+    /// @brief out = a * s
+    static inline void scale(const float *a, float s, float *out)
+    {
+        out[0] = a[0] * s;
+        out[1] = a[1] * s;
+        out[2] = a[2] * s;
+        out[3] = a[3] * s;
+    }
+
+    /// @brief out = a / s
+    static inline void divScalar(const float *a, float s, float *out)
+    {
+        out[0] = a[0] / s;
+        out[1] = a[1] / s;
+        out[2] = a[2] / s;
+        out[3] = a[3] / s;
+    }
+
+    /// @brief Returns the 4D dot product of a and b, summed left to right
+    static inline float dot(const float *a, const float *b)
+    {
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+    }
+
+    /// @brief out = a x b (3D cross product, w is zero)
+    static inline void cross(const float *a, const float *b, float *out)
+    {
+        float x = a[1] * b[2] - a[2] * b[1];
+        float y = a[2] * b[0] - a[0] * b[2];
+        float z = a[0] * b[1] - a[1] * b[0];
+        out[0] = x;
+        out[1] = y;
+        out[2] = z;
+        out[3] = 0.0f;
+    }
+
+    /// @brief out = m * v (v as a column vector)
+    static inline void matVec(const float *m, const float *v, float *out)
+    {
+        float result[4];
+        for (int row = 0; row < 4; row++)
+        {
+            const float *r = m + row * 4;
+            result[row] = r[0] * v[0] + r[1] * v[1] + r[2] * v[2] + r[3] * v[3];
+        }
+        out[0] = result[0];
+        out[1] = result[1];
+        out[2] = result[2];
+        out[3] = result[3];
+    }
+
+    /// @brief out = a * b
+    static inline void matMat(const float *a, const float *b, float *out)
+    {
+        float result[16];
+        for (int row = 0; row < 4; row++)
+        {
+            const float *r = a + row * 4;
+            for (int col = 0; col < 4; col++)
+            {
+                result[row * 4 + col] = r[0] * b[col] + r[1] * b[4 + col] + r[2] * b[8 + col] + r[3] * b[12 + col];
+            }
+        }
+        for (int i = 0; i < 16; i++)
+        {
+            out[i] = result[i];
+        }
+    }
+
+    /// @brief Transforms count points by m -- out[i] = m * in[i]
+    /// @details Strides are in floats, so that vertex arrays with interleaved attributes can be transformed in place
+    static inline void transformPoints(const float *m, const float *in, size_t inStride, float *out, size_t outStride, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            matVec(m, in + i * inStride, out + i * outStride);
+        }
+    }
+
+    /// @brief Transforms count normals by the upper 3x3 of m (w is zero)
+    /// @details Strides are in floats
+    static inline void transformNormals(const float *m, const float *in, size_t inStride, float *out, size_t outStride, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            const float *v = in + i * inStride;
+            float *o = out + i * outStride;
+            float x = v[0], y = v[1], z = v[2];
+            o[0] = m[0] * x + m[1] * y + m[2] * z;
+            o[1] = m[4] * x + m[5] * y + m[6] * z;
+            o[2] = m[8] * x + m[9] * y + m[10] * z;
+            o[3] = 0.0f;
+        }
+    }
+
+    /// @brief Transforms count (position, normal) pairs in a single pass
+    /// @details Positions are transformed as points, normals by the upper 3x3 -- strides are in floats and shared by both
+    static inline void transformPointsAndNormals(const float *m, const float *inPositions, const float *inNormals, size_t inStride,
+                                                 float *outPositions, float *outNormals, size_t outStride, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            matVec(m, inPositions + i * inStride, outPositions + i * outStride);
+            transformNormals(m, inNormals + i * inStride, 0, outNormals + i * outStride, 0, 1);
+        }
+    }
+
+    /// @brief Transforms count points stored as separate x/y/z streams (w is implicitly 1)
+    /// @details out = m * (x, y, z, 1), written to separate x/y/z/w streams -- bit-exact with matVec
+    static inline void transformPointsSoA(const float *m, const float *x, const float *y, const float *z,
+                                          float *outX, float *outY, float *outZ, float *outW, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            float vx = x[i], vy = y[i], vz = z[i];
+            outX[i] = m[0] * vx + m[1] * vy + m[2] * vz + m[3];
+            outY[i] = m[4] * vx + m[5] * vy + m[6] * vz + m[7];
+            outZ[i] = m[8] * vx + m[9] * vy + m[10] * vz + m[11];
+            outW[i] = m[12] * vx + m[13] * vy + m[14] * vz + m[15];
+        }
+    }
+
+    /// @brief Transforms count normals stored as separate x/y/z streams by the upper 3x3 of m
+    static inline void transformNormalsSoA(const float *m, const float *x, const float *y, const float *z,
+                                           float *outX, float *outY, float *outZ, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            float vx = x[i], vy = y[i], vz = z[i];
+            outX[i] = m[0] * vx + m[1] * vy + m[2] * vz;
+            outY[i] = m[4] * vx + m[5] * vy + m[6] * vz;
+            outZ[i] = m[8] * vx + m[9] * vy + m[10] * vz;
+        }
+    }
+
+    // the Rec. 709 luma weights in 15 bit fixed point -- they add up to 1 << 15, so that white comes out as 255
+    static const int lumaRed = 6966;
+    static const int lumaGreen = 23436;
+    static const int lumaBlue = 2366;
+
+    /// @brief Computes the luma (0-255) of count RGBA8 pixels, alpha is ignored
+    /// @details out = (lumaRed * r + lumaGreen * g + lumaBlue * b) / (1 << 15), rounded to nearest
+    static inline void lumaRow(const unsigned char *rgba, unsigned char *out, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            const unsigned char *p = rgba + i * 4;
+            out[i] = (unsigned char)((lumaRed * p[0] + lumaGreen * p[1] + lumaBlue * p[2] + (1 << 14)) >> 15);
+        }
+    }
+};
+
+#if defined(RASCII_SIMD_SSE)
+/// @brief SSE implementation of the vector math kernels
+/// @details Pointers do not need to be aligned, but aligned data (Vec, Matrix) loads faster
+struct SimdKernels
+{
+    static const char *name()
+    {
+#if defined(RASCII_SIMD_AVX)
+        return "sse+avx";
+#else
+        return "sse";
+#endif
+    }
+
+    static inline void add(const float *a, const float *b, float *out)
+    {
+        _mm_storeu_ps(out, _mm_add_ps(_mm_loadu_ps(a), _mm_loadu_ps(b)));
+    }
+
+    static inline void sub(const float *a, const float *b, float *out)
+    {
+        _mm_storeu_ps(out, _mm_sub_ps(_mm_loadu_ps(a), _mm_loadu_ps(b)));
+    }
+
+    static inline void mul(const float *a, const float *b, float *out)
+    {
+        _mm_storeu_ps(out, _mm_mul_ps(_mm_loadu_ps(a), _mm_loadu_ps(b)));
+    }
+
+    static inline void div(const float *a, const float *b, float *out)
+    {
+        _mm_storeu_ps(out, _mm_div_ps(_mm_loadu_ps(a), _mm_loadu_ps(b)));
+    }
+
+    static inline void scale(const float *a, float s, float *out)
+    {
+        _mm_storeu_ps(out, _mm_mul_ps(_mm_loadu_ps(a), _mm_set1_ps(s)));
+    }
+
+    static inline void divScalar(const float *a, float s, float *out)
+    {
+        _mm_storeu_ps(out, _mm_div_ps(_mm_loadu_ps(a), _mm_set1_ps(s)));
+    }
+
+    static inline float dot(const float *a, const float *b)
+    {
+        __m128 p = _mm_mul_ps(_mm_loadu_ps(a), _mm_loadu_ps(b));
+        // sum the lanes in the same order as the scalar kernel: ((p0 + p1) + p2) + p3
+        __m128 sum = _mm_add_ss(p, _mm_shuffle_ps(p, p, _MM_SHUFFLE(1, 1, 1, 1)));
+        sum = _mm_add_ss(sum, _mm_movehl_ps(p, p));
+        sum = _mm_add_ss(sum, _mm_shuffle_ps(p, p, _MM_SHUFFLE(3, 3, 3, 3)));
+        return _mm_cvtss_f32(sum);
+    }
+
+    static inline void cross(const float *a, const float *b, float *out)
+    {
+        __m128 va = _mm_loadu_ps(a);
+        __m128 vb = _mm_loadu_ps(b);
+        __m128 aYZX = _mm_shuffle_ps(va, va, _MM_SHUFFLE(3, 0, 2, 1));
+        __m128 bZXY = _mm_shuffle_ps(vb, vb, _MM_SHUFFLE(3, 1, 0, 2));
+        __m128 aZXY = _mm_shuffle_ps(va, va, _MM_SHUFFLE(3, 1, 0, 2));
+        __m128 bYZX = _mm_shuffle_ps(vb, vb, _MM_SHUFFLE(3, 0, 2, 1));
+        __m128 result = _mm_sub_ps(_mm_mul_ps(aYZX, bZXY), _mm_mul_ps(aZXY, bYZX));
+        // clear w
+        const __m128 xyzMask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+        _mm_storeu_ps(out, _mm_and_ps(result, xyzMask));
+    }
+
+    static inline void matVec(const float *m, const float *v, float *out)
+    {
+        // transpose the rows into columns, so that the result is a sum of scaled columns
+        __m128 c0 = _mm_loadu_ps(m);
+        __m128 c1 = _mm_loadu_ps(m + 4);
+        __m128 c2 = _mm_loadu_ps(m + 8);
+        __m128 c3 = _mm_loadu_ps(m + 12);
+        _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+        __m128 vv = _mm_loadu_ps(v);
+        __m128 result = _mm_mul_ps(c0, _mm_shuffle_ps(vv, vv, _MM_SHUFFLE(0, 0, 0, 0)));
+        result = _mm_add_ps(result, _mm_mul_ps(c1, _mm_shuffle_ps(vv, vv, _MM_SHUFFLE(1, 1, 1, 1))));
+        result = _mm_add_ps(result, _mm_mul_ps(c2, _mm_shuffle_ps(vv, vv, _MM_SHUFFLE(2, 2, 2, 2))));
+        result = _mm_add_ps(result, _mm_mul_ps(c3, _mm_shuffle_ps(vv, vv, _MM_SHUFFLE(3, 3, 3, 3))));
+        _mm_storeu_ps(out, result);
+    }
+
+    static inline void matMat(const float *a, const float *b, float *out)
+    {
+        __m128 b0 = _mm_loadu_ps(b);
+        __m128 b1 = _mm_loadu_ps(b + 4);
+        __m128 b2 = _mm_loadu_ps(b + 8);
+        __m128 b3 = _mm_loadu_ps(b + 12);
+
+        // every row of the result is a sum of the rows of b, scaled by the row of a
+        __m128 rows[4];
+        for (int row = 0; row < 4; row++)
+        {
+            const float *r = a + row * 4;
+            __m128 result = _mm_mul_ps(_mm_set1_ps(r[0]), b0);
+            result = _mm_add_ps(result, _mm_mul_ps(_mm_set1_ps(r[1]), b1));
+            result = _mm_add_ps(result, _mm_mul_ps(_mm_set1_ps(r[2]), b2));
+            result = _mm_add_ps(result, _mm_mul_ps(_mm_set1_ps(r[3]), b3));
+            rows[row] = result;
+        }
+        for (int row = 0; row < 4; row++)
+        {
+            _mm_storeu_ps(out + row * 4, rows[row]);
+        }
+    }
+
+    static inline void transformPoints(const float *m, const float *in, size_t inStride, float *out, size_t outStride, size_t count)
+    {
+        Columns c(m);
+        size_t i = 0;
+#if defined(RASCII_SIMD_AVX)
+        for (; i + 8 <= count; i += 8)
+        {
+            for (size_t pair = 0; pair < 8; pair += 2)
+            {
+                store2(out + (i + pair) * outStride, outStride, c.transform2<true>(load2(in + (i + pair) * inStride, inStride)));
+            }
+        }
+#endif
+        for (; i < count; i++)
+        {
+            _mm_storeu_ps(out + i * outStride, c.transform<true>(_mm_loadu_ps(in + i * inStride)));
+        }
+    }
+
+    static inline void transformNormals(const float *m, const float *in, size_t inStride, float *out, size_t outStride, size_t count)
+    {
+        Columns c(m);
+        size_t i = 0;
+#if defined(RASCII_SIMD_AVX)
+        for (; i + 8 <= count; i += 8)
+        {
+            for (size_t pair = 0; pair < 8; pair += 2)
+            {
+                store2(out + (i + pair) * outStride, outStride, c.transform2<false>(load2(in + (i + pair) * inStride, inStride)));
+            }
+        }
+#endif
+        for (; i < count; i++)
+        {
+            _mm_storeu_ps(out + i * outStride, c.transform<false>(_mm_loadu_ps(in + i * inStride)));
+        }
+    }
+
+    static inline void transformPointsAndNormals(const float *m, const float *inPositions, const float *inNormals, size_t inStride,
+                                                 float *outPositions, float *outNormals, size_t outStride, size_t count)
+    {
+        Columns c(m);
+        size_t i = 0;
+#if defined(RASCII_SIMD_AVX)
+        for (; i + 8 <= count; i += 8)
+        {
+            for (size_t pair = 0; pair < 8; pair += 2)
+            {
+                size_t in = (i + pair) * inStride;
+                size_t out = (i + pair) * outStride;
+                __m256 position = c.transform2<true>(load2(inPositions + in, inStride));
+                __m256 normal = c.transform2<false>(load2(inNormals + in, inStride));
+                store2(outPositions + out, outStride, position);
+                store2(outNormals + out, outStride, normal);
+            }
+        }
+#endif
+        for (; i < count; i++)
+        {
+            __m128 position = c.transform<true>(_mm_loadu_ps(inPositions + i * inStride));
+            __m128 normal = c.transform<false>(_mm_loadu_ps(inNormals + i * inStride));
+            _mm_storeu_ps(outPositions + i * outStride, position);
+            _mm_storeu_ps(outNormals + i * outStride, normal);
+        }
+    }
+
+    static inline void transformPointsSoA(const float *m, const float *x, const float *y, const float *z,
+                                          float *outX, float *outY, float *outZ, float *outW, size_t count)
+    {
+        // structure of arrays needs no shuffles -- every register holds one component of 4 (or 8) vertices
+        size_t i = 0;
+#if defined(RASCII_SIMD_AVX)
+        __m256 m256[16];
+        for (int e = 0; e < 16; e++)
+        {
+            m256[e] = _mm256_set1_ps(m[e]);
+        }
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256 vx = _mm256_loadu_ps(x + i);
+            __m256 vy = _mm256_loadu_ps(y + i);
+            __m256 vz = _mm256_loadu_ps(z + i);
+            _mm256_storeu_ps(outX + i, soaRow8(m256, 0, vx, vy, vz));
+            _mm256_storeu_ps(outY + i, soaRow8(m256, 4, vx, vy, vz));
+            _mm256_storeu_ps(outZ + i, soaRow8(m256, 8, vx, vy, vz));
+            _mm256_storeu_ps(outW + i, soaRow8(m256, 12, vx, vy, vz));
+        }
+#endif
+        __m128 m128[16];
+        for (int e = 0; e < 16; e++)
+        {
+            m128[e] = _mm_set1_ps(m[e]);
+        }
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128 vx = _mm_loadu_ps(x + i);
+            __m128 vy = _mm_loadu_ps(y + i);
+            __m128 vz = _mm_loadu_ps(z + i);
+            _mm_storeu_ps(outX + i, soaRow4(m128, 0, vx, vy, vz));
+            _mm_storeu_ps(outY + i, soaRow4(m128, 4, vx, vy, vz));
+            _mm_storeu_ps(outZ + i, soaRow4(m128, 8, vx, vy, vz));
+            _mm_storeu_ps(outW + i, soaRow4(m128, 12, vx, vy, vz));
+        }
+        ScalarKernels::transformPointsSoA(m, x + i, y + i, z + i, outX + i, outY + i, outZ + i, outW + i, count - i);
+    }
+
+    static inline void transformNormalsSoA(const float *m, const float *x, const float *y, const float *z,
+                                           float *outX, float *outY, float *outZ, size_t count)
+    {
+        size_t i = 0;
+#if defined(RASCII_SIMD_AVX)
+        __m256 m256[12];
+        for (int e = 0; e < 12; e++)
+        {
+            m256[e] = _mm256_set1_ps(m[e]);
+        }
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256 vx = _mm256_loadu_ps(x + i);
+            __m256 vy = _mm256_loadu_ps(y + i);
+            __m256 vz = _mm256_loadu_ps(z + i);
+            _mm256_storeu_ps(outX + i, soaNormalRow8(m256, 0, vx, vy, vz));
+            _mm256_storeu_ps(outY + i, soaNormalRow8(m256, 4, vx, vy, vz));
+            _mm256_storeu_ps(outZ + i, soaNormalRow8(m256, 8, vx, vy, vz));
+        }
+#endif
+        __m128 m128[12];
+        for (int e = 0; e < 12; e++)
+        {
+            m128[e] = _mm_set1_ps(m[e]);
+        }
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128 vx = _mm_loadu_ps(x + i);
+            __m128 vy = _mm_loadu_ps(y + i);
+            __m128 vz = _mm_loadu_ps(z + i);
+            _mm_storeu_ps(outX + i, soaNormalRow4(m128, 0, vx, vy, vz));
+            _mm_storeu_ps(outY + i, soaNormalRow4(m128, 4, vx, vy, vz));
+            _mm_storeu_ps(outZ + i, soaNormalRow4(m128, 8, vx, vy, vz));
+        }
+        ScalarKernels::transformNormalsSoA(m, x + i, y + i, z + i, outX + i, outY + i, outZ + i, count - i);
+    }
+
+    static inline void lumaRow(const unsigned char *rgba, unsigned char *out, size_t count)
+    {
+        // the weights line up with r, g, b, a of 2 pixels widened to 16 bits, so that madd leaves r + g and b per pixel
+        const __m128i weights = _mm_setr_epi16(ScalarKernels::lumaRed, ScalarKernels::lumaGreen, ScalarKernels::lumaBlue, 0,
+                                               ScalarKernels::lumaRed, ScalarKernels::lumaGreen, ScalarKernels::lumaBlue, 0);
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m128i first = luma4(_mm_loadu_si128(reinterpret_cast<const __m128i *>(rgba + i * 4)), weights);
+            __m128i second = luma4(_mm_loadu_si128(reinterpret_cast<const __m128i *>(rgba + i * 4 + 16)), weights);
+            // the lumas fit in a byte, so neither pack saturates
+            __m128i luma = _mm_packus_epi16(_mm_packs_epi32(first, second), _mm_setzero_si128());
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(out + i), luma);
+        }
+        ScalarKernels::lumaRow(rgba + i * 4, out + i, count - i);
+    }
+
+private:
+    /// @brief The luma of 4 RGBA8 pixels, as 4 32 bit integers
+    static inline __m128i luma4(__m128i pixels, __m128i weights)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        __m128 low = _mm_castsi128_ps(_mm_madd_epi16(_mm_unpacklo_epi8(pixels, zero), weights));
+        __m128 high = _mm_castsi128_ps(_mm_madd_epi16(_mm_unpackhi_epi8(pixels, zero), weights));
+        // SSE2 has no horizontal add -- gather the r + g halves and the b halves of the 4 pixels, and add those
+        __m128i redGreen = _mm_castps_si128(_mm_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0)));
+        __m128i blue = _mm_castps_si128(_mm_shuffle_ps(low, high, _MM_SHUFFLE(3, 1, 3, 1)));
+        __m128i sum = _mm_add_epi32(_mm_add_epi32(redGreen, blue), _mm_set1_epi32(1 << 14));
+        return _mm_srli_epi32(sum, 15);
+    }
+
+    /// @brief A matrix transposed into columns, so that transforming a vertex is a sum of scaled columns
+    /// @details Points use all 4 columns, normals use the first 3 and have their w masked to +0 (like the scalar kernel)
+    struct Columns
+    {
+        __m128 c0, c1, c2, c3, xyzMask;
+#if defined(RASCII_SIMD_AVX)
+        __m256 c0x2, c1x2, c2x2, c3x2, xyzMaskx2;
+#endif
+
+        explicit Columns(const float *m)
+        {
+            c0 = _mm_loadu_ps(m);
+            c1 = _mm_loadu_ps(m + 4);
+            c2 = _mm_loadu_ps(m + 8);
+            c3 = _mm_loadu_ps(m + 12);
+            _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+            xyzMask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+#if defined(RASCII_SIMD_AVX)
+            c0x2 = _mm256_insertf128_ps(_mm256_castps128_ps256(c0), c0, 1);
+            c1x2 = _mm256_insertf128_ps(_mm256_castps128_ps256(c1), c1, 1);
+            c2x2 = _mm256_insertf128_ps(_mm256_castps128_ps256(c2), c2, 1);
+            c3x2 = _mm256_insertf128_ps(_mm256_castps128_ps256(c3), c3, 1);
+            xyzMaskx2 = _mm256_insertf128_ps(_mm256_castps128_ps256(xyzMask), xyzMask, 1);
+#endif
+        }
+
+        template <bool IsPoint>
+        inline __m128 transform(__m128 v) const
+        {
+            __m128 result = _mm_mul_ps(c0, _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)));
+            result = _mm_add_ps(result, _mm_mul_ps(c1, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1))));
+            result = _mm_add_ps(result, _mm_mul_ps(c2, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2))));
+            if (IsPoint)
+            {
+                return _mm_add_ps(result, _mm_mul_ps(c3, _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3))));
+            }
+            return _mm_and_ps(result, xyzMask);
+        }
+
+#if defined(RASCII_SIMD_AVX)
+        /// @brief Transforms 2 vertices at once, one per 128 bit lane
+        template <bool IsPoint>
+        inline __m256 transform2(__m256 v) const
+        {
+            __m256 result = _mm256_mul_ps(c0x2, _mm256_permute_ps(v, _MM_SHUFFLE(0, 0, 0, 0)));
+            result = _mm256_add_ps(result, _mm256_mul_ps(c1x2, _mm256_permute_ps(v, _MM_SHUFFLE(1, 1, 1, 1))));
+            result = _mm256_add_ps(result, _mm256_mul_ps(c2x2, _mm256_permute_ps(v, _MM_SHUFFLE(2, 2, 2, 2))));
+            if (IsPoint)
+            {
+                return _mm256_add_ps(result, _mm256_mul_ps(c3x2, _mm256_permute_ps(v, _MM_SHUFFLE(3, 3, 3, 3))));
+            }
+            return _mm256_and_ps(result, xyzMaskx2);
+        }
+#endif
+    };
+
+#if defined(RASCII_SIMD_AVX)
+    /// @brief Loads 2 vertices, stride floats apart, into the two 128 bit lanes
+    static inline __m256 load2(const float *v, size_t stride)
+    {
+        return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(v)), _mm_loadu_ps(v + stride), 1);
+    }
+
+    static inline void store2(float *o, size_t stride, __m256 v)
+    {
+        _mm_storeu_ps(o, _mm256_castps256_ps128(v));
+        _mm_storeu_ps(o + stride, _mm256_extractf128_ps(v, 1));
+    }
+#endif
+
+    /// @brief One row of m (broadcast) applied to 4 SoA points, in the scalar order of operations
+    static inline __m128 soaRow4(const __m128 *m, int row, __m128 x, __m128 y, __m128 z)
+    {
+        __m128 result = _mm_mul_ps(m[row], x);
+        result = _mm_add_ps(result, _mm_mul_ps(m[row + 1], y));
+        result = _mm_add_ps(result, _mm_mul_ps(m[row + 2], z));
+        return _mm_add_ps(result, m[row + 3]);
+    }
+
+    static inline __m128 soaNormalRow4(const __m128 *m, int row, __m128 x, __m128 y, __m128 z)
+    {
+        __m128 result = _mm_mul_ps(m[row], x);
+        result = _mm_add_ps(result, _mm_mul_ps(m[row + 1], y));
+        return _mm_add_ps(result, _mm_mul_ps(m[row + 2], z));
+    }
+
+#if defined(RASCII_SIMD_AVX)
+    static inline __m256 soaRow8(const __m256 *m, int row, __m256 x, __m256 y, __m256 z)
+    {
+        __m256 result = _mm256_mul_ps(m[row], x);
+        result = _mm256_add_ps(result, _mm256_mul_ps(m[row + 1], y));
+        result = _mm256_add_ps(result, _mm256_mul_ps(m[row + 2], z));
+        return _mm256_add_ps(result, m[row + 3]);
+    }
+
+    static inline __m256 soaNormalRow8(const __m256 *m, int row, __m256 x, __m256 y, __m256 z)
+    {
+        __m256 result = _mm256_mul_ps(m[row], x);
+        result = _mm256_add_ps(result, _mm256_mul_ps(m[row + 1], y));
+        return _mm256_add_ps(result, _mm256_mul_ps(m[row + 2], z));
+    }
+#endif
+};
+#elif defined(RASCII_SIMD_NEON)
+/// @brief NEON implementation of the vector math kernels
+struct SimdKernels
+{
+    static const char *name()
+    {
+        return "neon";
+    }
+
+    static inline void add(const float *a, const float *b, float *out)
+    {
+        vst1q_f32(out, vaddq_f32(vld1q_f32(a), vld1q_f32(b)));
+    }
+
+    static inline void sub(const float *a, const float *b, float *out)
+    {
+        vst1q_f32(out, vsubq_f32(vld1q_f32(a), vld1q_f32(b)));
+    }
+
+    static inline void mul(const float *a, const float *b, float *out)
+    {
+        vst1q_f32(out, vmulq_f32(vld1q_f32(a), vld1q_f32(b)));
+    }
+
+    static inline void div(const float *a, const float *b, float *out)
+    {
+#if defined(__aarch64__)
+        vst1q_f32(out, vdivq_f32(vld1q_f32(a), vld1q_f32(b)));
+#else
+        // ARMv7 NEON has no exact division
+        ScalarKernels::div(a, b, out);
+#endif
+    }
+
+    static inline void scale(const float *a, float s, float *out)
+    {
+        vst1q_f32(out, vmulq_n_f32(vld1q_f32(a), s));
+    }
+
+    static inline void divScalar(const float *a, float s, float *out)
+    {
+#if defined(__aarch64__)
+        vst1q_f32(out, vdivq_f32(vld1q_f32(a), vdupq_n_f32(s)));
+#else
+        ScalarKernels::divScalar(a, s, out);
+#endif
+    }
+
+    static inline float dot(const float *a, const float *b)
+    {
+        float32x4_t p = vmulq_f32(vld1q_f32(a), vld1q_f32(b));
+        return vgetq_lane_f32(p, 0) + vgetq_lane_f32(p, 1) + vgetq_lane_f32(p, 2) + vgetq_lane_f32(p, 3);
+    }
+
+    static inline void cross(const float *a, const float *b, float *out)
+    {
+        // there is no cheap generic shuffle on ARMv7, the scalar version is just as fast
+        ScalarKernels::cross(a, b, out);
+    }
+
+    static inline void matVec(const float *m, const float *v, float *out)
+    {
+        // the de-interleaving load turns the rows into columns
+        float32x4x4_t cols = vld4q_f32(m);
+        float32x4_t result = vmulq_n_f32(cols.val[0], v[0]);
+        result = vaddq_f32(result, vmulq_n_f32(cols.val[1], v[1]));
+        result = vaddq_f32(result, vmulq_n_f32(cols.val[2], v[2]));
+        result = vaddq_f32(result, vmulq_n_f32(cols.val[3], v[3]));
+        vst1q_f32(out, result);
+    }
+
+    static inline void matMat(const float *a, const float *b, float *out)
+    {
+        float32x4_t b0 = vld1q_f32(b);
+        float32x4_t b1 = vld1q_f32(b + 4);
+        float32x4_t b2 = vld1q_f32(b + 8);
+        float32x4_t b3 = vld1q_f32(b + 12);
+
+        float32x4_t rows[4];
+        for (int row = 0; row < 4; row++)
+        {
+            const float *r = a + row * 4;
+            float32x4_t result = vmulq_n_f32(b0, r[0]);
+            result = vaddq_f32(result, vmulq_n_f32(b1, r[1]));
+            result = vaddq_f32(result, vmulq_n_f32(b2, r[2]));
+            result = vaddq_f32(result, vmulq_n_f32(b3, r[3]));
+            rows[row] = result;
+        }
+        for (int row = 0; row < 4; row++)
+        {
+            vst1q_f32(out + row * 4, rows[row]);
+        }
+    }
+
+    static inline void transformPoints(const float *m, const float *in, size_t inStride, float *out, size_t outStride, size_t count)
+    {
+        // the columns are loaded once, every vertex is then 4 multiplies and 3 adds
+        float32x4x4_t cols = vld4q_f32(m);
+        for (size_t i = 0; i < count; i++)
+        {
+            const float *v = in + i * inStride;
+            float32x4_t result = vmulq_n_f32(cols.val[0], v[0]);
+            result = vaddq_f32(result, vmulq_n_f32(cols.val[1], v[1]));
+            result = vaddq_f32(result, vmulq_n_f32(cols.val[2], v[2]));
+            result = vaddq_f32(result, vmulq_n_f32(cols.val[3], v[3]));
+            vst1q_f32(out + i * outStride, result);
+        }
+    }
+
+    static inline void transformNormals(const float *m, const float *in, size_t inStride, float *out, size_t outStride, size_t count)
+    {
+        // the upper 3x3 of m, with a zero bottom row so that w comes out as zero
+        float upper[16] = {
+            m[0], m[1], m[2], 0.0f,
+            m[4], m[5], m[6], 0.0f,
+            m[8], m[9], m[10], 0.0f,
+            0.0f, 0.0f, 0.0f, 0.0f};
+        float32x4x4_t cols = vld4q_f32(upper);
+        for (size_t i = 0; i < count; i++)
+        {
+            const float *v = in + i * inStride;
+            float32x4_t result = vmulq_n_f32(cols.val[0], v[0]);
+            result = vaddq_f32(result, vmulq_n_f32(cols.val[1], v[1]));
+            result = vaddq_f32(result, vmulq_n_f32(cols.val[2], v[2]));
+            // 0 * -x is -0, the scalar kernel writes +0
+            vst1q_f32(out + i * outStride, vsetq_lane_f32(0.0f, result, 3));
+        }
+    }
+
+    static inline void transformPointsAndNormals(const float *m, const float *inPositions, const float *inNormals, size_t inStride,
+                                                 float *outPositions, float *outNormals, size_t outStride, size_t count)
+    {
+        float32x4x4_t cols = vld4q_f32(m);
+        for (size_t i = 0; i < count; i++)
+        {
+            const float *p = inPositions + i * inStride;
+            const float *n = inNormals + i * inStride;
+            float32x4_t position = vmulq_n_f32(cols.val[0], p[0]);
+            position = vaddq_f32(position, vmulq_n_f32(cols.val[1], p[1]));
+            position = vaddq_f32(position, vmulq_n_f32(cols.val[2], p[2]));
+            position = vaddq_f32(position, vmulq_n_f32(cols.val[3], p[3]));
+            float32x4_t normal = vmulq_n_f32(cols.val[0], n[0]);
+            normal = vaddq_f32(normal, vmulq_n_f32(cols.val[1], n[1]));
+            normal = vaddq_f32(normal, vmulq_n_f32(cols.val[2], n[2]));
+            vst1q_f32(outPositions + i * outStride, position);
+            vst1q_f32(outNormals + i * outStride, vsetq_lane_f32(0.0f, normal, 3));
+        }
+    }
+
+    static inline void transformPointsSoA(const float *m, const float *x, const float *y, const float *z,
+                                          float *outX, float *outY, float *outZ, float *outW, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            float32x4_t vx = vld1q_f32(x + i);
+            float32x4_t vy = vld1q_f32(y + i);
+            float32x4_t vz = vld1q_f32(z + i);
+            float *outs[4] = {outX, outY, outZ, outW};
+            for (int row = 0; row < 4; row++)
+            {
+                const float *r = m + row * 4;
+                float32x4_t result = vmulq_n_f32(vx, r[0]);
+                result = vaddq_f32(result, vmulq_n_f32(vy, r[1]));
+                result = vaddq_f32(result, vmulq_n_f32(vz, r[2]));
+                vst1q_f32(outs[row] + i, vaddq_f32(result, vdupq_n_f32(r[3])));
+            }
+        }
+        ScalarKernels::transformPointsSoA(m, x + i, y + i, z + i, outX + i, outY + i, outZ + i, outW + i, count - i);
+    }
+
+    static inline void transformNormalsSoA(const float *m, const float *x, const float *y, const float *z,
+                                           float *outX, float *outY, float *outZ, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            float32x4_t vx = vld1q_f32(x + i);
+            float32x4_t vy = vld1q_f32(y + i);
+            float32x4_t vz = vld1q_f32(z + i);
+            float *outs[3] = {outX, outY, outZ};
+            for (int row = 0; row < 3; row++)
+            {
+                const float *r = m + row * 4;
+                float32x4_t result = vmulq_n_f32(vx, r[0]);
+                result = vaddq_f32(result, vmulq_n_f32(vy, r[1]));
+                vst1q_f32(outs[row] + i, vaddq_f32(result, vmulq_n_f32(vz, r[2])));
+            }
+        }
+        ScalarKernels::transformNormalsSoA(m, x + i, y + i, z + i, outX + i, outY + i, outZ + i, count - i);
+    }
+
+    static inline void lumaRow(const unsigned char *rgba, unsigned char *out, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            // the de-interleaving load splits 8 pixels into their channels
+            uint8x8x4_t pixels = vld4_u8(rgba + i * 4);
+            uint16x8_t r = vmovl_u8(pixels.val[0]);
+            uint16x8_t g = vmovl_u8(pixels.val[1]);
+            uint16x8_t b = vmovl_u8(pixels.val[2]);
+            uint32x4_t low = vmull_n_u16(vget_low_u16(r), ScalarKernels::lumaRed);
+            low = vmlal_n_u16(low, vget_low_u16(g), ScalarKernels::lumaGreen);
+            low = vmlal_n_u16(low, vget_low_u16(b), ScalarKernels::lumaBlue);
+            uint32x4_t high = vmull_n_u16(vget_high_u16(r), ScalarKernels::lumaRed);
+            high = vmlal_n_u16(high, vget_high_u16(g), ScalarKernels::lumaGreen);
+            high = vmlal_n_u16(high, vget_high_u16(b), ScalarKernels::lumaBlue);
+            // the rounding narrowing shift adds 1 << 14 first, like the scalar kernel
+            uint16x8_t luma = vcombine_u16(vrshrn_n_u32(low, 15), vrshrn_n_u32(high, 15));
+            vst1_u8(out + i, vmovn_u16(luma));
+        }
+        ScalarKernels::lumaRow(rgba + i * 4, out + i, count - i);
+    }
+};
+#endif
+
+/// @brief The kernels used by Vec, Matrix and the displays -- chosen at compile time
+#if defined(RASCII_SIMD_SCALAR)
+typedef ScalarKernels VecKernels;
+#else
+typedef SimdKernels VecKernels;
+#endif
+
+#endif // __SIMD_H__
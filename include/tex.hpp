@@ -9,7 +9,11 @@
 #include <sstream>
 #include <memory>
 #include <cstring>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include "vec.hpp"
+#include "raster.hpp"
 
 // Forward declarations
 struct Vec;
@@ -146,6 +150,57 @@ private:
     }
 };
 
+/// @brief A rectangle of pixels
+/// @details min is inclusive and max is exclusive, so a rectangle with max <= min on either axis is empty
+struct Rect
+{
+    int minX, minY, maxX, maxY;
+
+    /// @brief Default constructor
+    /// @details Initializes the rectangle to an empty rectangle
+    Rect() : minX(0), minY(0), maxX(0), maxY(0) {}
+
+    /// @brief Constructor
+    /// @details Initializes the rectangle to the given bounds
+    Rect(int minX, int minY, int maxX, int maxY) : minX(minX), minY(minY), maxX(maxX), maxY(maxY) {}
+
+    /// @brief Returns true if the rectangle contains no pixel
+    bool isEmpty() const
+    {
+        return this->maxX <= this->minX || this->maxY <= this->minY;
+    }
+
+    /// @brief Returns true if the given pixel is inside the rectangle
+    bool contains(int x, int y) const
+    {
+        return x >= this->minX && x < this->maxX && y >= this->minY && y < this->maxY;
+    }
+
+    /// @brief Returns the pixels that are in both rectangles
+    Rect intersect(const Rect &rect) const
+    {
+        return Rect(std::max(this->minX, rect.minX), std::max(this->minY, rect.minY),
+                    std::min(this->maxX, rect.maxX), std::min(this->maxY, rect.maxY));
+    }
+
+    int getWidth() const
+    {
+        return this->maxX - this->minX;
+    }
+
+    int getHeight() const
+    {
+        return this->maxY - this->minY;
+    }
+
+    std::string toString() const
+    {
+        std::stringstream ss;
+        ss << "Rect(" << this->minX << ", " << this->minY << ", " << this->maxX << ", " << this->maxY << ")";
+        return ss.str();
+    }
+};
+
 /// @brief A compact representation of a texture
 /// @details A texture is represented by a 2D array of colors
 struct Texture
@@ -233,6 +288,28 @@ public:
         memset(_pixels, colorAsInt, _width * _height * sizeof(Color));
     }
 
+    /// @brief Blanks the pixels of the texture inside the given rectangle
+    void blank(const Color &c, const Rect &rect)
+    {
+        Rect clipped = rect.intersect(Rect(0, 0, _width, _height));
+        for (int y = clipped.minY; y < clipped.maxY; y++)
+        {
+            std::fill(_pixels + y * _width + clipped.minX, _pixels + y * _width + clipped.maxX, c);
+        }
+    }
+
+    /// @brief Gets the pixels, row after row -- for writers that do their own bounds checks
+    Color *getPixels()
+    {
+        return _pixels;
+    }
+
+    /// @brief Gets the pixels, row after row, for reading
+    const Color *getPixels() const
+    {
+        return _pixels;
+    }
+
     /// @brief Gets the width of the texture
     /// @details Gets the width of the texture
     int getWidth() const
@@ -290,6 +367,100 @@ private:
     Color *_pixels;
 };
 
+/// @brief A per pixel depth buffer, the same size as the texture it is drawn alongside
+/// @details Stores 1/w of the closest surface drawn so far, so larger is closer -- 1/w is linear in screen space, so
+/// @details interpolating it across a triangle gives perspective correct depth
+/// @details Cleared to 0, which is infinitely far away, so that clearing is a single memset
+class DepthBuffer
+{
+public:
+    /// @brief Default constructor
+    /// @details Initializes the depth buffer to a cleared 1x1 buffer
+    DepthBuffer() : DepthBuffer(1, 1) {}
+
+    /// @brief Constructor
+    /// @details Initializes the depth buffer to a cleared buffer of the given size
+    DepthBuffer(int width, int height) : _width(width), _height(height), _depths(new float[width * height])
+    {
+        this->clear();
+    }
+
+    DepthBuffer(const DepthBuffer &buffer) = delete;
+    DepthBuffer &operator=(const DepthBuffer &buffer) = delete;
+
+    /// @brief Pushes every pixel infinitely far away
+    void clear()
+    {
+        memset(this->_depths.get(), 0, this->_width * this->_height * sizeof(float));
+    }
+
+    /// @brief Pushes the pixels inside the given rectangle infinitely far away
+    void clear(const Rect &rect)
+    {
+        Rect clipped = rect.intersect(Rect(0, 0, this->_width, this->_height));
+        for (int y = clipped.minY; y < clipped.maxY; y++)
+        {
+            float *row = this->_depths.get() + y * this->_width;
+            std::fill(row + clipped.minX, row + clipped.maxX, 0.0f);
+        }
+    }
+
+    /// @brief Gets the depth (1/w) at the given coordinates
+    float get(int x, int y) const
+    {
+        return this->_depths[y * this->_width + x];
+    }
+
+    /// @brief Returns true if a surface at the given depth is in front of everything drawn at the given coordinates
+    /// @details Does not write the depth -- for lines drawn on top of surfaces
+    bool test(int x, int y, float invW) const
+    {
+        return invW >= this->_depths[y * this->_width + x];
+    }
+
+    /// @brief Writes the given depth if it is in front of everything drawn at the given coordinates
+    /// @return True if the depth was written, and the pixel should be drawn
+    bool testAndSet(int x, int y, float invW)
+    {
+        float &depth = this->_depths[y * this->_width + x];
+        if (invW > depth)
+        {
+            depth = invW;
+            return true;
+        }
+        return false;
+    }
+
+    /// @brief Gets the depths, row after row -- for writers that do their own bounds checks
+    float *getDepths()
+    {
+        return this->_depths.get();
+    }
+
+    /// @brief Gets the width of the depth buffer
+    int getWidth() const
+    {
+        return this->_width;
+    }
+
+    /// @brief Gets the height of the depth buffer
+    int getHeight() const
+    {
+        return this->_height;
+    }
+
+    std::string toString() const
+    {
+        std::stringstream ss;
+        ss << "DepthBuffer(" << this->_width << ", " << this->_height << ")";
+        return ss.str();
+    }
+
+private:
+    int _width, _height;
+    std::unique_ptr<float[]> _depths;
+};
+
 /// @brief A class that is responsible for drawing on a texture
 class TextureDrawer
 {
@@ -298,6 +469,28 @@ public:
     TextureDrawer() : _texture(std::shared_ptr<Texture>()) {}
     TextureDrawer(std::shared_ptr<Texture> texture) : _texture(texture) {}
 
+    /// @brief Constructor
+    /// @details The depth buffer must be the same size as the texture -- only the depth tested methods use it
+    TextureDrawer(std::shared_ptr<Texture> texture, std::shared_ptr<DepthBuffer> depth) : _texture(texture), _depth(depth) {}
+
+    /// @brief How much closer a line is treated as than it is, so that the edges of a surface win against the surface
+    static constexpr float LINE_DEPTH_BIAS = 1.01f;
+
+    /// @brief Restricts every following draw to the given rectangle
+    /// @details Lines are still stepped from end to end, so that a line drawn in pieces, one rectangle at a time, lights
+    /// @details exactly the pixels that it would have lit in one go
+    void setScissor(const Rect &rect)
+    {
+        this->_scissor = rect;
+        this->_hasScissor = true;
+    }
+
+    /// @brief Lets the following draws cover the whole texture again
+    void clearScissor()
+    {
+        this->_hasScissor = false;
+    }
+
     /// @brief Draws a line on the texture
     /// @details Draws a line on the texture
     /// @param x1 The x coordinate of the first point
@@ -316,7 +509,7 @@ public:
         int err = dx - dy;
         while (true)
         {
-            _texture->set(x1, y1, c);
+            this->plot(x1, y1, c);
             if (x1 == x2 && y1 == y2)
             {
                 break;
@@ -342,7 +535,61 @@ public:
     /// @param c The color of the line
     void drawLine(const Vec &p1, const Vec &p2, const Color &c)
     {
-        drawLine(p1.x, p1.y, p2.x, p2.y, c);
+        Vec a = p1, b = p2;
+        if (!this->clipLine(a, b))
+        {
+            return;
+        }
+        drawLine((int)a.x, (int)a.y, (int)b.x, (int)b.y, c);
+    }
+
+    /// @brief Draws a depth tested line on the texture
+    /// @details The line does not write depth; it is biased towards the camera by LINE_DEPTH_BIAS, so that the edges of
+    /// @details a surface are drawn on top of it, while the edges of hidden surfaces stay hidden
+    /// @param p1 The first point -- w holds 1/w
+    /// @param p2 The second point -- w holds 1/w
+    /// @param c The color of the line
+    void drawLineDepth(const Vec &p1, const Vec &p2, const Color &c)
+    {
+        Vec a = p1, b = p2;
+        if (!this->clipLine(a, b))
+        {
+            return;
+        }
+
+        // Bresenham's line algorithm, stepping 1/w along with it -- it is linear in screen space
+        int x1 = (int)a.x, y1 = (int)a.y, x2 = (int)b.x, y2 = (int)b.y;
+        int dx = std::abs(x2 - x1);
+        int dy = std::abs(y2 - y1);
+        int sx = x1 < x2 ? 1 : -1;
+        int sy = y1 < y2 ? 1 : -1;
+        int err = dx - dy;
+        int steps = std::max(dx, dy);
+        float invW = a.w * LINE_DEPTH_BIAS;
+        float invWStep = steps > 0 ? (b.w - a.w) * LINE_DEPTH_BIAS / (float)steps : 0.0f;
+        while (true)
+        {
+            if (this->inScissor(x1, y1) && this->_depth->test(x1, y1, invW))
+            {
+                _texture->set(x1, y1, c);
+            }
+            if (x1 == x2 && y1 == y2)
+            {
+                break;
+            }
+            int e2 = 2 * err;
+            if (e2 > -dy)
+            {
+                err -= dy;
+                x1 += sx;
+            }
+            if (e2 < dx)
+            {
+                err += dx;
+                y1 += sy;
+            }
+            invW += invWStep;
+        }
     }
 
     /// @brief Draws a triangle outline on the texture
@@ -358,13 +605,46 @@ public:
         drawLine(p3, p1, c);
     }
 
+    /// @brief Draws a depth tested triangle outline on the texture
+    /// @details The w of each point holds 1/w
+    void drawTriangleDepth(const Vec &p1, const Vec &p2, const Vec &p3, const Color &c)
+    {
+        drawLineDepth(p1, p2, c);
+        drawLineDepth(p2, p3, c);
+        drawLineDepth(p3, p1, c);
+    }
+
+    /// @brief Draws a filled, depth tested triangle on the texture
+    /// @details Covers the pixels whose centers are inside the triangle, and only writes the ones that pass the depth
+    /// @details test -- depth is the plane of 1/w through the three points, which is perspective correct
+    /// @param p1 The first point -- w holds 1/w
+    /// @param p2 The second point -- w holds 1/w
+    /// @param p3 The third point -- w holds 1/w
+    /// @param c The color of the triangle
+    void fillTriangleDepth(const Vec &p1, const Vec &p2, const Vec &p3, const Color &c)
+    {
+        this->rasterize(p1, p2, p3, c, true);
+    }
+
     /// @brief Draws a filled triangle on the texture
-    /// @details Draws a filled triangle on the texture
+    /// @details Half-space rasterization -- covers the pixels whose centers are inside the triangle, with a top-left
+    /// @details fill rule, so that triangles sharing an edge never both cover a pixel on it
     /// @param p1 The first point
     /// @param p2 The second point
     /// @param p3 The third point
     /// @param c The color of the triangle
     void fillTriangle(const Vec &p1, const Vec &p2, const Vec &p3, const Color &c)
+    {
+        this->rasterize(p1, p2, p3, c, false);
+    }
+
+    /// @brief Draws a filled triangle on the texture, one horizontal line at a time
+    /// @details The scanline fill that fillTriangle replaced -- kept to compare against
+    /// @param p1 The first point
+    /// @param p2 The second point
+    /// @param p3 The third point
+    /// @param c The color of the triangle
+    void fillTriangleScanline(const Vec &p1, const Vec &p2, const Vec &p3, const Color &c)
     {
         // order the points by y
         Vec orderedPoints[3] = {p1, p2, p3};
@@ -425,10 +705,10 @@ public:
         int cx = 0;
         int cy = r;
 
-        _texture->set(x, y + r, c);
-        _texture->set(x, y - r, c);
-        _texture->set(x + r, y, c);
-        _texture->set(x - r, y, c);
+        this->plot(x, y + r, c);
+        this->plot(x, y - r, c);
+        this->plot(x + r, y, c);
+        this->plot(x - r, y, c);
 
         while (cx < cy)
         {
@@ -442,14 +722,14 @@ public:
             ddF_x += 2;
             f += ddF_x;
 
-            _texture->set(x + cx, y + cy, c);
-            _texture->set(x - cx, y + cy, c);
-            _texture->set(x + cx, y - cy, c);
-            _texture->set(x - cx, y - cy, c);
-            _texture->set(x + cy, y + cx, c);
-            _texture->set(x - cy, y + cx, c);
-            _texture->set(x + cy, y - cx, c);
-            _texture->set(x - cy, y - cx, c);
+            this->plot(x + cx, y + cy, c);
+            this->plot(x - cx, y + cy, c);
+            this->plot(x + cx, y - cy, c);
+            this->plot(x - cx, y - cy, c);
+            this->plot(x + cy, y + cx, c);
+            this->plot(x - cy, y + cx, c);
+            this->plot(x + cy, y - cx, c);
+            this->plot(x - cy, y - cx, c);
         }
     }
 
@@ -482,7 +762,7 @@ public:
         // draw the horizontal lines
         for (int i = y - r; i <= y + r; i++)
         {
-            _texture->set(x, i, c);
+            this->plot(x, i, c);
         }
 
         while (cx < cy)
@@ -500,13 +780,13 @@ public:
             // draw the horizontal lines
             for (int i = y - cy; i <= y + cy; i++)
             {
-                _texture->set(x + cx, i, c);
-                _texture->set(x - cx, i, c);
+                this->plot(x + cx, i, c);
+                this->plot(x - cx, i, c);
             }
             for (int i = y - cx; i <= y + cx; i++)
             {
-                _texture->set(x + cy, i, c);
-                _texture->set(x - cy, i, c);
+                this->plot(x + cy, i, c);
+                this->plot(x - cy, i, c);
             }
         }
     }
@@ -531,6 +811,106 @@ public:
 
 private:
     std::shared_ptr<Texture> _texture;
+    std::shared_ptr<DepthBuffer> _depth;
+    Rect _scissor;
+    bool _hasScissor = false;
+
+    /// @brief Returns true if the scissor lets the given pixel through
+    bool inScissor(int x, int y) const
+    {
+        return !this->_hasScissor || this->_scissor.contains(x, y);
+    }
+
+    /// @brief Sets a pixel, if the scissor lets it through
+    void plot(int x, int y, const Color &c)
+    {
+        if (this->inScissor(x, y))
+        {
+            _texture->set(x, y, c);
+        }
+    }
+
+    /// @brief Sets the triangle up, and hands it to the raster kernels along with the rows of the texture
+    void rasterize(const Vec &p1, const Vec &p2, const Vec &p3, const Color &c, bool depthTest)
+    {
+        const int width = this->_texture->getWidth(), height = this->_texture->getHeight();
+        RasterTriangle triangle;
+        if (!triangle.setup(p1, p2, p3, width, height))
+        {
+            return;
+        }
+        if (this->_hasScissor && !triangle.clip(this->_scissor.minX, this->_scissor.minY, this->_scissor.maxX - 1, this->_scissor.maxY - 1))
+        {
+            return;
+        }
+
+        static_assert(sizeof(Color) == sizeof(uint32_t), "the raster kernels write colors as 32 bit words");
+        uint32_t color;
+        memcpy(&color, &c, sizeof(color));
+        RasterTarget target(reinterpret_cast<uint32_t *>(this->_texture->getPixels()),
+                            depthTest ? this->_depth->getDepths() : nullptr, width, height);
+        RasterKernels::fill(triangle, target, color);
+    }
+
+    /// @brief Clips a line to the texture (Liang-Barsky), so that drawing it only walks pixels on the texture
+    /// @details Lines that are entirely on the texture are left untouched; the other components of the points are
+    /// @details interpolated along with x and y
+    /// @return False if no part of the line is on the texture
+    bool clipLine(Vec &p1, Vec &p2) const
+    {
+        const float x1 = p1.x, y1 = p1.y, x2 = p2.x, y2 = p2.y;
+        // anything that truncates to a pixel on the texture
+        const float minX = 0.0f, minY = 0.0f;
+        const float maxX = (float)this->_texture->getWidth() - 0.001f;
+        const float maxY = (float)this->_texture->getHeight() - 0.001f;
+        bool inside1 = x1 >= minX && x1 <= maxX && y1 >= minY && y1 <= maxY;
+        bool inside2 = x2 >= minX && x2 <= maxX && y2 >= minY && y2 <= maxY;
+        if (inside1 && inside2)
+        {
+            return true;
+        }
+
+        float dx = x2 - x1, dy = y2 - y1;
+        float t0 = 0.0f, t1 = 1.0f;
+        const float p[4] = {-dx, dx, -dy, dy};
+        const float q[4] = {x1 - minX, maxX - x1, y1 - minY, maxY - y1};
+        for (int i = 0; i < 4; i++)
+        {
+            if (p[i] == 0.0f)
+            {
+                // parallel to this edge -- either entirely outside of it, or no constraint
+                if (q[i] < 0.0f)
+                {
+                    return false;
+                }
+                continue;
+            }
+            float t = q[i] / p[i];
+            if (p[i] < 0.0f)
+            {
+                t0 = std::max(t0, t);
+            }
+            else
+            {
+                t1 = std::min(t1, t);
+            }
+            if (!(t0 <= t1))
+            {
+                return false;
+            }
+        }
+
+        const Vec start = p1, delta = p2 - p1;
+        if (t1 < 1.0f)
+        {
+            p2 = start + delta * t1;
+        }
+        if (t0 > 0.0f)
+        {
+            p1 = start + delta * t0;
+        }
+        return true;
+    }
 };
 
 #endif // __TEX_H__
\ No newline at end of file
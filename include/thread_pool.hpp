@@ -0,0 +1,176 @@
+#ifndef __THREAD_POOL_H__
+#define __THREAD_POOL_H__
+
+// Header file for the thread pool
+// A fixed set of worker threads that run parallel loops, with the calling thread working alongside them
+
+// notes for development:
+// - one loop runs at a time, and parallelFor only returns once every index has been run
+// - indices are handed out one at a time from an atomic counter, so uneven work balances itself
+// - nothing is allocated per loop -- the loop body is passed by pointer, not through a std::function
+
+// Dependencies
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// @brief A fixed size pool of threads for running parallel loops
+/// @details The calling thread is one of the threads -- a pool of 1 thread runs every loop inline, without workers
+class ThreadPool
+{
+public:
+    /// @brief Constructor
+    /// @param threadCount The number of threads that run each loop, including the calling thread -- 0 for one per
+    /// @param threadCount hardware thread
+    explicit ThreadPool(int threadCount = 0) : _run(nullptr), _context(nullptr), _count(0), _threadLimit(0), _next(0), _busy(0),
+                                               _generation(0), _stopping(false)
+    {
+        if (threadCount <= 0)
+        {
+            threadCount = (int)std::thread::hardware_concurrency();
+        }
+        threadCount = threadCount > 0 ? threadCount : 1;
+        for (int i = 1; i < threadCount; i++)
+        {
+            this->_workers.emplace_back(&ThreadPool::workerLoop, this, i);
+        }
+    }
+
+    ThreadPool(const ThreadPool &pool) = delete;
+    ThreadPool &operator=(const ThreadPool &pool) = delete;
+
+    /// @brief Destructor
+    /// @details Waits for the workers to finish and joins them
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(this->_mutex);
+            this->_stopping = true;
+        }
+        this->_wake.notify_all();
+        for (std::thread &worker : this->_workers)
+        {
+            worker.join();
+        }
+    }
+
+    /// @brief Runs func(index, threadIndex) for every index in [0, count), spread over the threads of the pool
+    /// @details Blocks until every index has run; threadIndex is in [0, getThreadCount()), and 0 is the calling thread
+    /// @param threadLimit The most threads that run the loop, including the calling thread -- 0 for every thread, 1 to
+    /// @param threadLimit run the loop inline, in order
+    template <typename Func>
+    void parallelFor(int count, Func &func, int threadLimit = 0)
+    {
+        if (count <= 0)
+        {
+            return;
+        }
+        if (this->_workers.empty() || count == 1 || threadLimit == 1)
+        {
+            for (int i = 0; i < count; i++)
+            {
+                func(i, 0);
+            }
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(this->_mutex);
+            this->_run = &ThreadPool::invoke<Func>;
+            this->_context = &func;
+            this->_count = count;
+            this->_threadLimit = threadLimit > 0 ? threadLimit : this->getThreadCount();
+            this->_next.store(0);
+            this->_busy = (int)this->_workers.size();
+            this->_generation++;
+        }
+        this->_wake.notify_all();
+
+        this->runIndices(0);
+
+        std::unique_lock<std::mutex> lock(this->_mutex);
+        this->_done.wait(lock, [this]()
+                         { return this->_busy == 0; });
+    }
+
+    /// @brief Returns the number of threads that run each loop, including the calling thread
+    int getThreadCount() const
+    {
+        return (int)this->_workers.size() + 1;
+    }
+
+    std::string toString() const
+    {
+        std::stringstream ss;
+        ss << "ThreadPool(threads: " << this->getThreadCount() << ")";
+        return ss.str();
+    }
+
+private:
+    std::vector<std::thread> _workers;
+    std::mutex _mutex;
+    std::condition_variable _wake; // a loop has started, or the pool is stopping
+    std::condition_variable _done; // every worker has finished the loop
+
+    // the loop that is running
+    void (*_run)(void *context, int index, int threadIndex);
+    void *_context;
+    int _count;
+    int _threadLimit; // workers at or past this thread index sit the loop out
+    std::atomic<int> _next; // the next index to hand out
+    int _busy;              // workers that have not finished the loop yet
+    uint64_t _generation;   // bumped for every loop, so that workers can tell a new loop from a spurious wake up
+    bool _stopping;
+
+    template <typename Func>
+    static void invoke(void *context, int index, int threadIndex)
+    {
+        (*static_cast<Func *>(context))(index, threadIndex);
+    }
+
+    /// @brief Runs indices of the current loop until there are none left
+    void runIndices(int threadIndex)
+    {
+        int index;
+        while ((index = this->_next.fetch_add(1)) < this->_count)
+        {
+            this->_run(this->_context, index, threadIndex);
+        }
+    }
+
+    void workerLoop(int threadIndex)
+    {
+        uint64_t seen = 0;
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(this->_mutex);
+                this->_wake.wait(lock, [this, seen]()
+                                 { return this->_stopping || this->_generation != seen; });
+                if (this->_stopping)
+                {
+                    return;
+                }
+                seen = this->_generation;
+            }
+
+            if (threadIndex < this->_threadLimit)
+            {
+                this->runIndices(threadIndex);
+            }
+
+            std::lock_guard<std::mutex> lock(this->_mutex);
+            if (--this->_busy == 0)
+            {
+                this->_done.notify_one();
+            }
+        }
+    }
+};
+
+#endif // __THREAD_POOL_H__
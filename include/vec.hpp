@@ -6,11 +6,15 @@
 
 #include <string>
 #include <sstream>
+#include <stdexcept>
 #include <math.h>
 
+#include "simd.hpp"
+
 /// @brief A compact representation of a vector
 /// @details A vector is represented by 4 floats, one for each dimension
-struct Vec
+/// @details Aligned to 16 bytes so that the SIMD kernels can load it in one go
+struct alignas(16) Vec
 {
     float x, y, z, w;
 
@@ -25,7 +29,7 @@ struct Vec
 
     /// @brief Copy constructor
     /// @details Initializes the vector to the given vector
-    Vec(const Vec &v) : x(v.x), y(v.y), z(v.z), w(v.w) {}
+    Vec(const Vec &v) = default;
 #pragma endregion
 
 #pragma region Static Vec Methods
@@ -101,29 +105,27 @@ struct Vec
     /// @brief Returns the length of this vector
     float length() const
     {
-        return sqrt(this->x * this->x + this->y * this->y + this->z * this->z + this->w * this->w);
+        return sqrt(this->lengthSquared());
     }
 
     /// @brief Returns the squared length of this vector
     float lengthSquared() const
     {
-        return this->x * this->x + this->y * this->y + this->z * this->z + this->w * this->w;
+        return VecKernels::dot(&this->x, &this->x);
     }
 
     /// @brief Returns the dot product of this vector and the given vector
     float dot(const Vec &v) const
     {
-        return this->x * v.x + this->y * v.y + this->z * v.z + this->w * v.w;
+        return VecKernels::dot(&this->x, &v.x);
     }
 
     /// @brief Returns the cross product of this vector and the given vector
     Vec cross(const Vec &v) const
     {
-        return Vec(
-            this->y * v.z - this->z * v.y,
-            this->z * v.x - this->x * v.z,
-            this->x * v.y - this->y * v.x,
-            0.0f);
+        Vec result;
+        VecKernels::cross(&this->x, &v.x, &result.x);
+        return result;
     }
 
     /// @brief Returns the normalized version of this vector
@@ -163,30 +165,19 @@ struct Vec
 #pragma region Operation Overloads
     /// @brief Assignment operator
     /// @details Assigns the vector to the given vector
-    Vec &operator=(const Vec &v)
-    {
-        this->x = v.x;
-        this->y = v.y;
-        this->z = v.z;
-        this->w = v.w;
-        return *this;
-    }
+    Vec &operator=(const Vec &v) = default;
 
     /// @brief Index operator
-    /// @details Returns the element at the given index
+    /// @details Returns the element at the given index -- unchecked, use at() for a bounds checked access
     float operator[](int index) const
     {
-        return this->at(index);
+        return (&this->x)[index];
     }
 
     /// @brief Index operator
-    /// @details Returns the element at the given index
+    /// @details Returns the element at the given index -- unchecked, use at() for a bounds checked access
     float &operator[](int index)
     {
-        if (index < 0 || index > 3)
-        {
-            throw std::runtime_error("Index out of bounds");
-        }
         return (&this->x)[index];
     }
 
@@ -194,52 +185,61 @@ struct Vec
     /// @details Adds the given vector to this vector
     Vec operator+(const Vec &v) const
     {
-        return Vec(this->x + v.x, this->y + v.y, this->z + v.z, this->w + v.w);
+        Vec result;
+        VecKernels::add(&this->x, &v.x, &result.x);
+        return result;
     }
 
     /// @brief Subtraction operator
     /// @details Subtracts the given vector from this vector
     Vec operator-(const Vec &v) const
     {
-        return Vec(this->x - v.x, this->y - v.y, this->z - v.z, this->w - v.w);
+        Vec result;
+        VecKernels::sub(&this->x, &v.x, &result.x);
+        return result;
     }
 
     /// @brief Multiplication operator
     /// @details Multiplies this vector by the given scalar
     Vec operator*(float scalar) const
     {
-        return Vec(this->x * scalar, this->y * scalar, this->z * scalar, this->w * scalar);
+        Vec result;
+        VecKernels::scale(&this->x, scalar, &result.x);
+        return result;
     }
 
     /// @brief Multiplication operator
     /// @details Multiplies this vector by the given vector element-wise
     Vec operator*(Vec v) const
     {
-        return Vec(this->x * v.x, this->y * v.y, this->z * v.z, this->w * v.w);
+        Vec result;
+        VecKernels::mul(&this->x, &v.x, &result.x);
+        return result;
     }
 
     /// @brief Division operator
     /// @details Divides this vector by the given scalar
     Vec operator/(float scalar) const
     {
-        return Vec(this->x / scalar, this->y / scalar, this->z / scalar, this->w / scalar);
+        Vec result;
+        VecKernels::divScalar(&this->x, scalar, &result.x);
+        return result;
     }
 
     /// @brief Division operator
     /// @details Divides this vector by the given vector element-wise
     Vec operator/(Vec v) const
     {
-        return Vec(this->x / v.x, this->y / v.y, this->z / v.z, this->w / v.w);
+        Vec result;
+        VecKernels::div(&this->x, &v.x, &result.x);
+        return result;
     }
 
     /// @brief Addition assignment operator
     /// @details Adds the given vector to this vector
     Vec &operator+=(const Vec &v)
     {
-        this->x += v.x;
-        this->y += v.y;
-        this->z += v.z;
-        this->w += v.w;
+        VecKernels::add(&this->x, &v.x, &this->x);
         return *this;
     }
 
@@ -247,10 +247,7 @@ struct Vec
     /// @details Subtracts the given vector from this vector
     Vec &operator-=(const Vec &v)
     {
-        this->x -= v.x;
-        this->y -= v.y;
-        this->z -= v.z;
-        this->w -= v.w;
+        VecKernels::sub(&this->x, &v.x, &this->x);
         return *this;
     }
 
@@ -258,10 +255,7 @@ struct Vec
     /// @details Multiplies this vector by the given scalar
     Vec &operator*=(float scalar)
     {
-        this->x *= scalar;
-        this->y *= scalar;
-        this->z *= scalar;
-        this->w *= scalar;
+        VecKernels::scale(&this->x, scalar, &this->x);
         return *this;
     }
 
@@ -269,10 +263,7 @@ struct Vec
     /// @details Multiplies this vector by the given vector element-wise
     Vec &operator*=(Vec v)
     {
-        this->x *= v.x;
-        this->y *= v.y;
-        this->z *= v.z;
-        this->w *= v.w;
+        VecKernels::mul(&this->x, &v.x, &this->x);
         return *this;
     }
 
@@ -280,10 +271,7 @@ struct Vec
     /// @details Divides this vector by the given scalar
     Vec &operator/=(float scalar)
     {
-        this->x /= scalar;
-        this->y /= scalar;
-        this->z /= scalar;
-        this->w /= scalar;
+        VecKernels::divScalar(&this->x, scalar, &this->x);
         return *this;
     }
 
@@ -291,10 +279,7 @@ struct Vec
     /// @details Divides this vector by the given vector element-wise
     Vec &operator/=(Vec v)
     {
-        this->x /= v.x;
-        this->y /= v.y;
-        this->z /= v.z;
-        this->w /= v.w;
+        VecKernels::div(&this->x, &v.x, &this->x);
         return *this;
     }
 
@@ -9,11 +9,12 @@
 #include "display.hpp"
 #include "runtime_input.hpp"
 #include "render.hpp"
+#include "camera.hpp"
 
 
 Controls App::controls = Controls();
 
-App::App()
+App::App() : _stopping(false), _exitCode(0), _displayStopped(false)
 {
     // get the height and width of the console
     CONSOLE_SCREEN_BUFFER_INFO csbi;
@@ -23,7 +24,7 @@ App::App()
     this->OUTPUT_WIDTH = csbi.srWindow.Right - csbi.srWindow.Left;
 
     // initialize the display
-    this->_display = AsciiDisplay(this->OUTPUT_WIDTH, this->OUTPUT_HEIGHT);
+    this->_display = std::make_shared<AsciiDisplay>(this->OUTPUT_WIDTH, this->OUTPUT_HEIGHT);
 }
 
 void App::init()
@@ -44,7 +45,8 @@ void App::run()
 
     // create the transform node
     std::shared_ptr<Mesh> meshPtr = std::make_shared<Mesh>(mesh);
-    RenderInfo renderInfo = RenderInfo(meshPtr);
+    // the quads spin, and are seen from both sides
+    RenderInfo renderInfo = RenderInfo(meshPtr, CULL_NONE);
     std::shared_ptr<TransformNode> transformNode = std::make_shared<TransformNode>(Transform(), renderInfo);
     // translate the transform node
     transformNode->transform.move(Vec(3.0f, 0.0f, -25.0f));
@@ -59,47 +61,92 @@ void App::run()
 
     // create the transform node
     std::shared_ptr<Mesh> meshPtr2 = std::make_shared<Mesh>(mesh2);
-    RenderInfo renderInfo2 = RenderInfo(meshPtr2);
+    RenderInfo renderInfo2 = RenderInfo(meshPtr2, CULL_NONE);
     std::shared_ptr<TransformNode> transformNode2 = std::make_shared<TransformNode>(Transform(), renderInfo2);
     // translate the transform node
     transformNode2->transform.move(Vec(-3.0f, 0.0f, -15.0f));
     // add the transform node to the scene graph
     sceneGraph.addChild(transformNode2);
 
+    // the camera -- WASD moves it along the ground, the mouse turns it
+    const float moveSpeed = 0.05f;
+    const float lookSpeed = 0.002f;
+    std::shared_ptr<Camera> camera = std::make_shared<Camera>(settings.fov, settings.nearPlane, settings.farPlane);
+    sceneGraph.addChild(camera);
+    renderer.setCamera(camera);
+    App::controls.addAxisCallback(App::controls.MoveAxis, [camera, moveSpeed](Vec axis)
+                                  { camera->moveLocal(Vec(axis.x, 0.0f, -axis.y) * moveSpeed); });
+    // the mouse axis is the position of the cursor, so the camera turns by how far it moved since the last frame
+    Vec lastMouse = CommandLineListener::getMousePosition();
+    App::controls.addAxisCallback(App::controls.LookAxis, [camera, lookSpeed, lastMouse](Vec mouse) mutable
+                                  {
+        Vec delta = mouse - lastMouse;
+        lastMouse = mouse;
+        camera->look(-delta.x * lookSpeed, -delta.y * lookSpeed); });
+
     // std::cout << "Created scene graph\n";
     Quaternion rotationQuaternion = Quaternion::fromAxisAngle(Vec(0.0f, 1.0f, 0.0f), 0.002f);
     Quaternion childQuaternion = Quaternion::fromAxisAngle(Vec(1.0f, 0.0f, 0.0f), -0.002f);
     Quaternion rotationQuaternion2 = Quaternion::fromAxisAngle(Vec(1.0f, 1.0f, 1.0f), -0.0002f);
 
 
-    // update loop
-    while (true)
+    // the display draws on the presenter thread from here on
+    this->_presenter.reset(new DisplayPresenter(this->_display));
+
+    // update loop -- runs until onExit() asks it to stop
+    while (!this->_stopping.load())
     {
-        _display.prepare();
         renderer.prepare();
         // create the displayer
         this->_inputListener->listen();
         // render the scene graph
         renderer.render(sceneGraph);
 
-        // draw the output
-        this->_display.draw(*renderer.getOutput());
+        // hand the output over to the presenter -- only the parts that changed are converted, and a frame that the
+        // terminal could not keep up with is dropped
+        this->_presenter->submit(*renderer.getOutput(), renderer.getDirtyRects());
 
         transformNode->transform.rotate(rotationQuaternion);
         childNode->transform.rotate(childQuaternion);
         transformNode2->transform.rotate(rotationQuaternion2);
     }
+
+    // joins the presenter on this thread, once it is no longer handed frames
+    this->stopDisplay();
 }
 
 void App::onExit(int exitCode)
 {
-    // cleanup
-    this->_display.cleanup();
-    exit(exitCode);
+    // only flags the loop -- the presenter may be in the middle of a frame, so it is stopped by run()
+    this->_exitCode = exitCode;
+    this->_stopping.store(true);
+}
+
+int App::getExitCode() const
+{
+    return this->_exitCode;
 }
 
 App::~App()
 {
     // cleanup
-    this->_display.cleanup();
+    this->stopDisplay();
+}
+
+void App::stopDisplay()
+{
+    if (this->_displayStopped)
+    {
+        return;
+    }
+    this->_displayStopped = true;
+
+    if (this->_presenter != nullptr)
+    {
+        this->_presenter.reset();
+    }
+    else
+    {
+        this->_display->cleanup();
+    }
 }
\ No newline at end of file
@@ -24,5 +24,5 @@ int main() {
     // run the app
     app.run();
 
-    return 0;
+    return app.getExitCode();
 }
@@ -2,10 +2,2315 @@
 // - cook up a testing framework
 // - either that or use a pre-existing one -- idk if that would go against the "dependency-free" thing
 // - look up how to build a unit testing framework
+// - for now, every test is a function that returns the number of failed checks
 
 #include <iostream>
+#include <random>
+#include <atomic>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#endif
 
-int main() {
-    std::cout << "Hello World" << std::endl;
-    return 0;
+#include "simd.hpp"
+#include "vec.hpp"
+#include "matrix.hpp"
+#include "mesh.hpp"
+#include "arena.hpp"
+#include "raster.hpp"
+#include "thread_pool.hpp"
+#include "camera.hpp"
+#include "render.hpp"
+#include "display.hpp"
+#include "presenter.hpp"
+
+#define CHECK(condition)                                                              \
+    if (!(condition))                                                                 \
+    {                                                                                 \
+        std::cout << "  FAILED: " #condition " (" << __FILE__ << ":" << __LINE__ << ")\n"; \
+        failures++;                                                                   \
+    }
+
+static bool bitEqual(const float *a, const float *b, int count)
+{
+    return memcmp(a, b, sizeof(float) * count) == 0;
+}
+
+/// @brief Checks that the compile-time selected kernels are bit-exact with the scalar reference kernels
+int testKernelsMatchScalarReference()
+{
+    int failures = 0;
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> dist(-100.0f, 100.0f);
+
+    for (int iteration = 0; iteration < 1000; iteration++)
+    {
+        float a[16], b[16], expected[16], actual[16];
+        for (int i = 0; i < 16; i++)
+        {
+            a[i] = dist(rng);
+            b[i] = dist(rng);
+        }
+
+        ScalarKernels::add(a, b, expected);
+        VecKernels::add(a, b, actual);
+        CHECK(bitEqual(expected, actual, 4));
+
+        ScalarKernels::sub(a, b, expected);
+        VecKernels::sub(a, b, actual);
+        CHECK(bitEqual(expected, actual, 4));
+
+        ScalarKernels::mul(a, b, expected);
+        VecKernels::mul(a, b, actual);
+        CHECK(bitEqual(expected, actual, 4));
+
+        ScalarKernels::div(a, b, expected);
+        VecKernels::div(a, b, actual);
+        CHECK(bitEqual(expected, actual, 4));
+
+        ScalarKernels::scale(a, b[0], expected);
+        VecKernels::scale(a, b[0], actual);
+        CHECK(bitEqual(expected, actual, 4));
+
+        ScalarKernels::divScalar(a, b[0], expected);
+        VecKernels::divScalar(a, b[0], actual);
+        CHECK(bitEqual(expected, actual, 4));
+
+        expected[0] = ScalarKernels::dot(a, b);
+        actual[0] = VecKernels::dot(a, b);
+        CHECK(bitEqual(expected, actual, 1));
+
+        ScalarKernels::cross(a, b, expected);
+        VecKernels::cross(a, b, actual);
+        CHECK(bitEqual(expected, actual, 4));
+
+        ScalarKernels::matVec(a, b, expected);
+        VecKernels::matVec(a, b, actual);
+        CHECK(bitEqual(expected, actual, 4));
+
+        ScalarKernels::matMat(a, b, expected);
+        VecKernels::matMat(a, b, actual);
+        CHECK(bitEqual(expected, actual, 16));
+    }
+
+    return failures;
+}
+
+/// @brief Checks that the batched transforms are bit-exact with transforming one vertex at a time
+int testBatchTransformMatchesMatVec()
+{
+    int failures = 0;
+    std::mt19937 rng(99);
+    std::uniform_real_distribution<float> dist(-100.0f, 100.0f);
+
+    Matrix m;
+    for (int i = 0; i < 16; i++)
+    {
+        m.elements[i] = dist(rng);
+    }
+
+    // odd count, so that the scalar tail is exercised, and interleaved data, so that the stride is
+    const int count = 37;
+    std::vector<Vec> interleaved(count * 2);
+    for (Vec &v : interleaved)
+    {
+        v = Vec(dist(rng), dist(rng), dist(rng), dist(rng));
+    }
+
+    std::vector<Vec> points(count), normals(count);
+    m.transformPoints(&interleaved[0], &points[0], count, 2, 1);
+    m.transformNormals(&interleaved[1], &normals[0], count, 2, 1);
+
+    for (int i = 0; i < count; i++)
+    {
+        Vec expected = m * interleaved[i * 2];
+        CHECK(bitEqual(&expected.x, &points[i].x, 4));
+
+        Vec normal = interleaved[i * 2 + 1];
+        float expectedNormal[4];
+        ScalarKernels::transformNormals(m.elements, &normal.x, 4, expectedNormal, 4, 1);
+        CHECK(bitEqual(expectedNormal, &normals[i].x, 4));
+        CHECK(normals[i].w == 0.0f);
+    }
+
+    // positions and normals in one pass
+    std::vector<Vec> fused(count * 2);
+    m.transformVertices(&interleaved[0], &interleaved[1], &fused[0], &fused[1], count, 2, 2);
+    for (int i = 0; i < count; i++)
+    {
+        CHECK(bitEqual(&points[i].x, &fused[i * 2].x, 4));
+        CHECK(bitEqual(&normals[i].x, &fused[i * 2 + 1].x, 4));
+    }
+
+    // structure of arrays -- w is implicitly 1
+    std::vector<float> x(count), y(count), z(count), ox(count), oy(count), oz(count), ow(count);
+    for (int i = 0; i < count; i++)
+    {
+        x[i] = interleaved[i * 2].x;
+        y[i] = interleaved[i * 2].y;
+        z[i] = interleaved[i * 2].z;
+    }
+    VecKernels::transformPointsSoA(m.elements, x.data(), y.data(), z.data(), ox.data(), oy.data(), oz.data(), ow.data(), count);
+    for (int i = 0; i < count; i++)
+    {
+        Vec expected = m * Vec(x[i], y[i], z[i], 1.0f);
+        Vec actual(ox[i], oy[i], oz[i], ow[i]);
+        CHECK(bitEqual(&expected.x, &actual.x, 4));
+    }
+
+    // in place
+    std::vector<Vec> inPlace(interleaved);
+    m.transformPoints(&inPlace[0], &inPlace[0], count, 2, 2);
+    for (int i = 0; i < count; i++)
+    {
+        CHECK(bitEqual(&points[i].x, &inPlace[i * 2].x, 4));
+    }
+
+    return failures;
+}
+
+/// @brief Checks that an indexed mesh merges the shared corners, keeps the winding, converts back, and transforms its
+/// @brief streams like Matrix * Vec
+int testIndexedMesh()
+{
+    int failures = 0;
+
+    // a quad of two triangles that share an edge, and a third triangle on the same corners that faces the other way
+    Vec up(0, 0, 1, 0), down(0, 0, -1, 0);
+    MeshVertex a(Vec(0, 0, 0), up), b(Vec(1, 0, 0), up), c(Vec(1, 1, 0), up), d(Vec(0, 1, 0), up);
+    Mesh mesh(std::vector<Triangle>({Triangle(a, b, c), Triangle(a, c, d),
+                                     Triangle(MeshVertex(a.position, down), MeshVertex(c.position, down),
+                                              MeshVertex(b.position, down))}));
+
+    IndexedMesh indexed = IndexedMesh::fromMesh(mesh);
+    CHECK(indexed.getTriangleCount() == 3);
+    CHECK(indexed.getVertexCount() == 7);
+    CHECK(indexed.indices == std::vector<uint32_t>({0, 1, 2, 0, 2, 3, 4, 5, 6}));
+    CHECK(indexed.getMemoryUsage() == 7 * 6 * sizeof(float) + 9 * sizeof(uint32_t));
+
+    // merged by position alone, the third triangle reuses the corners of the quad, in its own winding
+    IndexedMesh positions = IndexedMesh::fromMesh(mesh, true);
+    CHECK(positions.getVertexCount() == 4);
+    CHECK(positions.indices == std::vector<uint32_t>({0, 1, 2, 0, 2, 3, 0, 2, 1}));
+    CHECK(positions.getMemoryUsage() == 4 * 6 * sizeof(float) + 9 * sizeof(uint32_t));
+
+    // back to triangles, corner for corner
+    Mesh roundTrip = indexed.toMesh();
+    CHECK(roundTrip.triangles.size() == mesh.triangles.size());
+    for (size_t i = 0; i < mesh.triangles.size() && i < roundTrip.triangles.size(); i++)
+    {
+        const Triangle &expected = mesh.triangles[i], &actual = roundTrip.triangles[i];
+        CHECK(actual.v1.position == expected.v1.position && actual.v1.normal == expected.v1.normal);
+        CHECK(actual.v2.position == expected.v2.position && actual.v2.normal == expected.v2.normal);
+        CHECK(actual.v3.position == expected.v3.position && actual.v3.normal == expected.v3.normal);
+    }
+
+    // the streams transform like the vertices they came from -- past a SIMD width, so that the tail runs too
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<float> dist(-10.0f, 10.0f);
+    IndexedMesh random;
+    for (int i = 0; i < 13; i++)
+    {
+        random.addVertex(Vec(dist(rng), dist(rng), dist(rng)), Vec(dist(rng), dist(rng), dist(rng), 0.0f));
+    }
+    Matrix m = Matrix::translation(Vec(1, 2, 3)) * Quaternion::fromAxisAngle(Vec(1, 1, 0), 0.7f).toRotationMatrix();
+    std::vector<float> x(13), y(13), z(13), w(13), nx(13), ny(13), nz(13);
+    random.transformPositions(m, x.data(), y.data(), z.data(), w.data());
+    random.transformNormals(m, nx.data(), ny.data(), nz.data());
+    for (int i = 0; i < 13; i++)
+    {
+        MeshVertex vertex = random.getVertex(i);
+        Vec position = m * vertex.position;
+        Vec normal = m * vertex.normal;
+        CHECK(std::fabs(x[i] - position.x) < 1e-4f && std::fabs(y[i] - position.y) < 1e-4f);
+        CHECK(std::fabs(z[i] - position.z) < 1e-4f && w[i] == 1.0f);
+        CHECK(std::fabs(nx[i] - normal.x) < 1e-4f && std::fabs(ny[i] - normal.y) < 1e-4f);
+        CHECK(std::fabs(nz[i] - normal.z) < 1e-4f);
+    }
+
+    return failures;
+}
+
+/// @brief Checks the Vec and Matrix operators against hand-computed results
+int testVecMatrixOperators()
+{
+    int failures = 0;
+
+    Vec a(1, 2, 3, 4);
+    Vec b(5, 6, 7, 8);
+    CHECK(a + b == Vec(6, 8, 10, 12));
+    CHECK(b - a == Vec(4, 4, 4, 4));
+    CHECK(a * 2.0f == Vec(2, 4, 6, 8));
+    CHECK(a.dot(b) == 70.0f);
+    CHECK(Vec::right().cross(Vec::up()) == Vec::forward());
+    CHECK(a[2] == 3.0f);
+
+    // aliasing -- the kernels must read everything before writing
+    Vec c = a;
+    c += c;
+    CHECK(c == Vec(2, 4, 6, 8));
+
+    Matrix translation = Matrix::translation(Vec(1, 2, 3));
+    CHECK(translation * Vec(1, 1, 1) == Vec(2, 3, 4, 1));
+    CHECK(translation * Matrix() == translation);
+
+    Matrix product = translation;
+    product *= translation;
+    CHECK(product * Vec(0, 0, 0) == Vec(2, 4, 6, 1));
+
+    return failures;
+}
+
+/// @brief Checks that Mesh::transform handles meshes past the old 10,000 triangle limit
+int testMeshTransformLargeMesh()
+{
+    int failures = 0;
+    const int count = 12345;
+    std::vector<Triangle> triangles(count);
+    for (int i = 0; i < count; i++)
+    {
+        triangles[i] = Triangle(Vec((float)i, 0, 0), Vec(0, (float)i, 0), Vec(0, 0, (float)i));
+    }
+    Mesh mesh(triangles);
+    Matrix m = Matrix::translation(Vec(1, 2, 3));
+
+    Mesh out = mesh.transform(m);
+    CHECK(out.triangles.size() == (size_t)count);
+    CHECK(out.triangles[count - 1].v1.position == Vec(count, 2, 3, 1));
+    CHECK(out.triangles[count - 1].v3.position == Vec(1, 2, count + 2, 1));
+
+    // the reused buffer shrinks and grows with the mesh
+    mesh.triangles.resize(10);
+    mesh.transform(m, out);
+    CHECK(out.triangles.size() == 10);
+    CHECK(out.triangles[9].v2.position == Vec(1, 11, 3, 1));
+
+    return failures;
+}
+
+/// @brief Checks the frame arena's alignment, reuse after reset, and growth
+int testFrameArena()
+{
+    int failures = 0;
+    FrameArena arena(256);
+
+    char *c = arena.allocate<char>(3);
+    Vec *v = arena.allocate<Vec>(4);
+    CHECK(c != nullptr);
+    CHECK(reinterpret_cast<uintptr_t>(v) % 16 == 0);
+    CHECK(arena.allocate<float>(0) == nullptr);
+    CHECK(arena.getHeapAllocations() == 1);
+
+    // overflowing the first block adds another, and reset merges them into one block big enough for both
+    Vec *big = arena.allocate<Vec>(100);
+    CHECK(reinterpret_cast<uintptr_t>(big) % 16 == 0);
+    CHECK(arena.getHeapAllocations() == 2);
+    size_t used = arena.getBytesUsed();
+    arena.reset();
+    CHECK(arena.getBytesUsed() == 0);
+    CHECK(arena.getHighWaterMark() == used);
+    size_t heapAllocations = arena.getHeapAllocations();
+
+    // the same frame again fits without going to the heap, and hands out the same memory every frame
+    for (int frame = 0; frame < 2; frame++)
+    {
+        c = arena.allocate<char>(3);
+        arena.allocate<Vec>(4);
+        big = arena.allocate<Vec>(100);
+        CHECK(arena.getHeapAllocations() == heapAllocations);
+        arena.reset();
+        CHECK(arena.allocate<char>(3) == c);
+        arena.reset();
+    }
+
+    return failures;
+}
+
+/// @brief Checks that the renderer stops growing its frame arena once it has seen a frame
+int testRendererSteadyStateAllocations()
+{
+    int failures = 0;
+    RasciiRenderer renderer(RenderSettings(40, 20, 90.0f, 0.1f, 100.0f));
+
+    // every triangle at a depth of its own, so that no corners are shared and the mesh is drawn as it is
+    std::vector<Triangle> triangles;
+    for (int i = 0; i < 5000; i++)
+    {
+        float x = (float)(i % 10) - 5.0f, z = -5.0f - 0.001f * (float)i;
+        triangles.push_back(Triangle(Vec(x, -1, z), Vec(x + 1, -1, z), Vec(x, 1, z)));
+    }
+    SceneGraph sceneGraph;
+    sceneGraph.root->renderInfo = RenderInfo(std::make_shared<Mesh>(triangles), CULL_NONE);
+
+    // the first frame grows the arena block by block, the second merges the blocks into one, and from then on
+    // nothing is allocated -- every frame is drawn in full, as nothing moves
+    for (int frame = 0; frame < 4; frame++)
+    {
+        renderer.invalidate();
+        renderer.prepare();
+        renderer.render(sceneGraph);
+        const RenderStats &stats = renderer.getStats();
+        CHECK(stats.trianglesDrawn + stats.trianglesOutside == 5000);
+        CHECK(stats.arenaBytesUsed >= 5000 * 3 * sizeof(Vec)); // the clip space corners
+        if (frame >= 2)
+        {
+            CHECK(stats.arenaHeapAllocations == 0);
+        }
+    }
+
+    return failures;
+}
+
+/// @brief Builds the world matrix of a node from scratch, the way it was done before the matrices were cached
+static Matrix uncachedWorldMatrix(const TransformNode *node)
+{
+    Matrix local = node->transform.toTransformationMatrix();
+    return node->parent == nullptr ? local : uncachedWorldMatrix(node->parent) * local;
+}
+
+/// @brief Checks that the cached world matrices follow changes anywhere up the hierarchy
+int testCachedWorldMatrices()
+{
+    int failures = 0;
+    SceneGraph sceneGraph;
+    std::vector<std::shared_ptr<TransformNode>> chain;
+    TransformNode *parent = sceneGraph.root.get();
+    for (int i = 0; i < 50; i++)
+    {
+        auto node = std::make_shared<TransformNode>();
+        node->transform.move(Vec(0.1f, 0.2f * i, -0.3f));
+        node->transform.rotate(Quaternion::fromAxisAngle(Vec(0, 1, 0), 0.05f));
+        parent->addChild(node);
+        chain.push_back(node);
+        parent = node.get();
+    }
+    // a sibling branch, which must not be affected by changes to the chain
+    auto sibling = std::make_shared<TransformNode>();
+    sibling->transform.move(Vec(1, 2, 3));
+    sceneGraph.addChild(sibling);
+
+    sceneGraph.updateWorldMatrices();
+    for (const auto &node : chain)
+    {
+        CHECK(node->getWorldMatrix() == uncachedWorldMatrix(node.get()));
+    }
+
+    // a change in the middle of the chain reaches every descendant, but nothing else
+    Matrix siblingWorld = sibling->getWorldMatrix();
+    Matrix aboveWorld = chain[19]->getWorldMatrix();
+    chain[20]->transform.rotate(Quaternion::fromAxisAngle(Vec(1, 0, 0), 0.3f));
+    CHECK(chain[20]->transform.isDirty());
+    sceneGraph.updateWorldMatrices();
+    CHECK(!chain[20]->transform.isDirty());
+    CHECK(chain[19]->getWorldMatrix() == aboveWorld);
+    CHECK(sibling->getWorldMatrix() == siblingWorld);
+    for (const auto &node : chain)
+    {
+        CHECK(node->getWorldMatrix() == uncachedWorldMatrix(node.get()));
+    }
+
+    // direct writes need markDirty, and getWorldMatrix brings the path to the root up to date on its own
+    chain[5]->transform.position = Vec(4, 5, 6);
+    chain[5]->transform.markDirty();
+    CHECK(chain[49]->getWorldMatrix() == uncachedWorldMatrix(chain[49].get()));
+
+    // the graph is destroyed here -- children no longer own their parents, so this must not double free
+    return failures;
+}
+
+/// @brief Checks that the flattened scene graph follows transform and structure changes of the authoring tree
+int testFlatSceneGraph()
+{
+    int failures = 0;
+    SceneGraph sceneGraph;
+    auto a = std::make_shared<TransformNode>();
+    auto b = std::make_shared<TransformNode>();
+    auto c = std::make_shared<TransformNode>();
+    a->transform.move(Vec(1, 0, 0));
+    b->transform.rotate(Quaternion::fromAxisAngle(Vec(0, 0, 1), 0.5f));
+    c->transform.scaleBy(2.0f);
+    sceneGraph.addChild(a);
+    a->addChild(b);
+    sceneGraph.addChild(c);
+
+    FlatSceneGraph flat;
+    CHECK(flat.update(sceneGraph));
+    CHECK(!flat.update(sceneGraph));
+
+    // depth first order, with parent indices
+    CHECK(flat.size() == 4);
+    CHECK(flat.nodes[1] == a.get() && flat.nodes[2] == b.get() && flat.nodes[3] == c.get());
+    CHECK(flat.parents[0] == -1 && flat.parents[1] == 0 && flat.parents[2] == 1 && flat.parents[3] == 0);
+    CHECK(flat.localMatrices[1] == a->transform.toTransformationMatrix());
+    CHECK(flat.localMatrices[3] == c->transform.toTransformationMatrix());
+    for (size_t i = 0; i < flat.size(); i++)
+    {
+        CHECK(flat.worldMatrices[i] == uncachedWorldMatrix(flat.nodes[i]));
+    }
+
+    // transform changes reach the descendants, and are written back to the nodes
+    a->transform.move(Vec(0, 3, 0));
+    CHECK(!flat.update(sceneGraph));
+    CHECK(flat.localMatrices[1] == a->transform.toTransformationMatrix());
+    CHECK(flat.worldMatrices[2] == uncachedWorldMatrix(b.get()));
+    CHECK(b->getWorldMatrix() == flat.worldMatrices[2]);
+
+    // a node that refreshed its own cache through the facade is still picked up
+    b->transform.move(Vec(0, 0, 1));
+    Matrix bWorld = b->getWorldMatrix();
+    flat.update(sceneGraph);
+    CHECK(flat.worldMatrices[2] == bWorld);
+
+    // structure changes rebuild the arrays
+    auto d = std::make_shared<TransformNode>();
+    b->addChild(d);
+    CHECK(flat.update(sceneGraph));
+    CHECK(flat.size() == 5);
+    CHECK(flat.nodes[3] == d.get() && flat.parents[3] == 2);
+    CHECK(flat.worldMatrices[3] == uncachedWorldMatrix(d.get()));
+
+    return failures;
+}
+
+/// @brief Checks that a new graph is flattened again, even when its root reuses the address and structure version of
+/// @brief a destroyed one -- the freed nodes may hold something else by then, here a quad in front of the camera
+int testFlatSceneGraphReusedRoot()
+{
+    int failures = 0;
+    RasciiRenderer renderer(RenderSettings(40, 20, 90.0f, 0.5f, 50.0f, RENDER_SOLID, 1));
+    auto quad = std::make_shared<Mesh>(Mesh::centeredQuad());
+    {
+        SceneGraph first;
+        auto node = std::make_shared<TransformNode>(Transform(), RenderInfo(quad, CULL_NONE));
+        node->transform.move(Vec(0, 0, -3));
+        first.addChild(node);
+        renderer.prepare();
+        renderer.render(first);
+        CHECK(renderer.getStats().trianglesDrawn == 2);
+    }
+    auto unrelated = std::make_shared<TransformNode>(Transform(), RenderInfo(quad, CULL_NONE));
+    unrelated->transform.move(Vec(0, 0, -3));
+    SceneGraph second;
+    auto behind = std::make_shared<TransformNode>(Transform(), RenderInfo(quad, CULL_NONE));
+    behind->transform.move(Vec(0, 0, 3));
+    second.addChild(behind);
+    renderer.prepare();
+    renderer.render(second);
+    CHECK(renderer.getStats().trianglesDrawn == 0);
+
+    return failures;
+}
+
+/// @brief Checks the frustum against the projection it came from, and the renderer's culling counters
+int testFrustumCulling()
+{
+    int failures = 0;
+    RasciiRenderer renderer(RenderSettings(40, 20, 90.0f, 0.5f, 50.0f));
+    renderer.prepare();
+    const Frustum &frustum = renderer.getFrustum();
+
+    // a point is inside exactly when the projection puts it on the screen, between the near and far planes
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> dist(-60.0f, 60.0f);
+    for (int i = 0; i < 1000; i++)
+    {
+        float x = dist(rng), y = dist(rng), z = dist(rng);
+        bool inside = true;
+        for (int plane = 0; plane < FRUSTUM_PLANE_COUNT; plane++)
+        {
+            inside = inside && frustum.distance(plane, x, y, z) >= 0.0f;
+        }
+        // sides: |x| <= w and |y| <= w in clip space (aspect ratio 20 / 40), and the camera looks down -z
+        float fovRad = 1.0f / tanf(90.0f * 0.5f / 180.0f * 3.14159f);
+        float w = -z * 50.0f * 0.5f / (50.0f - 0.5f);
+        float cx = 0.5f * fovRad * x, cy = fovRad * y;
+        bool expected = std::fabs(cx) <= w && std::fabs(cy) <= w && -z >= 0.5f && -z <= 50.0f;
+        // skip the points right on a plane, where rounding decides
+        bool nearEdge = std::fabs(std::fabs(cx) - w) < 1e-3f || std::fabs(std::fabs(cy) - w) < 1e-3f;
+        if (!nearEdge)
+        {
+            CHECK(inside == expected);
+        }
+    }
+
+    // one node in view, and one behind the camera, past the far plane, and off to each side
+    SceneGraph sceneGraph;
+    auto quad = std::make_shared<Mesh>(Mesh::centeredQuad());
+    const Vec positions[] = {Vec(0, 0, -10), Vec(0, 0, 10), Vec(0, 0, -100), Vec(-200, 0, -10), Vec(0, 200, -10)};
+    for (const Vec &position : positions)
+    {
+        auto node = std::make_shared<TransformNode>(Transform(), RenderInfo(quad));
+        node->transform.move(position);
+        sceneGraph.addChild(node);
+    }
+    renderer.prepare();
+    renderer.render(sceneGraph);
+    CHECK(renderer.getStats().nodesDrawn == 1);
+    CHECK(renderer.getStats().nodesCulled == 4);
+    CHECK(renderer.getStats().trianglesDrawn == 2);
+
+    // the bounds follow the node's transform -- a big enough quad off to the side reaches back into view
+    sceneGraph.root->children[3]->transform.scaleBy(500.0f);
+    renderer.prepare();
+    renderer.render(sceneGraph);
+    CHECK(renderer.getStats().nodesDrawn == 2);
+
+    // a cube turned by 45 degrees, just outside of the left plane -- its world box still reaches over the plane, but
+    // the sphere around its corners does not, so it is culled without any vertex work
+    const Vec corners[] = {Vec(-1, -1, -1), Vec(1, -1, -1), Vec(-1, 1, -1), Vec(1, 1, -1),
+                           Vec(-1, -1, 1), Vec(1, -1, 1), Vec(-1, 1, 1), Vec(1, 1, 1)};
+    auto cube = std::make_shared<Mesh>(std::vector<Triangle>({Triangle(corners[0], corners[1], corners[2]),
+                                                              Triangle(corners[3], corners[4], corners[5]),
+                                                              Triangle(corners[6], corners[7], corners[0])}));
+    const Vec &left = frustum.planes[FRUSTUM_LEFT];
+    Vec onPlane(-(left.z * -10.0f + left.w) / left.x, 0.0f, -10.0f);
+    SceneGraph cornerGraph;
+    auto turned = std::make_shared<TransformNode>(Transform(), RenderInfo(cube, CULL_NONE));
+    turned->transform.move(onPlane - Vec(left.x, left.y, left.z, 0.0f) * 1.8f);
+    turned->transform.rotate(Quaternion::fromAxisAngle(Vec(0, 1, 0), 3.14159f / 4.0f));
+    cornerGraph.addChild(turned);
+    Matrix world = turned->getWorldMatrix();
+    CHECK(frustum.intersects(cube->getBoundingBox().transform(world)));
+    CHECK(!frustum.intersects(cube->getBoundingSphere().transform(world)));
+    renderer.prepare();
+    renderer.render(cornerGraph);
+    CHECK(renderer.getStats().nodesCulled == 1);
+    CHECK(renderer.getStats().nodesDrawn == 0);
+
+    return failures;
+}
+
+/// @brief Checks that whole branches are culled against their merged bounds, and that the bounds follow the branch
+int testHierarchicalCulling()
+{
+    int failures = 0;
+    RasciiRenderer renderer(RenderSettings(40, 20, 90.0f, 0.5f, 50.0f));
+    auto quad = std::make_shared<Mesh>(Mesh::centeredQuad());
+
+    // two groups of 10 props -- one in front of the camera, one behind it
+    SceneGraph sceneGraph;
+    std::shared_ptr<TransformNode> groups[2];
+    for (int g = 0; g < 2; g++)
+    {
+        groups[g] = std::make_shared<TransformNode>();
+        groups[g]->transform.move(Vec(0, 0, g == 0 ? -20.0f : 20.0f));
+        sceneGraph.addChild(groups[g]);
+        for (int p = 0; p < 10; p++)
+        {
+            auto prop = std::make_shared<TransformNode>(Transform(), RenderInfo(quad));
+            prop->transform.move(Vec((float)p - 5.0f, 0, 0));
+            groups[g]->addChild(prop);
+        }
+    }
+
+    renderer.prepare();
+    renderer.render(sceneGraph);
+    const RenderStats &stats = renderer.getStats();
+    CHECK(stats.nodesDrawn == 10);
+    CHECK(stats.nodesCulled == 10);
+    CHECK(stats.subtreesCulled == 1);
+    CHECK(stats.nodesVisited == 13); // the root, the visible group and its 10 props, and the culled group
+
+    // the merged bounds of a group contain every prop under it
+    FlatSceneGraph flat;
+    flat.update(sceneGraph);
+    CHECK(flat.subtreeEnds[0] == 23 && flat.subtreeEnds[1] == 12 && flat.subtreeEnds[12] == 23);
+    CHECK(flat.subtreeGeometryCounts[1] == 10 && flat.subtreeGeometryCounts[0] == 20);
+    CHECK(flat.subtreeBounds[1].min.x == -6.0f && flat.subtreeBounds[1].max.x == 5.0f);
+
+    // turning the hidden group around brings its bounds, and its props, into view
+    groups[1]->transform.move(Vec(0, 0, -40.0f));
+    renderer.prepare();
+    renderer.render(sceneGraph);
+    CHECK(stats.nodesDrawn == 20);
+    CHECK(stats.subtreesCulled == 0);
+
+    return failures;
+}
+
+/// @brief Checks that each cull mode keeps the right faces of a two sided quad, for both kinds of mesh
+int testBackfaceCulling()
+{
+    int failures = 0;
+    RasciiRenderer renderer(RenderSettings(40, 20, 90.0f, 0.5f, 50.0f));
+
+    // the centered quad faces the camera; the reversed copy faces away from it
+    Mesh front = Mesh::centeredQuad();
+    std::vector<Triangle> twoSided = front.triangles;
+    for (const Triangle &triangle : front.triangles)
+    {
+        Triangle back = triangle;
+        back.reverseSelf();
+        twoSided.push_back(back);
+    }
+    auto mesh = std::make_shared<Mesh>(twoSided);
+    auto indexed = std::make_shared<IndexedMesh>(IndexedMesh::fromMesh(*mesh));
+
+    const CullMode modes[] = {CULL_BACK, CULL_FRONT, CULL_NONE};
+    const int expectedDrawn[] = {2, 2, 4};
+    for (int m = 0; m < 3; m++)
+    {
+        for (int kind = 0; kind < 2; kind++)
+        {
+            SceneGraph sceneGraph;
+            auto node = std::make_shared<TransformNode>(Transform(), kind == 0 ? RenderInfo(mesh, modes[m]) : RenderInfo(indexed, modes[m]));
+            node->transform.move(Vec(0, 0, -10));
+            sceneGraph.addChild(node);
+
+            renderer.prepare();
+            renderer.render(sceneGraph);
+            CHECK(renderer.getStats().trianglesDrawn == expectedDrawn[m]);
+            CHECK(renderer.getStats().trianglesCulled == 4 - expectedDrawn[m]);
+        }
+    }
+
+    // turning the quad around swaps which side is culled
+    SceneGraph sceneGraph;
+    auto node = std::make_shared<TransformNode>(Transform(), RenderInfo(std::make_shared<Mesh>(front), CULL_BACK));
+    node->transform.move(Vec(0, 0, -10));
+    sceneGraph.addChild(node);
+    renderer.prepare();
+    renderer.render(sceneGraph);
+    CHECK(renderer.getStats().trianglesDrawn == 2);
+    node->transform.rotate(Quaternion::fromAxisAngle(Vec(0, 1, 0), 3.14159f));
+    renderer.prepare();
+    renderer.render(sceneGraph);
+    CHECK(renderer.getStats().trianglesDrawn == 0);
+
+    return failures;
+}
+
+/// @brief Checks that triangles crossing the near plane are clipped before the divide, and that the clipped edges are
+/// @brief not drawn
+int testNearPlaneClipping()
+{
+    int failures = 0;
+    RenderSettings settings(40, 20, 90.0f, 0.5f, 50.0f);
+    RasciiRenderer renderer(settings);
+    renderer.prepare();
+
+    // one corner behind the camera -- the near plane cuts off a corner, which turns the triangle into a quad, with one
+    // edge along the plane
+    const Clipper &clipper = renderer.getClipper();
+    Vec triangle[3] = {Vec(-0.5f, -0.5f, 4.0f, 4.0f), Vec(0.5f, -0.5f, 4.0f, 4.0f), Vec(0.0f, 0.5f, 0.0f, -1.0f)};
+    uint8_t codes[3] = {clipper.outcode(triangle[0]), clipper.outcode(triangle[1]), clipper.outcode(triangle[2])};
+    CHECK((codes[0] | codes[1]) == 0);
+    CHECK((codes[2] & CLIP_NEAR) != 0);
+
+    Vec polygon[CLIP_MAX_VERTICES];
+    bool edgeFlags[CLIP_MAX_VERTICES];
+    int count = clipper.clipTriangle(triangle, codes, polygon, edgeFlags);
+    CHECK(count == 4);
+    int flagged = 0;
+    for (int i = 0; i < count; i++)
+    {
+        CHECK(polygon[i].w >= clipper.getNearW() - 1e-5f);
+        flagged += edgeFlags[i] ? 1 : 0;
+    }
+    CHECK(flagged == 3);
+
+    // a triangle through the camera is clipped, one entirely behind it is rejected, and nothing is drawn off the texture
+    std::vector<Triangle> triangles;
+    triangles.push_back(Triangle(Vec(-2, -1, -6), Vec(2, -1, -6), Vec(0, -1, 6)));
+    triangles.push_back(Triangle(Vec(-2, 1, 4), Vec(2, 1, 4), Vec(0, 1, 6)));
+    auto mesh = std::make_shared<Mesh>(triangles);
+    auto indexed = std::make_shared<IndexedMesh>(IndexedMesh::fromMesh(*mesh));
+    for (int kind = 0; kind < 2; kind++)
+    {
+        SceneGraph sceneGraph;
+        sceneGraph.root->renderInfo = kind == 0 ? RenderInfo(mesh, CULL_NONE) : RenderInfo(indexed, CULL_NONE);
+        renderer.prepare();
+        renderer.render(sceneGraph);
+
+        const RenderStats &stats = renderer.getStats();
+        CHECK(stats.trianglesClipped == 1);
+        CHECK(stats.trianglesOutside == 1);
+        CHECK(stats.trianglesDrawn == 1);
+
+        std::shared_ptr<Texture> output = renderer.getOutput();
+        int lit = 0;
+        for (int y = 0; y < output->getHeight(); y++)
+        {
+            for (int x = 0; x < output->getWidth(); x++)
+            {
+                lit += output->get(x, y).r > 0 ? 1 : 0;
+            }
+        }
+        CHECK(lit > 0);
+    }
+
+    return failures;
+}
+
+/// @brief Checks that the solid render mode keeps the closest surface, whatever order the surfaces are drawn in
+int testSolidRendering()
+{
+    int failures = 0;
+    const float nearPlane = 0.5f, farPlane = 50.0f;
+    RasciiRenderer renderer(RenderSettings(40, 20, 90.0f, nearPlane, farPlane, RENDER_SOLID));
+
+    // a small quad in front of a large one, tilted so that they get different shades
+    auto small = std::make_shared<Mesh>(Mesh::centeredQuad());
+    auto large = std::make_shared<Mesh>(Mesh::centeredQuad());
+    std::shared_ptr<Texture> reference;
+    for (int order = 0; order < 2; order++)
+    {
+        SceneGraph sceneGraph;
+        auto front = std::make_shared<TransformNode>(Transform(), RenderInfo(small, CULL_NONE));
+        front->transform.move(Vec(0, 0, -2));
+        front->transform.scaleBy(Vec(0.5f, 0.5f, 0.5f));
+        auto back = std::make_shared<TransformNode>(Transform(), RenderInfo(large, CULL_NONE));
+        back->transform.move(Vec(0, 0, -4));
+        back->transform.scaleBy(Vec(2, 2, 2));
+        back->transform.rotate(Quaternion::fromAxisAngle(Vec(0, 1, 0), 0.5f));
+        sceneGraph.addChild(order == 0 ? front : back);
+        sceneGraph.addChild(order == 0 ? back : front);
+
+        renderer.prepare();
+        renderer.render(sceneGraph);
+        std::shared_ptr<Texture> output = renderer.getOutput();
+        std::shared_ptr<DepthBuffer> depth = renderer.getDepthBuffer();
+        CHECK(renderer.getStats().trianglesDrawn == 4);
+
+        // the center belongs to the front quad, at its perspective correct depth; the corners are empty
+        float expected = (farPlane - nearPlane) / (2.0f * farPlane * nearPlane);
+        CHECK(std::fabs(depth->get(20, 10) - expected) < expected * 1e-3f);
+        CHECK(output->get(20, 10).r > 0);
+        CHECK(depth->get(0, 0) == 0.0f);
+        CHECK(output->get(0, 0).r == 0);
+
+        if (order == 0)
+        {
+            reference = std::make_shared<Texture>(output->getWidth(), output->getHeight());
+            for (int y = 0; y < output->getHeight(); y++)
+            {
+                for (int x = 0; x < output->getWidth(); x++)
+                {
+                    reference->set(x, y, output->get(x, y));
+                }
+            }
+            continue;
+        }
+
+        int differences = 0;
+        for (int y = 0; y < output->getHeight(); y++)
+        {
+            for (int x = 0; x < output->getWidth(); x++)
+            {
+                differences += output->get(x, y).r != reference->get(x, y).r ? 1 : 0;
+            }
+        }
+        CHECK(differences == 0);
+    }
+
+    return failures;
+}
+
+/// @brief Rasterizes each triangle on its own, and counts how many of them covered each pixel
+static std::vector<int> coverageCounts(const std::vector<Vec> &corners, int width, int height)
+{
+    std::vector<int> counts(width * height, 0);
+    std::vector<uint32_t> pixels(width * height);
+    for (size_t i = 0; i + 2 < corners.size(); i += 3)
+    {
+        std::fill(pixels.begin(), pixels.end(), 0);
+        RasterTriangle triangle;
+        if (triangle.setup(corners[i], corners[i + 1], corners[i + 2], width, height))
+        {
+            RasterKernels::fill(triangle, RasterTarget(pixels.data(), nullptr, width, height), 1);
+        }
+        for (int p = 0; p < width * height; p++)
+        {
+            counts[p] += (int)pixels[p];
+        }
+    }
+    return counts;
+}
+
+/// @brief Checks the fill rule of the edge function rasterizer, and that its kernels agree with the scalar reference
+int testEdgeRasterizer()
+{
+    int failures = 0;
+    const int width = 37, height = 23; // not a multiple of the block size
+
+    // a rectangle, split into 2 triangles and into a fan of 4 -- every pixel center inside is covered exactly once,
+    // whichever triangle it falls in
+    Vec a(2.3f, 1.2f, 0), b(30.7f, 1.2f, 0), c(30.7f, 17.9f, 0), d(2.3f, 17.9f, 0), center(16.37f, 9.61f, 0);
+    std::vector<Vec> split = {a, b, c, a, c, d};
+    std::vector<Vec> fan = {a, b, center, b, c, center, c, d, center, d, a, center};
+    for (const std::vector<Vec> *corners : {&split, &fan})
+    {
+        std::vector<int> counts = coverageCounts(*corners, width, height);
+        int covered = 0, overlaps = 0;
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                int count = counts[y * width + x];
+                bool inside = x >= 2 && x <= 30 && y >= 1 && y <= 17;
+                covered += count == 1 && inside ? 1 : 0;
+                overlaps += count > 1 || (count > 0 && !inside) ? 1 : 0;
+            }
+        }
+        CHECK(covered == 29 * 17);
+        CHECK(overlaps == 0);
+    }
+
+    // random, overlapping, depth tested triangles -- some of them off the target -- write the same pixels and depths
+    std::mt19937 rng(99);
+    std::uniform_real_distribution<float> position(-10.0f, 50.0f);
+    std::uniform_real_distribution<float> depth(0.01f, 1.0f);
+    std::vector<uint32_t> expectedPixels(width * height, 0), actualPixels(width * height, 0);
+    std::vector<float> expectedDepths(width * height, 0.0f), actualDepths(width * height, 0.0f);
+    RasterTarget expected(expectedPixels.data(), expectedDepths.data(), width, height);
+    RasterTarget actual(actualPixels.data(), actualDepths.data(), width, height);
+    int expectedWritten = 0, actualWritten = 0;
+    for (int i = 0; i < 500; i++)
+    {
+        Vec p1(position(rng), position(rng), 0, depth(rng));
+        Vec p2(position(rng), position(rng), 0, depth(rng));
+        Vec p3(position(rng), position(rng), 0, depth(rng));
+        RasterTriangle triangle;
+        if (!triangle.setup(p1, p2, p3, width, height))
+        {
+            continue;
+        }
+        expectedWritten += ScalarRasterKernels::fill(triangle, expected, (uint32_t)i + 1);
+        actualWritten += RasterKernels::fill(triangle, actual, (uint32_t)i + 1);
+    }
+    CHECK(expectedWritten > 0);
+    CHECK(actualWritten == expectedWritten);
+    CHECK(expectedPixels == actualPixels);
+    CHECK(bitEqual(expectedDepths.data(), actualDepths.data(), width * height));
+
+    return failures;
+}
+
+/// @brief Checks that parallel loops run every index exactly once, loop after loop
+int testThreadPool()
+{
+    int failures = 0;
+    ThreadPool pool(4);
+    CHECK(pool.getThreadCount() == 4);
+
+    std::vector<std::atomic<int>> runs(1000);
+    std::atomic<int> badThreads(0);
+    for (int loop = 0; loop < 50; loop++)
+    {
+        for (std::atomic<int> &run : runs)
+        {
+            run.store(0);
+        }
+        auto body = [&](int index, int threadIndex)
+        {
+            runs[index]++;
+            if (threadIndex < 0 || threadIndex >= 4)
+            {
+                badThreads++;
+            }
+        };
+        pool.parallelFor((int)runs.size(), body);
+
+        int wrong = 0;
+        for (std::atomic<int> &run : runs)
+        {
+            wrong += run.load() != 1 ? 1 : 0;
+        }
+        CHECK(wrong == 0);
+    }
+    CHECK(badThreads.load() == 0);
+
+    // a thread limit keeps the loop on the first threads of the pool
+    std::atomic<int> limitedRuns(0), outsideLimit(0);
+    auto limited = [&](int, int threadIndex)
+    {
+        limitedRuns++;
+        if (threadIndex >= 2)
+        {
+            outsideLimit++;
+        }
+    };
+    pool.parallelFor(1000, limited, 2);
+    CHECK(limitedRuns.load() == 1000);
+    CHECK(outsideLimit.load() == 0);
+
+    return failures;
+}
+
+/// @brief Checks that the tiled raster draws the same frame whatever the number of threads
+int testTiledRasterization()
+{
+    int failures = 0;
+
+    // a jumble of overlapping triangles that cross many tiles
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<float> position(-1.5f, 1.5f), depth(-6.0f, -2.0f);
+    std::vector<Triangle> triangles;
+    for (int i = 0; i < 300; i++)
+    {
+        float z = depth(rng);
+        triangles.push_back(Triangle(Vec(position(rng), position(rng), z), Vec(position(rng), position(rng), z + 0.5f),
+                                     Vec(position(rng), position(rng), z - 0.5f)));
+    }
+    SceneGraph sceneGraph;
+    sceneGraph.root->renderInfo = RenderInfo(std::make_shared<Mesh>(triangles), CULL_NONE);
+
+    const RenderMode modes[] = {RENDER_WIREFRAME, RENDER_SOLID, RENDER_SOLID_WIREFRAME};
+    for (RenderMode mode : modes)
+    {
+        RasciiRenderer single(RenderSettings(100, 40, 90.0f, 0.5f, 50.0f, mode, 1));
+        RasciiRenderer parallel(RenderSettings(100, 40, 90.0f, 0.5f, 50.0f, mode, 4));
+        single.prepare();
+        single.render(sceneGraph);
+        parallel.prepare();
+        parallel.render(sceneGraph);
+
+        CHECK(single.getStats().drawCommands > 0);
+        CHECK(single.getStats().binnedCommands >= single.getStats().drawCommands);
+        std::shared_ptr<Texture> a = single.getOutput(), b = parallel.getOutput();
+        int differences = 0, lit = 0;
+        for (int y = 0; y < a->getHeight(); y++)
+        {
+            for (int x = 0; x < a->getWidth(); x++)
+            {
+                differences += a->get(x, y).r != b->get(x, y).r ? 1 : 0;
+                differences += single.getDepthBuffer()->get(x, y) != parallel.getDepthBuffer()->get(x, y) ? 1 : 0;
+                lit += a->get(x, y).r > 0 ? 1 : 0;
+            }
+        }
+        CHECK(differences == 0);
+        CHECK(lit > 0);
+    }
+
+    return failures;
+}
+
+/// @brief Checks that the parallel vertex stage draws the same frame, with the same stats, as the serial one
+int testParallelVertexStage()
+{
+    int failures = 0;
+
+    // meshes large enough to be split into several jobs, next to small ones
+    std::mt19937 rng(9);
+    std::uniform_real_distribution<float> position(-1.5f, 1.5f), depth(-6.0f, -2.0f);
+    std::vector<Triangle> triangles;
+    for (int i = 0; i < 3000; i++)
+    {
+        float z = depth(rng);
+        triangles.push_back(Triangle(Vec(position(rng), position(rng), z), Vec(position(rng), position(rng), z + 0.1f),
+                                     Vec(position(rng), position(rng), z - 0.1f)));
+    }
+    auto mesh = std::make_shared<Mesh>(triangles);
+    auto indexed = std::make_shared<IndexedMesh>(IndexedMesh::fromMesh(*mesh));
+    std::vector<Triangle> few(triangles.begin(), triangles.begin() + 10);
+
+    SceneGraph sceneGraph;
+    sceneGraph.root->renderInfo = RenderInfo(mesh, CULL_BACK);
+    auto indexedNode = std::make_shared<TransformNode>(Transform(), RenderInfo(indexed, CULL_FRONT));
+    indexedNode->transform.position = Vec(0.2f, 0.0f, 0.0f);
+    sceneGraph.addChild(indexedNode);
+    for (int i = 0; i < 5; i++)
+    {
+        auto small = std::make_shared<TransformNode>(Transform(), RenderInfo(std::make_shared<Mesh>(few), CULL_NONE));
+        small->transform.position = Vec(0.1f * i, 0.0f, 0.0f);
+        indexedNode->addChild(small);
+    }
+
+    const RenderMode modes[] = {RENDER_WIREFRAME, RENDER_SOLID_WIREFRAME};
+    for (RenderMode mode : modes)
+    {
+        RasciiRenderer serial(RenderSettings(100, 40, 90.0f, 0.5f, 50.0f, mode, 4, 1));
+        RasciiRenderer parallel(RenderSettings(100, 40, 90.0f, 0.5f, 50.0f, mode, 4, 0));
+        // the third frame is the first one in which the arena is settled
+        for (int frame = 0; frame < 3; frame++)
+        {
+            serial.invalidate();
+            serial.prepare();
+            serial.render(sceneGraph);
+            parallel.invalidate();
+            parallel.prepare();
+            parallel.render(sceneGraph);
+        }
+
+        const RenderStats &a = serial.getStats(), &b = parallel.getStats();
+        CHECK(a.vertexJobs > a.nodesDrawn);
+        CHECK(a.vertexJobs == b.vertexJobs);
+        CHECK(a.trianglesDrawn > 0);
+        CHECK(a.trianglesCulled > 0);
+        CHECK(a.trianglesDrawn == b.trianglesDrawn);
+        CHECK(a.trianglesCulled == b.trianglesCulled);
+        CHECK(a.trianglesClipped == b.trianglesClipped);
+        CHECK(a.trianglesOutside == b.trianglesOutside);
+        CHECK(a.drawCommands == b.drawCommands);
+        CHECK(a.binnedCommands == b.binnedCommands);
+        CHECK(b.arenaHeapAllocations == 0);
+
+        int differences = 0;
+        for (int y = 0; y < 40; y++)
+        {
+            for (int x = 0; x < 100; x++)
+            {
+                differences += serial.getOutput()->get(x, y).r != parallel.getOutput()->get(x, y).r ? 1 : 0;
+                differences += serial.getDepthBuffer()->get(x, y) != parallel.getDepthBuffer()->get(x, y) ? 1 : 0;
+            }
+        }
+        CHECK(differences == 0);
+    }
+
+    return failures;
+}
+
+/// @brief Takes a world position to texture space the way the renderer used to -- projection, divide, viewport, divide
+static Vec referenceToTexture(const RasciiRenderer &renderer, const Vec &worldPos)
+{
+    Vec clip = renderer.getProjectionMatrix() * worldPos;
+    Vec texture = renderer.getViewportMatrix() * (clip / clip.w);
+    texture = texture / texture.w;
+    texture.w = 1.0f / clip.w;
+    return texture;
+}
+
+/// @brief Checks that the fused per node matrix draws the same pixels as separate world, projection and viewport
+/// @brief transforms, and that the matrices are only built once
+int testFusedVertexPath()
+{
+    int failures = 0;
+
+    // rotated, scaled and nested nodes, so that the fused matrix differs from the product of the steps
+    std::mt19937 rng(21);
+    std::uniform_real_distribution<float> position(-1.0f, 1.0f);
+    std::vector<Triangle> triangles;
+    for (int i = 0; i < 200; i++)
+    {
+        triangles.push_back(Triangle(Vec(position(rng), position(rng), position(rng)), Vec(position(rng), position(rng), position(rng)),
+                                     Vec(position(rng), position(rng), position(rng))));
+    }
+    auto mesh = std::make_shared<Mesh>(triangles);
+    SceneGraph sceneGraph;
+    auto parent = std::make_shared<TransformNode>(Transform(), RenderInfo(mesh, CULL_NONE));
+    parent->transform.move(Vec(0.1f, -0.2f, -4.0f));
+    parent->transform.rotate(Quaternion::fromAxisAngle(Vec(0, 1, 0), 0.7f));
+    auto child = std::make_shared<TransformNode>(Transform(), RenderInfo(std::make_shared<IndexedMesh>(IndexedMesh::fromMesh(*mesh)), CULL_NONE));
+    child->transform.move(Vec(0.5f, 0.3f, 0.0f));
+    child->transform.rotate(Quaternion::fromAxisAngle(Vec(1, 0, 0), 0.4f));
+    child->transform.scaleBy(Vec(0.5f, 0.7f, 0.6f));
+    sceneGraph.addChild(parent);
+    parent->addChild(child);
+    const TransformNode *nodes[] = {parent.get(), child.get()};
+    const std::vector<Triangle> &nodeTriangles = triangles;
+
+    const RenderMode modes[] = {RENDER_WIREFRAME, RENDER_SOLID};
+    for (RenderMode mode : modes)
+    {
+        RasciiRenderer renderer(RenderSettings(120, 50, 90.0f, 0.5f, 50.0f, mode, 1));
+        renderer.prepare();
+        CHECK(renderer.getStats().projectionRebuilds == 1);
+        renderer.render(sceneGraph);
+        CHECK(renderer.getStats().trianglesClipped == 0);
+        CHECK(renderer.getStats().trianglesDrawn == 400);
+
+        // draw the same triangles through the old path -- the renderer draws every edge in white, or fills
+        auto texture = std::make_shared<Texture>(120, 50);
+        auto depth = std::make_shared<DepthBuffer>(120, 50);
+        TextureDrawer drawer(texture, depth);
+        drawer.fill(Color::greyscale(0.0f));
+        for (const TransformNode *node : nodes)
+        {
+            Matrix world = uncachedWorldMatrix(node);
+            for (const Triangle &triangle : nodeTriangles)
+            {
+                Vec p1 = referenceToTexture(renderer, world * triangle.v1.position);
+                Vec p2 = referenceToTexture(renderer, world * triangle.v2.position);
+                Vec p3 = referenceToTexture(renderer, world * triangle.v3.position);
+                if (mode == RENDER_WIREFRAME)
+                {
+                    drawer.drawLine(p1, p2, Color::greyscale(1.0f));
+                    drawer.drawLine(p2, p3, Color::greyscale(1.0f));
+                    drawer.drawLine(p3, p1, Color::greyscale(1.0f));
+                }
+                else
+                {
+                    drawer.fillTriangleDepth(p1, p2, p3, Color::greyscale(1.0f));
+                }
+            }
+        }
+
+        // the fills are shaded, so the solid frames are compared by coverage
+        int differences = 0, lit = 0;
+        for (int y = 0; y < 50; y++)
+        {
+            for (int x = 0; x < 120; x++)
+            {
+                bool expected = texture->get(x, y).r > 0, actual = renderer.getOutput()->get(x, y).r > 0;
+                differences += expected != actual ? 1 : 0;
+                lit += actual ? 1 : 0;
+            }
+        }
+        CHECK(differences == 0);
+        CHECK(lit > 0);
+
+        // nothing changed, so the cached matrices are used as they are
+        renderer.prepare();
+        CHECK(renderer.getStats().projectionRebuilds == 0);
+        CHECK(renderer.getStats().viewRebuilds == 0);
+    }
+
+    return failures;
+}
+
+/// @brief Returns the number of pixels that differ between the outputs of two renderers
+static int countDifferences(const RasciiRenderer &a, const RasciiRenderer &b)
+{
+    std::shared_ptr<Texture> textureA = a.getOutput(), textureB = b.getOutput();
+    int differences = 0;
+    for (int y = 0; y < textureA->getHeight(); y++)
+    {
+        for (int x = 0; x < textureA->getWidth(); x++)
+        {
+            differences += textureA->get(x, y).r != textureB->get(x, y).r ? 1 : 0;
+        }
+    }
+    return differences;
+}
+
+/// @brief Checks that the renderer draws from the camera, and only rebuilds what a change of the camera invalidates
+int testCamera()
+{
+    int failures = 0;
+    RenderSettings settings(80, 30, 90.0f, 0.5f, 50.0f, RENDER_SOLID_WIREFRAME, 1);
+
+    // a quad straight ahead, and one behind the origin
+    auto quad = std::make_shared<Mesh>(Mesh::centeredQuad());
+    SceneGraph sceneGraph;
+    auto ahead = std::make_shared<TransformNode>(Transform(), RenderInfo(quad, CULL_NONE));
+    ahead->transform.move(Vec(0.25f, 0.0f, -4.0f));
+    auto behind = std::make_shared<TransformNode>(Transform(), RenderInfo(quad, CULL_NONE));
+    behind->transform.move(Vec(0.0f, 0.0f, 4.0f));
+    behind->transform.scaleBy(0.5f);
+    sceneGraph.addChild(ahead);
+    sceneGraph.addChild(behind);
+
+    // a camera at the origin, with the projection of the settings, draws what the renderer drew without one
+    RasciiRenderer reference(settings), renderer(settings);
+    auto camera = std::make_shared<Camera>(settings.fov, settings.nearPlane, settings.farPlane);
+    renderer.setCamera(camera);
+    reference.prepare();
+    reference.render(sceneGraph);
+    renderer.prepare();
+    renderer.render(sceneGraph);
+    CHECK(renderer.getStats().nodesDrawn == 1);
+    CHECK(countDifferences(reference, renderer) == 0);
+
+    // moving the camera is the same as moving the scene the other way
+    uint64_t worldVersion = ahead->getWorldVersion();
+    camera->transform.move(Vec(0.5f, 0.0f, 1.0f));
+    renderer.prepare();
+    CHECK(renderer.getStats().projectionRebuilds == 0);
+    CHECK(renderer.getStats().viewRebuilds == 1);
+    renderer.render(sceneGraph);
+    // a camera that only moved leaves the world matrices of the scene alone
+    CHECK(ahead->getWorldVersion() == worldVersion);
+
+    ahead->transform.move(Vec(-0.5f, 0.0f, -1.0f));
+    reference.prepare();
+    reference.render(sceneGraph);
+    CHECK(countDifferences(reference, renderer) == 0);
+    ahead->transform.move(Vec(0.5f, 0.0f, 1.0f));
+    camera->transform.move(Vec(-0.5f, 0.0f, -1.0f));
+
+    // turned around, the camera culls the quad ahead and sees the one behind
+    camera->look(3.14159265f, 0.0f);
+    renderer.prepare();
+    renderer.render(sceneGraph);
+    CHECK(renderer.getStats().nodesDrawn == 1);
+    CHECK(renderer.getStats().nodesCulled == 1);
+    CHECK(renderer.getStats().trianglesDrawn == 2);
+
+    // forward follows where the camera looks -- a quarter turn to the left looks down -x
+    Camera walker;
+    walker.look(3.14159265f * 0.5f, 0.0f);
+    walker.moveLocal(Vec(0.0f, 0.0f, -2.0f));
+    CHECK(std::fabs(walker.transform.position.x + 2.0f) < 1e-4f);
+    CHECK(std::fabs(walker.transform.position.z) < 1e-4f);
+
+    // changing the projection rebuilds both, and nothing at all is rebuilt when nothing changed
+    camera->setProjection(60.0f, 0.5f, 50.0f);
+    renderer.prepare();
+    CHECK(renderer.getStats().projectionRebuilds == 1);
+    CHECK(renderer.getStats().viewRebuilds == 1);
+    renderer.render(sceneGraph);
+    renderer.prepare();
+    renderer.render(sceneGraph);
+    CHECK(renderer.getStats().projectionRebuilds == 0);
+    CHECK(renderer.getStats().viewRebuilds == 0);
+
+    // a camera in the scene graph follows its parent
+    auto rig = std::make_shared<TransformNode>();
+    auto mounted = std::make_shared<Camera>(settings.fov, settings.nearPlane, settings.farPlane);
+    sceneGraph.addChild(rig);
+    rig->addChild(mounted);
+    renderer.setCamera(mounted);
+    renderer.prepare();
+    renderer.render(sceneGraph);
+    rig->transform.move(Vec(0.0f, 0.0f, 20.0f));
+    renderer.prepare();
+    renderer.render(sceneGraph);
+    CHECK(renderer.getStats().viewRebuilds == 1);
+    CHECK(renderer.getStats().nodesDrawn == 2);
+
+    return failures;
+}
+
+/// @brief Builds a wavy grid of quads -- every inner vertex is a corner of 6 triangles
+static Mesh gridMesh(int cells)
+{
+    std::vector<Triangle> triangles;
+    auto point = [&](int i, int j)
+    {
+        float x = -2.0f + 4.0f * (float)i / (float)cells, y = -2.0f + 4.0f * (float)j / (float)cells;
+        return Vec(x, y, 0.3f * std::sin(3.0f * x) * std::cos(2.0f * y));
+    };
+    for (int j = 0; j < cells; j++)
+    {
+        for (int i = 0; i < cells; i++)
+        {
+            triangles.push_back(Triangle(point(i, j), point(i + 1, j), point(i + 1, j + 1)));
+            triangles.push_back(Triangle(point(i, j), point(i + 1, j + 1), point(i, j + 1)));
+        }
+    }
+    return Mesh(triangles);
+}
+
+/// @brief Checks that meshes which share vertices transform each of them once, and draw what they drew before
+int testVertexCache()
+{
+    int failures = 0;
+
+    // the same grid on two nodes, tilted so that some of it faces away
+    auto grid = std::make_shared<Mesh>(gridMesh(20));
+    SceneGraph sceneGraph;
+    auto tilted = std::make_shared<TransformNode>(Transform(), RenderInfo(grid, CULL_BACK));
+    tilted->transform.move(Vec(0.0f, 0.0f, -4.0f));
+    tilted->transform.rotate(Quaternion::fromAxisAngle(Vec(1, 0, 0), -0.9f));
+    auto nearby = std::make_shared<TransformNode>(Transform(), RenderInfo(grid, CULL_NONE));
+    nearby->transform.move(Vec(1.0f, 0.5f, -1.0f));
+    sceneGraph.addChild(tilted);
+    sceneGraph.addChild(nearby);
+
+    const RenderMode modes[] = {RENDER_WIREFRAME, RENDER_SOLID_WIREFRAME};
+    for (RenderMode mode : modes)
+    {
+        RasciiRenderer cached(RenderSettings(100, 40, 90.0f, 0.5f, 50.0f, mode, 1, 0, true));
+        RasciiRenderer uncached(RenderSettings(100, 40, 90.0f, 0.5f, 50.0f, mode, 1, 0, false));
+        cached.prepare();
+        cached.render(sceneGraph);
+        uncached.prepare();
+        uncached.render(sceneGraph);
+
+        // 21 x 21 unique vertices per node, instead of 3 per triangle
+        const RenderStats &a = cached.getStats(), &b = uncached.getStats();
+        CHECK(a.vertexCacheBuilds == 1);
+        CHECK(a.verticesTransformed == 2 * 21 * 21);
+        CHECK(a.vertexCacheHits == 2 * (800 * 3 - 21 * 21));
+        CHECK(a.getVertexCacheHitRate() > 0.8f);
+        CHECK(b.verticesTransformed == 2 * 800 * 3);
+        CHECK(b.vertexCacheHits == 0);
+        CHECK(b.getVertexCacheHitRate() == 0.0f);
+        CHECK(a.trianglesDrawn > 0);
+        CHECK(a.trianglesCulled > 0);
+        CHECK(a.trianglesDrawn == b.trianglesDrawn);
+        CHECK(a.trianglesCulled == b.trianglesCulled);
+        CHECK(a.trianglesClipped == b.trianglesClipped);
+        CHECK(countDifferences(cached, uncached) == 0);
+
+        // the copy is kept while the mesh is unchanged
+        cached.invalidate();
+        cached.prepare();
+        cached.render(sceneGraph);
+        CHECK(cached.getStats().vertexCacheBuilds == 0);
+        CHECK(cached.getStats().verticesTransformed == 2 * 21 * 21);
+    }
+
+    // an edit of the mesh shows up once its bounds are recomputed
+    RasciiRenderer cached(RenderSettings(100, 40, 90.0f, 0.5f, 50.0f, RENDER_SOLID, 1, 0, true));
+    RasciiRenderer uncached(RenderSettings(100, 40, 90.0f, 0.5f, 50.0f, RENDER_SOLID, 1, 0, false));
+    cached.prepare();
+    cached.render(sceneGraph);
+    for (Triangle &triangle : grid->triangles)
+    {
+        triangle.v1.position.z += 0.5f;
+    }
+    grid->computeBounds();
+    cached.prepare();
+    cached.render(sceneGraph);
+    uncached.prepare();
+    uncached.render(sceneGraph);
+    CHECK(cached.getStats().vertexCacheBuilds == 1);
+    CHECK(countDifferences(cached, uncached) == 0);
+
+    // a triangle soup shares no corners, and is drawn as it is
+    std::vector<Triangle> soup;
+    for (int i = 0; i < 50; i++)
+    {
+        float x = -1.0f + 0.04f * (float)i;
+        soup.push_back(Triangle(Vec(x, -1, -3), Vec(x + 0.5f, -1, -3), Vec(x, 1, -3)));
+    }
+    SceneGraph soupGraph;
+    soupGraph.root->renderInfo = RenderInfo(std::make_shared<Mesh>(soup), CULL_NONE);
+    cached.prepare();
+    cached.render(soupGraph);
+    CHECK(cached.getStats().vertexCacheBuilds == 1);
+    CHECK(cached.getStats().verticesTransformed == 50 * 3);
+    CHECK(cached.getStats().vertexCacheHits == 0);
+    CHECK(cached.getStats().trianglesDrawn == 50);
+
+    return failures;
+}
+
+/// @brief Checks that incremental frames only draw the tiles under what changed, and end up with the pixels and depths of
+/// @brief a full redraw
+int testDirtyRegions()
+{
+    int failures = 0;
+    const int width = 160, height = 64; // 5 x 4 tiles
+
+    // a row of quads, seen from both sides, and a camera
+    auto quad = std::make_shared<Mesh>(Mesh::centeredQuad());
+    SceneGraph sceneGraph;
+    std::vector<std::shared_ptr<TransformNode>> quads;
+    for (int i = 0; i < 5; i++)
+    {
+        auto node = std::make_shared<TransformNode>(Transform(), RenderInfo(quad, CULL_NONE));
+        node->transform.move(Vec(-4.0f + 2.0f * (float)i, 0.5f * (float)(i % 2), -6.0f - (float)i));
+        node->transform.scaleBy(0.6f);
+        sceneGraph.addChild(node);
+        quads.push_back(node);
+    }
+    auto camera = std::make_shared<Camera>(90.0f, 0.5f, 50.0f);
+    sceneGraph.addChild(camera);
+
+    const RenderMode modes[] = {RENDER_WIREFRAME, RENDER_SOLID_WIREFRAME};
+    for (RenderMode mode : modes)
+    {
+        RasciiRenderer renderer(RenderSettings(width, height, 90.0f, 0.5f, 50.0f, mode, 2));
+        RasciiRenderer reference(RenderSettings(width, height, 90.0f, 0.5f, 50.0f, mode, 2));
+        renderer.setCamera(camera);
+        reference.setCamera(camera);
+        std::vector<float> before(width * height);
+
+        // renders a frame with both, checks that they agree, and returns the number of pixels that changed
+        auto renderFrame = [&]()
+        {
+            for (int y = 0; y < height; y++)
+            {
+                for (int x = 0; x < width; x++)
+                {
+                    before[y * width + x] = renderer.getOutput()->get(x, y).r;
+                }
+            }
+            renderer.prepare();
+            renderer.render(sceneGraph);
+            reference.invalidate();
+            reference.prepare();
+            reference.render(sceneGraph);
+            CHECK(countDifferences(renderer, reference) == 0);
+
+            int changed = 0, outside = 0;
+            for (int y = 0; y < height; y++)
+            {
+                for (int x = 0; x < width; x++)
+                {
+                    CHECK(renderer.getDepthBuffer()->get(x, y) == reference.getDepthBuffer()->get(x, y));
+                    if (before[y * width + x] == renderer.getOutput()->get(x, y).r)
+                    {
+                        continue;
+                    }
+                    changed++;
+                    bool covered = false;
+                    for (const Rect &rect : renderer.getDirtyRects())
+                    {
+                        covered = covered || rect.contains(x, y);
+                    }
+                    outside += covered ? 0 : 1;
+                }
+            }
+            // a pixel can only change inside of a dirty rectangle
+            CHECK(outside == 0);
+            return changed;
+        };
+
+        renderFrame();
+        CHECK(renderer.getStats().tilesRedrawn == 20);
+        CHECK(renderer.getDirtyRects().size() == 1);
+
+        // nothing moved, so nothing is drawn
+        CHECK(renderFrame() == 0);
+        CHECK(renderer.getStats().tilesRedrawn == 0);
+        CHECK(renderer.getStats().nodesDrawn == 0);
+        CHECK(renderer.getDirtyRects().empty());
+
+        // one quad moves -- only the tiles around it are drawn again
+        quads[1]->transform.move(Vec(0.3f, 0.2f, 0.0f));
+        CHECK(renderFrame() > 0);
+        CHECK(renderer.getStats().nodesChanged == 1);
+        CHECK(renderer.getStats().tilesRedrawn > 0);
+        CHECK(renderer.getStats().tilesRedrawn < 20);
+        int area = 0;
+        for (const Rect &rect : renderer.getDirtyRects())
+        {
+            area += rect.getWidth() * rect.getHeight();
+        }
+        CHECK(area < width * height);
+
+        // a change of the geometry counts, even though the node did not move
+        quads[2]->renderInfo.cullMode = CULL_FRONT;
+        renderFrame();
+        CHECK(renderer.getStats().nodesChanged == 1);
+        CHECK(renderer.getStats().tilesRedrawn > 0);
+        quads[2]->renderInfo.cullMode = CULL_NONE;
+        renderFrame();
+
+        // a mesh that grows is drawn over its new bounds, and shrinking it back leaves nothing behind
+        for (float factor : {2.0f, 0.5f})
+        {
+            for (Triangle &triangle : quad->triangles)
+            {
+                triangle.v1.position = triangle.v1.position * factor;
+                triangle.v2.position = triangle.v2.position * factor;
+                triangle.v3.position = triangle.v3.position * factor;
+                triangle.v1.position.w = triangle.v2.position.w = triangle.v3.position.w = 1.0f;
+            }
+            quad->computeBounds();
+            CHECK(renderFrame() > 0);
+            CHECK(renderer.getStats().nodesChanged == 5);
+        }
+
+        // and so is an indexed mesh that is edited in place
+        auto indexed = std::make_shared<IndexedMesh>(IndexedMesh::fromMesh(*quad));
+        quads[4]->renderInfo = RenderInfo(indexed, CULL_NONE);
+        renderFrame();
+        for (size_t v = 0; v < indexed->px.size(); v++)
+        {
+            indexed->px[v] *= 2.0f;
+            indexed->py[v] *= 2.0f;
+        }
+        indexed->computeBounds();
+        CHECK(renderFrame() > 0);
+        CHECK(renderer.getStats().nodesChanged == 1);
+        quads[4]->renderInfo = RenderInfo(quad, CULL_NONE);
+        renderFrame();
+
+        // a quad that leaves the screen leaves nothing behind
+        quads[3]->transform.move(Vec(100.0f, 0.0f, 0.0f));
+        CHECK(renderFrame() > 0);
+        CHECK(renderer.getStats().tilesRedrawn > 0);
+
+        // a moving camera moves everything
+        camera->transform.move(Vec(0.0f, 0.1f, 0.0f));
+        renderFrame();
+        CHECK(renderer.getStats().tilesRedrawn == 20);
+
+        // and so does a new structure
+        sceneGraph.root->children.erase(sceneGraph.root->children.begin());
+        sceneGraph.root->markStructureChanged();
+        CHECK(renderFrame() > 0);
+        CHECK(renderer.getStats().tilesRedrawn == 20);
+
+        // restore the scene for the next mode
+        sceneGraph.root->children.insert(sceneGraph.root->children.begin(), quads[0]);
+        sceneGraph.root->markStructureChanged();
+        quads[1]->transform.move(Vec(-0.3f, -0.2f, 0.0f));
+        quads[3]->transform.move(Vec(-100.0f, 0.0f, 0.0f));
+        camera->transform.move(Vec(0.0f, -0.1f, 0.0f));
+    }
+
+    return failures;
+}
+
+/// @brief A terminal, just capable enough to replay what the displays write -- characters, newlines, cursor positions
+/// @brief and clears
+struct TestTerminal
+{
+    std::vector<std::string> rows;                     // the first byte of every cell
+    std::vector<std::vector<std::string>> glyphs;      // the bytes of every cell, UTF-8 sequences included
+    std::vector<std::vector<std::string>> colors;      // the foreground that each cell was written with, as SGR parameters
+    std::vector<std::vector<std::string>> backgrounds; // the background that each cell was written with
+    std::string foreground, background;
+    int row = 0, column = 0;
+
+    TestTerminal(int width, int height)
+        : rows(height, std::string(width, ' ')), glyphs(height, std::vector<std::string>(width, " ")),
+          colors(height, std::vector<std::string>(width)), backgrounds(height, std::vector<std::string>(width)) {}
+
+    /// @brief Applies the parameters of an SGR sequence -- 0 resets, 38 and 48 are followed by 5;n or 2;r;g;b
+    void select(const std::string &parameters)
+    {
+        std::vector<std::string> values;
+        std::stringstream ss(parameters);
+        std::string value;
+        while (std::getline(ss, value, ';'))
+        {
+            values.push_back(value);
+        }
+        for (size_t i = 0; i < values.size();)
+        {
+            if ((values[i] == "38" || values[i] == "48") && i + 1 < values.size())
+            {
+                size_t count = values[i + 1] == "5" ? 3 : 5;
+                std::string color = values[i];
+                for (size_t j = i + 1; j < i + count && j < values.size(); j++)
+                {
+                    color += ";" + values[j];
+                }
+                (values[i] == "38" ? this->foreground : this->background) = color;
+                i += count;
+            }
+            else
+            {
+                if (values[i] == "0")
+                {
+                    this->foreground.clear();
+                    this->background.clear();
+                }
+                i++;
+            }
+        }
+    }
+
+    void replay(const std::string &bytes)
+    {
+        size_t i = 0;
+        while (i < bytes.size())
+        {
+            char c = bytes[i];
+            if (c == '\x1b' && i + 1 < bytes.size() && bytes[i + 1] == '[')
+            {
+                size_t end = i + 2;
+                while (end < bytes.size() && !std::isalpha((unsigned char)bytes[end]))
+                {
+                    end++;
+                }
+                std::string parameters = bytes.substr(i + 2, end - i - 2);
+                char command = end < bytes.size() ? bytes[end] : '\0';
+                if (command == 'H')
+                {
+                    int y = 1, x = 1;
+                    sscanf(parameters.c_str(), "%d;%d", &y, &x);
+                    this->row = y - 1;
+                    this->column = x - 1;
+                }
+                else if (command == 'm')
+                {
+                    this->select(parameters);
+                }
+                else if (command == 'J')
+                {
+                    for (int y = this->row; y < (int)this->rows.size(); y++)
+                    {
+                        for (int x = y == this->row ? this->column : 0; x < (int)this->rows[y].size(); x++)
+                        {
+                            this->rows[y][x] = ' ';
+                            this->glyphs[y][x] = " ";
+                        }
+                    }
+                }
+                i = end + 1;
+                continue;
+            }
+            if (c == '\n')
+            {
+                this->row++;
+                this->column = 0;
+            }
+            else if (((unsigned char)c & 0xC0) == 0x80)
+            {
+                // a continuation byte of UTF-8 belongs to the cell before
+                if (this->row < (int)this->rows.size() && this->column > 0 && this->column <= (int)this->rows[this->row].size())
+                {
+                    this->glyphs[this->row][this->column - 1] += c;
+                }
+            }
+            else if (c != '\0')
+            {
+                if (this->row < (int)this->rows.size() && this->column < (int)this->rows[this->row].size())
+                {
+                    this->rows[this->row][this->column] = c;
+                    this->glyphs[this->row][this->column] = std::string(1, c);
+                    this->colors[this->row][this->column] = this->foreground;
+                    this->backgrounds[this->row][this->column] = this->background;
+                }
+                this->column++;
+            }
+            i++;
+        }
+    }
+};
+
+/// @brief Reads everything that was written to the file since the given offset, and moves the offset past it
+static std::string readNewOutput(FILE *file, long &offset)
+{
+    fflush(file);
+    fseek(file, offset, SEEK_SET);
+    std::string bytes;
+    int c;
+    while ((c = fgetc(file)) != EOF)
+    {
+        bytes.push_back((char)c);
+    }
+    offset = ftell(file);
+    return bytes;
+}
+
+/// @brief Checks that the ascii display only sends the cells that changed, and that the terminal ends up showing the frame
+int testAsciiDisplayDiff()
+{
+    int failures = 0;
+    const int width = 20, height = 6;
+    const char *ramp = " .:-=+*#%@";
+    FILE *file = tmpfile();
+    long offset = 0;
+    AsciiDisplay display(width, height, fileno(file));
+    TestTerminal terminal(width, height);
+    Texture texture(width, height);
+    texture.blank(Color::greyscale(0.0f));
+
+    // draws the texture, replays the output, and checks the terminal against the texture and the byte counter
+    auto present = [&](const std::vector<Rect> *dirtyRects)
+    {
+        display.prepare();
+        if (dirtyRects != nullptr)
+        {
+            display.draw(texture, *dirtyRects);
+        }
+        else
+        {
+            display.draw(texture);
+        }
+        std::string bytes = readNewOutput(file, offset);
+        CHECK(bytes.size() == display.getStats().bytesWritten);
+        terminal.replay(bytes);
+        int wrong = 0;
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                char expected = ramp[(int)(texture.get(x, y).getLuminance() * 9)];
+                wrong += terminal.rows[y][x] != expected ? 1 : 0;
+            }
+        }
+        CHECK(wrong == 0);
+        return bytes;
+    };
+
+    // the first frame is painted in full
+    for (int x = 0; x < width; x += 3)
+    {
+        texture.set(x, x % height, Color::greyscale(1.0f));
+    }
+    present(nullptr);
+    CHECK(display.getStats().fullRepaint);
+
+    // nothing changed, so nothing is sent
+    present(nullptr);
+    CHECK(display.getStats().bytesWritten == 0);
+    CHECK(display.getStats().cellsChanged == 0);
+
+    // one cell is one cursor move and one character
+    texture.set(4, 2, Color::greyscale(1.0f));
+    std::string bytes = present(nullptr);
+    CHECK(bytes == "\x1b[3;5H@");
+    CHECK(display.getStats().cellsChanged == 1);
+    CHECK(!display.getStats().fullRepaint);
+
+    // a short gap is written over, a long one is jumped
+    texture.set(10, 4, Color::greyscale(1.0f));
+    texture.set(13, 4, Color::greyscale(1.0f));
+    present(nullptr);
+    CHECK(display.getStats().runs == 1);
+    CHECK(display.getStats().cellsChanged == 2);
+    texture.set(1, 1, Color::greyscale(1.0f));
+    texture.set(19, 1, Color::greyscale(1.0f));
+    present(nullptr);
+    CHECK(display.getStats().runs == 2);
+
+    // only the dirty rectangles are looked at
+    texture.set(7, 5, Color::greyscale(1.0f));
+    std::vector<Rect> dirtyRects = {Rect(6, 4, 10, 6)};
+    present(&dirtyRects);
+    CHECK(display.getStats().cellsChanged == 1);
+
+    // when everything changes, a repaint is cheaper than the runs
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            texture.set(x, y, Color::greyscale((x + y) % 2 == 0 ? 1.0f : 0.0f));
+        }
+    }
+    present(nullptr);
+    CHECK(display.getStats().fullRepaint);
+    CHECK(display.getStats().bytesWritten == strlen("\x1b[H") + (size_t)(width * height + height));
+
+    fclose(file);
+    return failures;
+}
+
+/// @brief Checks that the color display writes a color sequence only when the color changes, and quantizes colors
+int testColorDisplay()
+{
+    int failures = 0;
+    const int width = 16, height = 4;
+    FILE *file = tmpfile();
+    long offset = 0;
+    ColorDisplay display(width, height, COLOR_TRUECOLOR, 32, fileno(file));
+    TestTerminal terminal(width, height);
+    Texture texture(width, height, Color(200, 100, 50));
+
+    auto present = [&]()
+    {
+        display.prepare();
+        display.draw(texture, std::vector<Rect>(1, Rect(0, 0, width, height)));
+        std::string bytes = readNewOutput(file, offset);
+        CHECK(bytes.size() == display.getStats().bytesWritten);
+        terminal.replay(bytes);
+        std::vector<char> chars(width);
+        for (int y = 0; y < height; y++)
+        {
+            AsciiDisplay::convertRow(texture.getPixels() + y * width, width, chars.data());
+            CHECK(terminal.rows[y] == std::string(chars.begin(), chars.end()));
+        }
+        return bytes;
+    };
+
+    // one color for the whole frame takes one sequence, quantized to 32 levels
+    present();
+    CHECK(display.getStats().fullRepaint);
+    CHECK(display.getStats().colorChanges == 1);
+    CHECK(terminal.colors[3][15] == "38;2;197;99;49");
+
+    // a change that quantizes to the same color sends nothing
+    texture.set(4, 1, Color(201, 100, 50));
+    CHECK(present().empty());
+
+    // a new color is one sequence, and going back to the old one is another
+    texture.set(4, 1, Color(255, 255, 255));
+    CHECK(present() == "\x1b[2;5H\x1b[38;2;255;255;255m@");
+    texture.set(4, 1, Color(200, 100, 50));
+    CHECK(present() == "\x1b[2;5H\x1b[38;2;197;99;49m=");
+    CHECK(display.getStats().colorChanges == 1);
+
+    // the pen carries over between runs -- only the first of two far apart cells of a new color needs a sequence
+    texture.set(1, 2, Color(255, 255, 255));
+    texture.set(14, 2, Color(255, 255, 255));
+    CHECK(present() == "\x1b[3;2H\x1b[38;2;255;255;255m@\x1b[3;15H@");
+    CHECK(display.getStats().runs == 2);
+    CHECK(terminal.colors[2][14] == "38;2;255;255;255");
+
+    // blank cells show no color, so they never need a sequence
+    texture.set(6, 0, Color(0, 0, 0));
+    CHECK(present() == "\x1b[1;7H ");
+    CHECK(display.getStats().colorChanges == 0);
+
+    // the palette -- the cube for colors, the grey ramp for greys
+    CHECK(ColorQuantizer::toPalette(0, 0, 0) == 16);
+    CHECK(ColorQuantizer::toPalette(255, 255, 255) == 231);
+    CHECK(ColorQuantizer::toPalette(255, 0, 0) == 196);
+    CHECK(ColorQuantizer::toPalette(128, 128, 128) == 244);
+
+    ColorDisplay palette(width, height, COLOR_256, 32, fileno(file));
+    palette.prepare();
+    palette.draw(texture);
+    readNewOutput(file, offset);
+    palette.prepare();
+    texture.set(4, 1, Color(255, 0, 0));
+    palette.draw(texture);
+    CHECK(readNewOutput(file, offset) == "\x1b[2;5H\x1b[38;5;196m.");
+
+    fclose(file);
+    return failures;
+}
+
+int testLumaConversion()
+{
+    int failures = 0;
+    std::mt19937 rng(4321);
+    std::uniform_int_distribution<int> channel(0, 255);
+    const char *ramp = " .:-=+*#%@";
+
+    // odd lengths and offsets, so that the SIMD loop and the scalar tail both run
+    std::vector<Color> pixels(1000);
+    for (Color &pixel : pixels)
+    {
+        pixel = Color((unsigned char)channel(rng), (unsigned char)channel(rng), (unsigned char)channel(rng),
+                      (unsigned char)channel(rng));
+    }
+    pixels[0] = Color(0, 0, 0);
+    pixels[1] = Color(255, 255, 255, 0);
+    for (int offset = 0; offset < 3; offset++)
+    {
+        int count = (int)pixels.size() - offset * 7;
+        const unsigned char *rgba = reinterpret_cast<const unsigned char *>(pixels.data() + offset);
+        std::vector<unsigned char> expected(count), actual(count);
+        ScalarKernels::lumaRow(rgba, expected.data(), count);
+        VecKernels::lumaRow(rgba, actual.data(), count);
+        CHECK(expected == actual);
+    }
+
+    std::vector<char> chars(pixels.size());
+    AsciiDisplay::convertRow(pixels.data(), (int)pixels.size(), chars.data());
+    CHECK(chars[0] == ' ');
+    CHECK(chars[1] == '@');
+    for (size_t i = 0; i < pixels.size(); i++)
+    {
+        // the fixed point luma rounds to a byte, so a luminance right at a step of the ramp may land on its neighbour
+        int expected = (int)(strchr(ramp, AsciiDisplay::luminanceToAscii(pixels[i].getLuminance())) - ramp);
+        int actual = (int)(strchr(ramp, chars[i]) - ramp);
+        CHECK(std::abs(expected - actual) <= 1);
+    }
+    return failures;
+}
+
+/// @brief Checks the half block and braille displays against the pixels that they show, and that the renderer is told
+/// @brief the shape of their pixels
+int testSubCellDisplays()
+{
+    int failures = 0;
+    FILE *file = tmpfile();
+    long offset = 0;
+
+    // half blocks -- 4x2 cells show 4x4 pixels (the last row of cells gets a black lower half of a 4x3 texture)
+    {
+        const int width = 4, height = 2;
+        HalfBlockDisplay display(width, height, COLOR_TRUECOLOR, 256, fileno(file));
+        TestTerminal terminal(width, height);
+        Texture texture(width, 3, Color(255, 0, 0));
+        texture.set(1, 1, Color(0, 0, 255));
+        texture.set(2, 0, Color(0, 0, 255));
+        texture.set(3, 2, Color(0, 255, 0));
+
+        // the colors that the terminal shows for the upper or lower half of a cell
+        auto shown = [&](int x, int y, bool upper)
+        {
+            const std::string &glyph = terminal.glyphs[y][x];
+            bool foreground = glyph == "█" || (glyph == "▀" && upper) || (glyph == "▄" && !upper);
+            return foreground ? terminal.colors[y][x] : terminal.backgrounds[y][x];
+        };
+        auto expected = [&](int x, int py)
+        {
+            Color c = py < texture.getHeight() ? texture.get(x, py) : Color(0, 0, 0);
+            return "38;2;" + std::to_string(c.r) + ";" + std::to_string(c.g) + ";" + std::to_string(c.b);
+        };
+        auto present = [&](const std::vector<Rect> &dirtyRects)
+        {
+            display.prepare();
+            display.draw(texture, dirtyRects);
+            std::string bytes = readNewOutput(file, offset);
+            CHECK(bytes.size() == display.getStats().bytesWritten);
+            terminal.replay(bytes);
+            for (int y = 0; y < height; y++)
+            {
+                for (int x = 0; x < width; x++)
+                {
+                    // backgrounds are 48;..., foregrounds 38;...
+                    CHECK(shown(x, y, true).substr(2) == expected(x, 2 * y).substr(2));
+                    CHECK(shown(x, y, false).substr(2) == expected(x, 2 * y + 1).substr(2));
+                }
+            }
+            return bytes;
+        };
+
+        std::vector<Rect> everything(1, Rect(0, 0, width, 3));
+        present(everything);
+        CHECK(display.getStats().fullRepaint);
+        CHECK(display.getPixelsPerColumn() == 1 && display.getPixelsPerRow() == 2);
+        CHECK(present(everything).empty());
+
+        // one pixel changes one cell, and a cell of one color is a space on its background
+        texture.set(0, 2, Color(0, 0, 255));
+        present(std::vector<Rect>(1, Rect(0, 2, 1, 3)));
+        CHECK(display.getStats().runs == 1 && display.getStats().cellsChanged == 1);
+        texture.set(1, 0, Color(0, 0, 255));
+        present(std::vector<Rect>(1, Rect(1, 0, 2, 1)));
+        CHECK(terminal.glyphs[0][1] == " ");
+        display.cleanup();
+        readNewOutput(file, offset);
+    }
+
+    // braille -- 3x2 cells show 6x8 pixels, a dot is raised from a luma of 64
+    {
+        const int width = 3, height = 2;
+        BrailleDisplay display(width, height, 64, fileno(file));
+        TestTerminal terminal(width, height);
+        Texture texture(6, 8, Color(0, 0, 0));
+        for (int i = 0; i < 6; i++)
+        {
+            // a diagonal line, and a dim pixel that stays a lowered dot
+            texture.set(i, i, Color(255, 255, 255));
+        }
+        texture.set(5, 0, Color(40, 40, 40));
+        texture.set(0, 7, Color(100, 100, 100));
+
+        auto present = [&](const std::vector<Rect> &dirtyRects)
+        {
+            display.prepare();
+            display.draw(texture, dirtyRects);
+            std::string bytes = readNewOutput(file, offset);
+            CHECK(bytes.size() == display.getStats().bytesWritten);
+            terminal.replay(bytes);
+            for (int y = 0; y < height; y++)
+            {
+                for (int x = 0; x < width; x++)
+                {
+                    int dots = 0;
+                    const int bits[4][2] = {{0x01, 0x08}, {0x02, 0x10}, {0x04, 0x20}, {0x40, 0x80}};
+                    for (int dotY = 0; dotY < 4; dotY++)
+                    {
+                        for (int dotX = 0; dotX < 2; dotX++)
+                        {
+                            dots |= texture.get(x * 2 + dotX, y * 4 + dotY).getLuminance() >= 0.3f ? bits[dotY][dotX] : 0;
+                        }
+                    }
+                    std::string glyph = dots == 0 ? " " : std::string{(char)0xE2, (char)(0xA0 | (dots >> 6)), (char)(0x80 | (dots & 0x3F))};
+                    CHECK(terminal.glyphs[y][x] == glyph);
+                }
+            }
+            return bytes;
+        };
+
+        std::vector<Rect> everything(1, Rect(0, 0, 6, 8));
+        present(everything);
+        CHECK(display.getStats().fullRepaint);
+        CHECK(terminal.glyphs[0][0] == "⠑");
+        CHECK(terminal.glyphs[1][0] == "⡀");
+        CHECK(display.getPixelsPerColumn() == 2 && display.getPixelsPerRow() == 4);
+        CHECK(present(everything).empty());
+
+        // one dot changes one cell -- 3 bytes behind a cursor move
+        texture.set(5, 7, Color(255, 255, 255));
+        CHECK(present(std::vector<Rect>(1, Rect(5, 7, 6, 8))) == "\x1b[2;3H⢑");
+        display.cleanup();
+    }
+    fclose(file);
+
+    // the renderer is told the shape of the pixels -- square for braille and half blocks, twice as tall for ascii
+    RenderSettings braille = RenderSettings(1, 1, 90.0f, 0.1f, 100.0f).setPixelGrid(80, 24, 2, 4);
+    RenderSettings ascii = RenderSettings(1, 1, 90.0f, 0.1f, 100.0f).setPixelGrid(80, 24, 1, 1);
+    CHECK(braille.width == 160 && braille.height == 96 && braille.pixelAspect == 1.0f);
+    CHECK(ascii.width == 80 && ascii.height == 24 && ascii.pixelAspect == 2.0f);
+    RasciiRenderer squareRenderer(braille), tallRenderer(ascii);
+    squareRenderer.prepare();
+    tallRenderer.prepare();
+    float square = squareRenderer.getProjectionMatrix().at(0, 0), tall = tallRenderer.getProjectionMatrix().at(0, 0);
+    CHECK(std::fabs(square - 96.0f / 160.0f) < 1e-5f);
+    CHECK(std::fabs(tall - 2.0f * 24.0f / 80.0f) < 1e-5f);
+    return failures;
+}
+
+/// @brief A display that records what it was given, and can be held up in draw() like a slow terminal
+struct RecordingDisplay : public IDisplay
+{
+    std::vector<int> frames;                   // the red channel of the first pixel of every drawn frame
+    std::vector<std::vector<Rect>> dirtyRects; // the dirty rectangles of every drawn frame
+    std::atomic<bool> drawing{false};
+    std::atomic<bool> hold{false};
+    std::atomic<int> prepares{0};
+    std::atomic<bool> cleanedUp{false};
+
+    void draw(const Texture &tex)
+    {
+        this->draw(tex, std::vector<Rect>(1, Rect(0, 0, tex.getWidth(), tex.getHeight())));
+    }
+
+    void draw(const Texture &tex, const std::vector<Rect> &rects)
+    {
+        this->drawing = true;
+        while (this->hold)
+        {
+            std::this_thread::yield();
+        }
+        this->frames.push_back(tex.get(0, 0).r);
+        this->dirtyRects.push_back(rects);
+        this->drawing = false;
+    }
+
+    void prepare()
+    {
+        this->prepares++;
+    }
+
+    void cleanup()
+    {
+        this->cleanedUp = true;
+    }
+};
+
+/// @brief Checks that the presenter draws the latest frame, drops the ones that the display could not keep up with, and
+/// @brief carries their dirty rectangles over
+int testDisplayPresenter()
+{
+    int failures = 0;
+    auto display = std::make_shared<RecordingDisplay>();
+    Texture texture(8, 4);
+    auto frame = [&](int id)
+    {
+        texture.set(0, 0, Color((unsigned char)id, 0, 0));
+        return std::vector<Rect>(1, Rect(id, 0, id + 1, 1));
+    };
+    {
+        DisplayPresenter presenter(display);
+
+        // the display is held up in the first frame -- submitting never waits for it
+        display->hold = true;
+        presenter.submit(texture, frame(1));
+        while (!display->drawing)
+        {
+            std::this_thread::yield();
+        }
+        presenter.submit(texture, frame(2));
+        presenter.submit(texture, frame(3));
+        presenter.submit(texture, frame(4));
+        CHECK(presenter.getStats().framesSubmitted == 4);
+        CHECK(presenter.getStats().framesDropped == 2);
+        CHECK(presenter.getStats().framesPresented == 0);
+
+        // 2 and 3 were replaced before the display got to them, so 4 covers what they changed too
+        display->hold = false;
+        presenter.flush();
+        CHECK(display->frames == std::vector<int>({1, 4}));
+        CHECK(display->dirtyRects.size() == 2 && display->dirtyRects[1].size() == 3);
+        int covered = 0;
+        for (const Rect &rect : display->dirtyRects.back())
+        {
+            covered |= 1 << rect.minX;
+        }
+        CHECK(covered == ((1 << 2) | (1 << 3) | (1 << 4)));
+        CHECK(presenter.getStats().framesPresented == 2);
+        CHECK(display->prepares == 2);
+
+        // a display that keeps up draws every frame
+        for (int id = 5; id < 10; id++)
+        {
+            presenter.submit(texture, frame(id));
+            presenter.flush();
+        }
+        CHECK(display->frames.size() == 7 && display->frames.back() == 9);
+        CHECK(presenter.getStats().framesDropped == 2);
+
+        // the last frame is drawn before the presenter stops
+        presenter.submit(texture, frame(10));
+    }
+    CHECK(display->frames.back() == 10);
+    CHECK(display->cleanedUp);
+    return failures;
+}
+
+/// @brief Checks that a frame goes out with one write, control sequences and all, and that a pipe which fills up, or an
+/// @brief output that fails, still ends up with the whole frame
+int testFrameOutput()
+{
+    int failures = 0;
+    Texture texture(20, 6);
+    for (int y = 0; y < 6; y++)
+    {
+        for (int x = 0; x < 20; x++)
+        {
+            texture.set(x, y, Color::greyscale((float)((x + y) % 10) / 10.0f));
+        }
+    }
+
+    // the clear, hiding the cursor and the frame are a single write -- with no padding after the control sequences
+    FILE *file = tmpfile();
+    long offset = 0;
+    AsciiDisplay display(20, 6, fileno(file));
+    display.prepare();
+    display.draw(texture);
+    std::string bytes = readNewOutput(file, offset);
+    CHECK(display.getStats().writeCalls == 1);
+    CHECK(bytes.size() == display.getStats().bytesWritten);
+    CHECK(bytes.compare(0, 12, "\x1b[H\x1b[J\x1b[?25l") == 0);
+    CHECK(bytes.find('\0') == std::string::npos);
+    display.cleanup();
+    CHECK(readNewOutput(file, offset) == "\x1b[H\x1b[J\x1b[?25h");
+    fclose(file);
+
+    // an output that fails is counted, and the frame after it is a full repaint
+    AsciiDisplay broken(20, 6, -1);
+    broken.prepare();
+    broken.draw(texture);
+    CHECK(broken.getStats().writeErrors == 1 && broken.getStats().bytesWritten == 0);
+    broken.prepare();
+    broken.draw(texture);
+    CHECK(broken.getStats().fullRepaint);
+
+#if !defined(_WIN32)
+    // a frame larger than a pipe holds, on a pipe that does not block -- the write stops part way and waits for the
+    // reader, and the reader gets what a file gets
+    const int width = 1000, height = 200;
+    Texture large(width, height);
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            large.set(x, y, Color::greyscale((float)((x * 7 + y) % 10) / 10.0f));
+        }
+    }
+    file = tmpfile();
+    offset = 0;
+    AsciiDisplay reference(width, height, fileno(file));
+    reference.prepare();
+    reference.draw(large);
+    std::string expected = readNewOutput(file, offset);
+    fclose(file);
+
+    int ends[2];
+    CHECK(pipe(ends) == 0);
+    fcntl(ends[1], F_SETFL, fcntl(ends[1], F_GETFL) | O_NONBLOCK);
+    std::string received;
+    std::thread reader([&]()
+                       {
+        char chunk[4096];
+        ssize_t count;
+        while ((count = read(ends[0], chunk, sizeof(chunk))) > 0)
+        {
+            received.append(chunk, (size_t)count);
+        } });
+    {
+        AsciiDisplay piped(width, height, ends[1]);
+        piped.prepare();
+        piped.draw(large);
+        CHECK(piped.getStats().writeCalls >= 2);
+        CHECK(piped.getStats().writeErrors == 0);
+        CHECK(piped.getStats().bytesWritten == expected.size());
+    }
+    close(ends[1]);
+    reader.join();
+    close(ends[0]);
+    CHECK(received == expected);
+
+    // a reader that stops reading -- the write gives up after the timeout, and the frame after it is a full repaint
+    CHECK(pipe(ends) == 0);
+    fcntl(ends[1], F_SETFL, fcntl(ends[1], F_GETFL) | O_NONBLOCK);
+    {
+        AsciiDisplay stalled(width, height, ends[1]);
+        stalled.setWriteTimeout(20);
+        stalled.prepare();
+        stalled.draw(large);
+        CHECK(stalled.getStats().framesDropped == 1);
+        CHECK(stalled.getStats().writeErrors == 0);
+        CHECK(stalled.getStats().bytesWritten > 0 && stalled.getStats().bytesWritten < expected.size());
+
+        std::thread drain([&]()
+                          {
+            char chunk[4096];
+            while (read(ends[0], chunk, sizeof(chunk)) > 0)
+            {
+            } });
+        stalled.prepare();
+        stalled.draw(large);
+        CHECK(stalled.getStats().framesDropped == 0);
+        CHECK(stalled.getStats().fullRepaint);
+        CHECK(stalled.getStats().bytesWritten == expected.size());
+        close(ends[1]);
+        drain.join();
+    }
+    close(ends[0]);
+
+    // a frame dropped before its red rows went out -- the red frame after it can't count on the terminal writing red
+    Texture greenOverRed(400, 400, Color(200, 0, 0));
+    for (int y = 0; y < 200; y++)
+    {
+        for (int x = 0; x < 400; x++)
+        {
+            greenOverRed.set(x, y, Color(0, 200, 0));
+        }
+    }
+    CHECK(pipe(ends) == 0);
+    fcntl(ends[1], F_SETFL, fcntl(ends[1], F_GETFL) | O_NONBLOCK);
+    {
+        ColorDisplay stalled(400, 400, COLOR_TRUECOLOR, 32, ends[1]);
+        stalled.setWriteTimeout(0);
+        stalled.prepare();
+        stalled.draw(greenOverRed);
+        CHECK(stalled.getStats().framesDropped == 1);
+
+        std::string drained;
+        std::thread drain([&]()
+                          {
+            char chunk[4096];
+            ssize_t count;
+            while ((count = read(ends[0], chunk, sizeof(chunk))) > 0)
+            {
+                drained.append(chunk, (size_t)count);
+            } });
+        stalled.setWriteTimeout(-1);
+        stalled.prepare();
+        stalled.draw(Texture(400, 400, Color(200, 0, 0)));
+        CHECK(stalled.getStats().fullRepaint);
+        CHECK(stalled.getStats().colorChanges == 1);
+        close(ends[1]);
+        drain.join();
+        size_t green = drained.find("\x1b[38;2;");
+        CHECK(green != std::string::npos && drained.find("\x1b[38;2;", green + 1) != std::string::npos);
+    }
+    close(ends[0]);
+#endif
+    return failures;
+}
+
+int main()
+{
+    struct
+    {
+        const char *name;
+        int (*run)();
+    } tests[] = {
+        {"kernels match scalar reference", testKernelsMatchScalarReference},
+        {"batch transform matches mat * vec", testBatchTransformMatchesMatVec},
+        {"indexed mesh", testIndexedMesh},
+        {"vec and matrix operators", testVecMatrixOperators},
+        {"mesh transform past 10k triangles", testMeshTransformLargeMesh},
+        {"frame arena", testFrameArena},
+        {"renderer steady state allocations", testRendererSteadyStateAllocations},
+        {"cached world matrices", testCachedWorldMatrices},
+        {"flat scene graph", testFlatSceneGraph},
+        {"flat scene graph reused root", testFlatSceneGraphReusedRoot},
+        {"frustum culling", testFrustumCulling},
+        {"hierarchical culling", testHierarchicalCulling},
+        {"backface culling", testBackfaceCulling},
+        {"near plane clipping", testNearPlaneClipping},
+        {"solid rendering", testSolidRendering},
+        {"edge function rasterizer", testEdgeRasterizer},
+        {"thread pool", testThreadPool},
+        {"tiled rasterization", testTiledRasterization},
+        {"parallel vertex stage", testParallelVertexStage},
+        {"fused vertex path", testFusedVertexPath},
+        {"camera", testCamera},
+        {"vertex cache", testVertexCache},
+        {"dirty regions", testDirtyRegions},
+        {"ascii display diff", testAsciiDisplayDiff},
+        {"luma conversion", testLumaConversion},
+        {"color display", testColorDisplay},
+        {"sub-cell displays", testSubCellDisplays},
+        {"display presenter", testDisplayPresenter},
+        {"frame output", testFrameOutput},
+    };
+
+    std::cout << "Running tests with the " << VecKernels::name() << " kernels" << std::endl;
+    int failedTests = 0;
+    for (auto &test : tests)
+    {
+        int failures = test.run();
+        std::cout << (failures == 0 ? "[PASS] " : "[FAIL] ") << test.name << std::endl;
+        if (failures != 0)
+        {
+            failedTests++;
+        }
+    }
+
+    return failedTests == 0 ? 0 : 1;
 }